@@ -0,0 +1,308 @@
+// Headless benchmark of the load and paint path, run with `meson test --benchmark` or directly
+//
+// Every image of a generated corpus goes through the same steps as when it is opened by imgv2: decode, upload into a
+// tiled texture, resize the window to fit and repaint, then flip. Results are printed as JSON on stdout (or written to
+// --output), so a CI box without a GPU can track them over time.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_image.h"
+#include "SDLit.hpp"
+#include "image_loader.hpp"
+#include "image_viewer.hpp"
+#include "image_writer.hpp"
+#include "tiled_texture.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::size_t max_megapixels{100U};
+    std::size_t iterations{5U};
+    std::filesystem::path corpus_directory{};
+    std::filesystem::path output_path{};
+};
+
+/// Median and best time of a step, in milliseconds
+struct Timing {
+    double median{};
+    double min{};
+};
+
+struct Result {
+    std::string format{};
+    std::size_t megapixels{};
+    int width{};
+    int height{};
+    std::uintmax_t file_bytes{};
+    Timing decode{};
+    Timing upload{};
+    Timing repaint{};
+    Timing flip{};
+};
+
+struct Skipped {
+    std::string format{};
+    std::size_t megapixels{};
+    std::string reason{};
+};
+
+constexpr std::size_t kCorpusMegapixels[] = {1U, 4U, 16U, 50U, 100U};
+constexpr std::string_view kCorpusFormats[] = {"png", "jpg", "qoi", "webp"};
+
+bool parseOptionValue(std::string_view arg, std::string_view option, std::size_t& value) noexcept {
+    if (not arg.starts_with(option)) {
+        return false;
+    }
+
+    arg.remove_prefix(option.size());
+    auto const result = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    return result.ec == std::errc{} && result.ptr == arg.data() + arg.size();
+}
+
+template <typename Step>
+Timing measure(std::size_t iterations, Step&& step) {
+    std::vector<double> samples{};
+    samples.reserve(iterations);
+    for (std::size_t i = 0; i < iterations; ++i) {
+        auto const start = Clock::now();
+        if (not step()) {
+            return {-1.0, -1.0};
+        }
+        samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+
+    std::sort(samples.begin(), samples.end());
+    return {samples[samples.size() / 2], samples.front()};
+}
+
+/// Smooth gradients with grain, neither trivially compressible nor pure noise, like a photograph
+SurfacePtr generateSurface(int width, int height) noexcept {
+    SurfacePtr surface = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, width, height, 32,
+                                            static_cast<Uint32>(SDL_PIXELFORMAT_RGBA32));
+    if (not surface) {
+        return surface;
+    }
+
+    std::uint32_t seed = 0x9E3779B9U;
+    for (int y = 0; y < height; ++y) {
+        auto* row = static_cast<std::uint8_t*>(surface->pixels) + static_cast<std::size_t>(y) * surface->pitch;
+        for (int x = 0; x < width; ++x) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            int const grain = static_cast<int>(seed & 0x0FU) - 8;
+            row[x * 4 + 0] = static_cast<std::uint8_t>(std::clamp(x * 255 / width + grain, 0, 255));
+            row[x * 4 + 1] = static_cast<std::uint8_t>(std::clamp(y * 255 / height + grain, 0, 255));
+            row[x * 4 + 2] = static_cast<std::uint8_t>(std::clamp(((x ^ y) & 0xFF) / 2 + 64 + grain, 0, 255));
+            row[x * 4 + 3] = 0xFF;
+        }
+    }
+    return surface;
+}
+
+/// Path of the corpus image, encoded on first use and reused by later runs
+std::filesystem::path corpusImage(Options const& options, std::string_view format, std::size_t megapixels, int width,
+                                  int height) noexcept {
+    auto image_path = options.corpus_directory /
+                      ("corpus_" + std::to_string(megapixels) + "mp." + std::string{format});
+    std::error_code error{};
+    if (std::filesystem::exists(image_path, error)) {
+        return image_path;
+    }
+
+    auto surface = generateSurface(width, height);
+    if (not surface || not saveImage(surface.get(), image_path)) {
+        std::filesystem::remove(image_path, error);
+        return {};
+    }
+    return image_path;
+}
+
+bool benchmarkImage(Options const& options, std::filesystem::path const& image_path, Result& result) noexcept {
+    std::error_code error{};
+    result.file_bytes = std::filesystem::file_size(image_path, error);
+
+    SurfacePtr surface{};
+    result.decode = measure(options.iterations, [&] {
+        surface = SDLit::make_unique(IMG_Load, image_path.c_str());
+        return static_cast<bool>(surface);
+    });
+    if (not surface) {
+        return false;
+    }
+
+    // Uploads go to a renderer of their own so the viewer below starts from the same state on every iteration
+    auto window = SDLit::make_unique(SDL_CreateWindow, "imgv2-bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                     640, 480, SDL_WINDOW_HIDDEN);
+    auto renderer = window ? SDLit::make_unique(SDL_CreateRenderer, window.get(), -1, 0)
+                           : std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter>{};
+    if (not renderer) {
+        return false;
+    }
+    result.upload = measure(options.iterations, [&] {
+        auto texture = TiledTexture::create(renderer.get(), surface);
+        return static_cast<bool>(texture);
+    });
+    renderer.reset();
+    window.reset();
+
+    auto image_viewer = ImageViewer::open(image_path, std::move(surface));
+    if (not image_viewer) {
+        return false;
+    }
+    result.repaint = measure(options.iterations, [&] { return image_viewer->resize() && image_viewer->repaint(); });
+
+    std::size_t flip_count{};
+    result.flip = measure(options.iterations, [&] {
+        if (flip_count++ % 2U == 0U) {
+            image_viewer->flipHorizontal();
+        } else {
+            image_viewer->flipVertical();
+        }
+        return image_viewer->repaint();
+    });
+    return true;
+}
+
+void writeTiming(std::ostream& out, std::string_view name, Timing const& timing) {
+    out << "\"" << name << "_ms\": {\"median\": " << timing.median << ", \"min\": " << timing.min << "}";
+}
+
+void writeJson(std::ostream& out, Options const& options, std::vector<Result> const& results,
+               std::vector<Skipped> const& skipped) {
+    out << "{\n";
+    out << "  \"benchmark\": \"imgv2\",\n";
+    out << "  \"video_driver\": \"" << SDL_GetCurrentVideoDriver() << "\",\n";
+    out << "  \"iterations\": " << options.iterations << ",\n";
+    out << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        auto const& result = results[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"format\": \"" << result.format << "\", \"megapixels\": " << result.megapixels
+            << ", \"width\": " << result.width << ", \"height\": " << result.height
+            << ", \"file_bytes\": " << result.file_bytes << ", ";
+        writeTiming(out, "decode", result.decode);
+        out << ", ";
+        writeTiming(out, "upload", result.upload);
+        out << ", ";
+        writeTiming(out, "repaint", result.repaint);
+        out << ", ";
+        writeTiming(out, "flip", result.flip);
+        out << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"skipped\": [";
+    for (std::size_t i = 0; i < skipped.size(); ++i) {
+        std::string reason = skipped[i].reason;
+        std::replace(reason.begin(), reason.end(), '"', '\'');
+        std::replace(reason.begin(), reason.end(), '\\', '/');
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"format\": \"" << skipped[i].format << "\", \"megapixels\": " << skipped[i].megapixels
+            << ", \"reason\": \"" << reason << "\"}";
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options{};
+    for (int i = 1; i < argc; ++i) {
+        auto arg_view = std::string_view{argv[i]};
+        std::size_t option_value{};
+        if (parseOptionValue(arg_view, "--max-mp=", option_value)) {
+            options.max_megapixels = option_value;
+        } else if (parseOptionValue(arg_view, "--iterations=", option_value) && option_value > 0) {
+            options.iterations = option_value;
+        } else if (arg_view.starts_with("--corpus=")) {
+            options.corpus_directory = arg_view.substr(std::string_view{"--corpus="}.size());
+        } else if (arg_view.starts_with("--output=")) {
+            options.output_path = arg_view.substr(std::string_view{"--output="}.size());
+        } else {
+            std::cerr << "USAGE: \n";
+            std::cerr << "    " << argv[0] << " [OPTIONS]\n\n";
+            std::cerr << "OPTIONS: \n";
+            std::cerr << "    --max-mp=N         largest corpus image in megapixels (100)\n";
+            std::cerr << "    --iterations=N     runs of each step, the median and best are reported (5)\n";
+            std::cerr << "    --corpus=DIR       where the generated images are kept between runs (temp directory)\n";
+            std::cerr << "    --output=FILE      write the JSON results to FILE instead of stdout\n";
+            return (arg_view == "--help" || arg_view == "-h") ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (options.corpus_directory.empty()) {
+        std::error_code error{};
+        options.corpus_directory = std::filesystem::temp_directory_path(error) / "imgv2-bench-corpus";
+    }
+    std::error_code error{};
+    std::filesystem::create_directories(options.corpus_directory, error);
+    if (error) {
+        std::cerr << "Failed to create " << options.corpus_directory << ": " << error.message() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // No display and no GPU, both the window and the renderer are emulated in memory
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+    SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "best");
+    SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN);
+    SDLit::init(SDL_INIT_VIDEO, IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_WEBP);
+
+    std::vector<Result> results{};
+    std::vector<Skipped> skipped{};
+    for (std::size_t const megapixels : kCorpusMegapixels) {
+        if (megapixels > options.max_megapixels) {
+            continue;
+        }
+
+        // 4:3 like most camera sensors
+        int const width = static_cast<int>(std::lround(std::sqrt(megapixels * 1e6 * 4.0 / 3.0)));
+        int const height = static_cast<int>(std::lround(width * 3.0 / 4.0));
+        for (auto const format : kCorpusFormats) {
+            auto const image_path = corpusImage(options, format, megapixels, width, height);
+            if (image_path.empty()) {
+                skipped.push_back({std::string{format}, megapixels, SDL_GetError()});
+                continue;
+            }
+
+            Result result{std::string{format}, megapixels, width, height};
+            if (not benchmarkImage(options, image_path, result)) {
+                skipped.push_back({std::string{format}, megapixels, SDL_GetError()});
+                continue;
+            }
+            std::cerr << format << ' ' << megapixels << "MP: decode " << result.decode.median << "ms, upload "
+                      << result.upload.median << "ms, repaint " << result.repaint.median << "ms, flip "
+                      << result.flip.median << "ms\n";
+            results.push_back(std::move(result));
+        }
+    }
+
+    if (options.output_path.empty()) {
+        writeJson(std::cout, options, results, skipped);
+    } else {
+        std::ofstream output_file{options.output_path, std::ios::trunc};
+        writeJson(output_file, options, results, skipped);
+        if (not output_file) {
+            std::cerr << "Failed to write " << options.output_path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    return results.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
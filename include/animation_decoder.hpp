@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// Frame of an animation, already composed over the previous ones at the size of the whole image
+struct AnimationFrame {
+    SurfacePtr surface{};
+    std::chrono::milliseconds delay{};
+};
+
+/// Reads the frames of an animated image one at a time, so only the canvas being composed is held in memory
+/// @note a decoder is not thread safe, but it may be moved from thread to thread
+class AnimationDecoder {
+   public:
+    /// Open an animated GIF, PNG (APNG) or WebP, null for still images and other formats
+    /// @note WebP animations are only decoded when libwebpdemux is available
+    static std::unique_ptr<AnimationDecoder> open(std::filesystem::path const& image_path) noexcept;
+
+    /// Whether the file extension is one of a format that may be animated, it still has to be opened to know
+    static bool isAnimationFile(std::filesystem::path const& file_path) noexcept;
+
+    AnimationDecoder() noexcept = default;
+    AnimationDecoder(AnimationDecoder const&) = delete;
+    AnimationDecoder(AnimationDecoder&&) = delete;
+    AnimationDecoder& operator=(const AnimationDecoder&) = delete;
+    AnimationDecoder& operator=(AnimationDecoder&&) = delete;
+
+    virtual ~AnimationDecoder() noexcept = default;
+
+    /// Dimensions of the canvas, every frame has them
+    virtual SDL_Point size() const noexcept = 0;
+
+    /// Decode the next frame, false after the last one or when the file is corrupted (see SDL_GetError)
+    virtual bool next(AnimationFrame& frame) noexcept = 0;
+
+    /// Start over from the first frame
+    virtual bool rewind() noexcept = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// Plays an animated image, its frames are decoded a few ahead on the worker pool while earlier ones are shown
+/// @note only a bounded queue of frames is held in memory, however long the animation is
+/// @note the timing is driven by the event loop through nextFrameTime() and takeFrame(), nothing sleeps
+class AnimationPlayer final {
+   public:
+    /// Start decoding in the background, null when the file extension is not one of an animation format
+    /// @note still images are only told apart once opened by the worker, the player then never has a frame
+    static std::unique_ptr<AnimationPlayer> open(std::filesystem::path const& image_path,
+                                                 std::uint32_t window_id) noexcept;
+
+    /// User event type pushed when a frame is decoded while none was queued, event.user.windowID is the one given
+    static std::uint32_t frameDecodedEventType() noexcept;
+
+    AnimationPlayer(AnimationPlayer const&) = delete;
+    AnimationPlayer(AnimationPlayer&&) = delete;
+    AnimationPlayer& operator=(const AnimationPlayer&) = delete;
+    AnimationPlayer& operator=(AnimationPlayer&&) = delete;
+
+    /// Stop decoding, a frame being decoded is dropped
+    ~AnimationPlayer() noexcept;
+
+    /// When the next frame is due, nothing while it is still being decoded or when there is no animation
+    std::optional<std::chrono::steady_clock::time_point> nextFrameTime() const noexcept;
+
+    /// Frame to show when its time has come at now, null otherwise
+    SurfacePtr takeFrame(std::chrono::steady_clock::time_point now) noexcept;
+
+   private:
+    struct State;
+
+    explicit AnimationPlayer(std::shared_ptr<State> state) noexcept;
+
+    /// Queue a decoding task on the worker pool unless one is running or the queue is full
+    static void decodeAhead(std::shared_ptr<State> const& state) noexcept;
+
+    std::shared_ptr<State> m_state;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "SDL.h"
+
+/// Transforms applied to every exported image, in this order: fit, flip and rotation
+struct ExportOptions {
+    std::filesystem::path output_directory{};
+    /// Extension of the written files, any format saveImage() supports
+    std::string format{"png"};
+    int quality{90};
+    /// Bounds the images are shrunk to fit in, keeping their aspect ratio, {0, 0} keeps them at full size
+    SDL_Point fit_size{};
+    SDL_RendererFlip flip{SDL_FLIP_NONE};
+    /// Rotation clockwise, in multiples of 90 degrees
+    int quarter_turns{};
+};
+
+/// Decode, transform and encode the images on the worker pool, without any window, renderer or display
+/// @note outputs are named after the input files, those sharing a name get a numbered suffix
+/// @note returns how many images could not be exported, each failure is logged
+std::size_t exportImages(std::vector<std::filesystem::path> const& image_paths, ExportOptions const& options) noexcept;
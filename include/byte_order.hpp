@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+
+/// Integers stored in file headers and chunks, little (LE) or big (BE) endian whatever the platform
+std::uint16_t readLE16(std::uint8_t const* data) noexcept;
+std::uint16_t readBE16(std::uint8_t const* data) noexcept;
+std::uint32_t readLE32(std::uint8_t const* data) noexcept;
+std::uint32_t readBE32(std::uint8_t const* data) noexcept;
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+
+class ImageViewer;
+
+/// Viewers linked to compare their images, the flips, zoom and pan of one of them are applied to all the others
+/// @note views are shared relative to the image size, so images of different sizes stay aligned
+/// @note each viewer may show its difference with the reference image, the one of the first other viewer
+/// @note only used from the main thread, like the windows themselves
+class CompareGroup final {
+   public:
+    CompareGroup() noexcept;
+
+    CompareGroup(CompareGroup const&) = delete;
+    CompareGroup(CompareGroup&&) = delete;
+    CompareGroup& operator=(const CompareGroup&) = delete;
+    CompareGroup& operator=(CompareGroup&&) = delete;
+
+    ~CompareGroup() noexcept;
+
+    /// Viewers join for as long as they are linked, the ones compared with a leaving viewer pick another reference
+    void add(ImageViewer* image_viewer) noexcept;
+    void remove(ImageViewer* image_viewer) noexcept;
+
+    std::vector<ImageViewer*> const& imageViewers() const noexcept;
+
+    /// Viewer whose image the given one is compared with, null when it is alone
+    ImageViewer* reference(ImageViewer const* image_viewer) const noexcept;
+
+    /// Apply the view of the viewer to all the other ones
+    void followView(ImageViewer const* image_viewer) noexcept;
+
+    /// The image of the viewer changed, the differences computed from it are computed again
+    void imageChanged(ImageViewer const* image_viewer) noexcept;
+
+   private:
+    std::vector<ImageViewer*> m_image_viewers{};
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Natural order of file names, runs of digits compare by value so img2 comes before img10, letters ignore case
+/// @note names equal under these rules fall back to a byte comparison, only identical names are equivalent
+bool naturalLess(std::string_view lhs, std::string_view rhs) noexcept;
+
+/// Image files of a directory in natural order, listed by a background thread
+/// @note the index is usable right away and grows as the listing goes, a directory of 100k files never blocks anyone
+/// @note entries are only filtered by extension, nothing is read from the files until they are shown
+class DirectoryIndex final {
+   public:
+    /// Index of the directory shared by all the viewers showing an image from it, the listing starts on the first call
+    static std::shared_ptr<DirectoryIndex> shared(std::filesystem::path const& directory_path) noexcept;
+
+    explicit DirectoryIndex(std::filesystem::path directory_path) noexcept;
+
+    DirectoryIndex(DirectoryIndex const&) = delete;
+    DirectoryIndex(DirectoryIndex&&) = delete;
+    DirectoryIndex& operator=(const DirectoryIndex&) = delete;
+    DirectoryIndex& operator=(DirectoryIndex&&) = delete;
+
+    /// Stop listing, waiting for the directory entries being read
+    ~DirectoryIndex() noexcept;
+
+    std::filesystem::path const& directoryPath() const noexcept;
+
+    /// Whether the whole directory was listed
+    bool complete() const noexcept;
+
+    /// Images found so far
+    std::size_t size() const noexcept;
+
+    /// Image offset steps after (or before, when negative) image_path, which does not need to be in the index itself
+    std::optional<std::filesystem::path> neighbor(std::filesystem::path const& image_path,
+                                                  std::ptrdiff_t offset) const noexcept;
+
+    std::optional<std::filesystem::path> first() const noexcept;
+    std::optional<std::filesystem::path> last() const noexcept;
+
+    /// Up to radius images on each side of image_path along with the position of image_path among them
+    std::pair<std::vector<std::filesystem::path>, std::size_t> around(std::filesystem::path const& image_path,
+                                                                      std::size_t radius) const noexcept;
+
+   private:
+    void scan() noexcept;
+    void publish(std::vector<std::string>& names) noexcept;
+    std::filesystem::path imagePath(std::string const& name) const noexcept;
+
+    std::filesystem::path m_directory_path;
+    std::atomic_bool m_stopping{false};
+    mutable std::mutex m_mutex{};
+    std::vector<std::string> m_names{};
+    bool m_complete{false};
+    std::thread m_thread{};
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// Decoded pixels persisted across runs, keyed by the image path, modification time and size
+/// @note entries are memory mapped and handed to SDL as is, reading one costs about as much as a page cache hit
+class DiskCache final {
+   public:
+    /// Cache shared by all image loads, disabled until enabled
+    static DiskCache& shared() noexcept;
+
+    DiskCache() noexcept;
+
+    DiskCache(DiskCache const&) = delete;
+    DiskCache(DiskCache&&) = delete;
+    DiskCache& operator=(const DiskCache&) = delete;
+    DiskCache& operator=(DiskCache&&) = delete;
+
+    ~DiskCache() noexcept;
+
+    /// Store the entries in directory, evicting the least recently used once they take more than limit_bytes
+    bool enable(std::filesystem::path directory, std::size_t limit_bytes) noexcept;
+
+    bool enabled() const noexcept;
+
+    /// Surface backed by the mapped entry of the image, null when there is none or it is outdated
+    SurfacePtr load(std::filesystem::path const& image_path) noexcept;
+
+    /// Write the decoded surface of the image, safe to call from any thread
+    bool store(std::filesystem::path const& image_path, SDL_Surface const* surface) noexcept;
+
+   private:
+    std::filesystem::path entryPath(std::filesystem::path const& image_path) const noexcept;
+    void evict() noexcept;
+
+    mutable std::mutex m_mutex{};
+    std::filesystem::path m_directory{};
+    std::size_t m_limit_bytes{};
+
+    /// Size of the entries, counted once when enabled and kept up to date by store, the directory is only listed
+    /// again when it goes over the limit
+    std::uintmax_t m_total_bytes{};
+};
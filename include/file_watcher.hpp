@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SDL.h"
+
+/// Reports when the files shown in the windows are rewritten, with a single inotify instance for all of them
+/// @note directories are watched rather than files, so files replaced by a rename are still followed
+/// @note bursts of writes are debounced, a change is reported once the file has been quiet for a moment
+class FileWatcher final {
+   public:
+    /// A file that changed, changed_at is when its first write was noticed
+    struct Change {
+        std::uint32_t window_id{};
+        std::chrono::steady_clock::time_point changed_at{};
+    };
+
+    /// Start watching in background, event_type is pushed whenever changes are ready to be taken
+    /// @note only available on Linux, null elsewhere
+    static std::unique_ptr<FileWatcher> create(std::uint32_t event_type) noexcept;
+
+    FileWatcher(FileWatcher const&) = delete;
+    FileWatcher(FileWatcher&&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    FileWatcher& operator=(FileWatcher&&) = delete;
+
+    ~FileWatcher() noexcept;
+
+    /// User event type given to create()
+    std::uint32_t eventType() const noexcept;
+
+    /// Watch exactly these files, identified by the window showing them, the previous ones are dropped
+    void setWatchedFiles(std::vector<std::pair<std::uint32_t, std::filesystem::path>> const& files) noexcept;
+
+    /// Changes reported since the last call
+    std::vector<Change> takeChanges() noexcept;
+
+   private:
+    struct WatchedFile {
+        std::filesystem::path path{};
+        std::filesystem::path absolute_path{};
+    };
+
+    struct PendingChange {
+        std::chrono::steady_clock::time_point changed_at{};
+        std::chrono::steady_clock::time_point deadline{};
+    };
+
+    FileWatcher(int inotify_fd, int wake_fd, std::uint32_t event_type) noexcept;
+
+    void run() noexcept;
+    void readEvents() noexcept;
+    void updateDirectories() noexcept;
+
+    int m_inotify_fd;
+    int m_wake_fd;
+    std::uint32_t m_event_type;
+    std::atomic_bool m_stopping{false};
+    std::mutex m_mutex{};
+    std::unordered_map<std::uint32_t, WatchedFile> m_files{};
+    std::unordered_map<int, std::filesystem::path> m_directories{};
+    std::unordered_map<std::uint32_t, PendingChange> m_pending_changes{};
+    std::vector<Change> m_changes{};
+    std::thread m_thread{};
+};
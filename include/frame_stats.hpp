@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// Distribution of durations in buckets an eighth of a power of two wide, from a microsecond to over an hour
+/// @note percentiles are the middle of their bucket, within about 6% of the exact value
+class DurationHistogram final {
+   public:
+    static constexpr std::size_t kBucketCount = 256U;
+
+    static std::size_t bucket(std::chrono::steady_clock::duration duration) noexcept;
+
+    void add(std::chrono::steady_clock::duration duration) noexcept;
+    void add(std::size_t bucket, std::uint64_t count) noexcept;
+
+    std::uint64_t count() const noexcept;
+
+    /// Duration that fraction of the samples do not exceed, zero without samples
+    std::chrono::microseconds percentile(double fraction) const noexcept;
+
+    /// Median, 95th and 99th percentiles and the longest duration, e.g. "p50 1.20 p95 3.40 p99 5.10 max 9.80 ms"
+    std::string summary() const noexcept;
+
+    /// Keep only the samples added since earlier, a copy of this histogram taken before
+    DurationHistogram& operator-=(DurationHistogram const& earlier) noexcept;
+
+   private:
+    std::array<std::uint64_t, kBucketCount> m_buckets{};
+    std::uint64_t m_count{};
+};
+
+/// Timings of the repaints of a window, kept by the window on the thread that paints it
+struct WindowFrameStats {
+    std::uint64_t repaints{};
+
+    /// The whole repaint, the texture draw calls (SDL_RenderCopyExF) and the present alone
+    DurationHistogram repaint{};
+    DurationHistogram render{};
+    DurationHistogram present{};
+
+    WindowFrameStats& operator-=(WindowFrameStats const& earlier) noexcept;
+};
+
+/// Counters shared by all the threads, each thread counts in a slot of its own without locks or contention, the
+/// slots are only summed when the stats are read
+namespace FrameStats {
+
+enum Counter { kEvents, kResizeRepaints, kLoads, kCounterCount };
+enum Timing { kEventLatency, kLoadTime, kTimingCount };
+
+/// Sum of the counters of all the threads
+struct Totals {
+    std::array<std::uint64_t, kCounterCount> counters{};
+    std::array<DurationHistogram, kTimingCount> timings{};
+
+    /// Keep only what was counted since earlier, totals taken before
+    Totals& operator-=(Totals const& earlier) noexcept;
+};
+
+/// Count an event of the calling thread
+void count(Counter counter) noexcept;
+
+/// Add a duration measured by the calling thread
+void time(Timing timing, std::chrono::steady_clock::duration duration) noexcept;
+
+/// Sum the slots of all the threads so far
+/// @note a count racing with it lands in these totals or the next ones, never in both
+Totals totals() noexcept;
+
+}  // namespace FrameStats
@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// Number of pixels at each of the 256 levels of the red, green, blue and luma (BT.709) channels
+/// @note counts wrap around, so a histogram may be subtracted from one it is part of, e.g. to move a region
+struct Histogram {
+    enum Channel { kRed, kGreen, kBlue, kLuma, kChannelCount };
+
+    std::array<std::array<std::uint32_t, 256>, kChannelCount> counts{};
+
+    void add(Histogram const& histogram) noexcept;
+    void subtract(Histogram const& histogram) noexcept;
+};
+
+/// Count the pixels of the rect of the surface into histogram, the rect is clipped to the surface
+/// @note 32 bits surfaces are read in place, the luma of 4 (SSE2) or 16 (NEON) pixels is computed at once, the other
+/// formats are converted a row at a time
+void countPixels(SDL_Surface const* surface, SDL_Rect const& rect, Histogram& histogram) noexcept;
+
+/// Count the pixels of the added rects minus the ones of the removed rects on the worker pool, in bands of rows
+/// @note done is called with the sum of all the bands by the worker finishing last, never once cancelled is set
+void countPixelsAsync(SurfacePtr surface, std::vector<SDL_Rect> const& added, std::vector<SDL_Rect> const& removed,
+                      std::shared_ptr<std::atomic_bool const> cancelled,
+                      std::function<void(Histogram const&)> done) noexcept;
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// Decoded surfaces of recently used images, bounded by a budget in bytes and evicted least recently used first
+class ImageCache final {
+   public:
+    /// Cache shared by all image viewers
+    static ImageCache& shared() noexcept;
+
+    explicit ImageCache(std::size_t budget_bytes, std::size_t prefetch_radius) noexcept;
+
+    ImageCache(ImageCache const&) = delete;
+    ImageCache(ImageCache&&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+    ImageCache& operator=(ImageCache&&) = delete;
+
+    ~ImageCache() noexcept;
+
+    void setBudget(std::size_t budget_bytes) noexcept;
+    void setPrefetchRadius(std::size_t prefetch_radius) noexcept;
+
+    std::size_t budget() const noexcept;
+    std::size_t prefetchRadius() const noexcept;
+    std::size_t usedBytes() const noexcept;
+
+    /// Cached surface of the image, null when it is not cached
+    SurfacePtr find(std::filesystem::path const& image_path) noexcept;
+
+    /// Keep the surface unless it alone exceeds the budget
+    void insert(std::filesystem::path const& image_path, SurfacePtr surface) noexcept;
+
+    /// Decode in background the images around index for a requester, e.g. a window id, its earlier prefetches out of
+    /// the range are skipped unless another requester still wants them
+    void prefetchAround(std::uint32_t requester, std::vector<std::filesystem::path> const& image_paths,
+                        std::size_t index) noexcept;
+
+    /// Skip the prefetches of the requester not started yet, e.g. once its window is closed
+    void cancelPrefetch(std::uint32_t requester) noexcept;
+
+   private:
+    struct Entry {
+        std::string key{};
+        SurfacePtr surface{};
+        std::size_t bytes{};
+    };
+
+    void evict() noexcept;
+    bool wanted(std::string const& key) const noexcept;
+
+    mutable std::mutex m_mutex{};
+    std::size_t m_budget_bytes;
+    std::size_t m_prefetch_radius;
+    std::size_t m_used_bytes{};
+    std::list<Entry> m_entries{};
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index{};
+    std::unordered_map<std::uint32_t, std::unordered_set<std::string>> m_wanted{};
+    std::unordered_set<std::string> m_loading{};
+};
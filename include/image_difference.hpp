@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// How the difference of two images is shown
+struct DifferenceOptions {
+    /// Channels differing by threshold or less are shown black
+    int threshold{0};
+
+    /// The other differences are multiplied by gain, a power of two up to 128, and saturate at 255
+    int gain{1};
+};
+
+/// How much two images differ over their red, green and blue channels, alpha is left out
+struct DifferenceStats {
+    /// Largest difference of a channel, from 0 to 255
+    int max_error{};
+
+    /// Peak signal to noise ratio in dB, infinity when the images are identical
+    double psnr{};
+
+    /// Pixels with a channel differing by more than the threshold, out of pixel_count
+    std::uint64_t differing_pixels{};
+    std::uint64_t pixel_count{};
+};
+
+/// Compute the absolute difference of two surfaces of the same size on the worker pool, in bands of rows
+/// @note 32 bits surfaces of the same format are read in place, 4 pixels at a time with SSE2 or NEON, the other ones
+/// are converted a row at a time
+/// @note done is called by the worker finishing last with the difference image, or null and the reason it failed,
+/// never once cancelled is set
+void computeDifferenceAsync(
+    SurfacePtr first_surface, SurfacePtr second_surface, DifferenceOptions options,
+    std::shared_ptr<std::atomic_bool const> cancelled,
+    std::function<void(SurfacePtr difference_surface, DifferenceStats const& stats, std::string const& error)>
+        done) noexcept;
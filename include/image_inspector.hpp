@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "SDL.h"
+#include "histogram.hpp"
+#include "image_loader.hpp"
+
+/// Overlay of an image viewer with the red, green, blue and luma histograms and the value of the pixel under the cursor
+/// @note the histogram of the image is counted once on the worker pool, while zoomed in the one of the visible region
+/// is shown instead, kept up to date by counting only the pixels that enter and leave the view
+/// @note the cursor only reads one pixel of the surface, hovering never counts anything
+class ImageInspector final {
+   public:
+    /// User event type pushed when a histogram is counted, event.user.windowID identifies the viewer
+    static std::uint32_t histogramEventType() noexcept;
+
+    explicit ImageInspector(std::uint32_t window_id) noexcept;
+
+    ImageInspector(ImageInspector const&) = delete;
+    ImageInspector(ImageInspector&&) = delete;
+    ImageInspector& operator=(const ImageInspector&) = delete;
+    ImageInspector& operator=(ImageInspector&&) = delete;
+
+    ~ImageInspector() noexcept;
+
+    /// Inspect another image, null while it is being decoded
+    /// @note a reduced surface is inspected as is, its pixels stand for the image pixels they were reduced from
+    void setSurface(SurfacePtr surface) noexcept;
+
+    /// Part of the image in view, in image coordinates
+    void setVisibleRegion(SDL_Rect const& region) noexcept;
+
+    /// Pixel under the cursor in image coordinates, nothing when the cursor is off the image
+    /// @note returns true when the overlay changed
+    bool setCursor(std::optional<SDL_Point> image_point) noexcept;
+
+    /// Take the histograms counted since the last call, returns true when the overlay changed
+    bool update() noexcept;
+
+    /// Draw the overlay in the bottom left corner of the renderer
+    bool render(SDL_Renderer* renderer, float density) const noexcept;
+
+   private:
+    struct Results;
+
+    /// Bring the region histogram to the requested region, unless a count is already running
+    void countRegion() noexcept;
+
+    /// Surface pixels covering the image rect, clipped to the surface
+    SDL_Rect surfaceRect(SDL_Rect const& image_rect) const noexcept;
+
+    std::uint32_t m_window_id;
+    SurfacePtr m_surface{};
+    SDL_Point m_image_size{};
+    std::shared_ptr<std::atomic_bool> m_cancelled{};
+    std::shared_ptr<Results> m_results{};
+    std::optional<Histogram> m_image_histogram{};
+
+    /// Regions are in surface coordinates, the histogram is the one of m_region
+    std::optional<Histogram> m_region_histogram{};
+    SDL_Rect m_region{};
+    SDL_Rect m_requested_region{};
+    std::optional<SDL_Rect> m_counting_region{};
+    bool m_counting_whole_region{false};
+
+    std::optional<SDL_Point> m_cursor{};
+    SDL_Color m_cursor_color{};
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_image.h"
+#include "SDLit.hpp"
+
+/// Surfaces are shared between the viewers, the caches and the workers writing them to disk, they are never modified
+using SurfacePtr = std::shared_ptr<SDL_Surface>;
+
+/// Called from the decoding thread with a coarse preview of the part of the image decoded so far
+/// @note previews are reduced ARGB8888 surfaces (see makeReducedSurface), the pixels not decoded yet are transparent
+using PreviewCallback = std::function<void(SurfacePtr preview_surface)>;
+
+/// Decode the image file into a surface, safe to call from any thread
+/// @note when cancelled is set while decoding, the decoder is starved of input and the load fails early
+/// @note images larger than the decode size limit are decoded reduced, unless full_resolution is set
+/// @note with a preview callback, large images of the formats with a progressive decoder hand over previews of what
+/// is decoded so far, see decodeProgressive
+SurfacePtr loadImage(std::filesystem::path const& image_path, std::atomic_bool const* cancelled = nullptr,
+                     bool full_resolution = false, PreviewCallback const& preview = {}) noexcept;
+
+/// Decode the image file into a 32 bits surface that fits in thumbnail_size, keeping its aspect ratio
+/// @note the codec scaling is used when available, unlike loadImage nothing goes through the caches
+SurfacePtr loadThumbnail(std::filesystem::path const& image_path, SDL_Point thumbnail_size,
+                         std::atomic_bool const* cancelled = nullptr) noexcept;
+
+/// Images are decoded at about this size when they are larger, {0, 0} (the default) always decodes them in full
+void setDecodeSizeLimit(SDL_Point size_limit) noexcept;
+
+/// Surface decoded smaller than the image it comes from, which has image_size dimensions
+SurfacePtr makeReducedSurface(SurfacePtr surface, SDL_Point image_size) noexcept;
+
+/// Dimensions of the image the surface was decoded from, larger than the surface itself when it was reduced
+SDL_Point imageSize(SurfacePtr const& surface) noexcept;
+
+/// Read the image dimensions from the file header without decoding it
+std::optional<SDL_Point> probeImageSize(std::filesystem::path const& image_path) noexcept;
+
+/// Whether the file extension is one of the image formats supported by SDL_image
+bool isImageFile(std::filesystem::path const& file_path) noexcept;
+
+/// Same as isImageFile() for an extension alone, including its dot, e.g. ".png"
+bool isImageExtension(std::string_view extension) noexcept;
+
+/// Image files found in the directory, in natural order (see naturalLess)
+std::vector<std::filesystem::path> listDirectoryImages(std::filesystem::path const& directory_path) noexcept;
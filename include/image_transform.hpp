@@ -0,0 +1,8 @@
+#pragma once
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// Mirror the surface like the viewer does with flip, then rotate it by quarter_turns clockwise, in a single copy
+/// @note pixels are copied in square blocks, so the rotations by 90 degrees never walk a whole column of the source
+/// @note surfaces of other than 32 bits per pixel are converted first, the surface itself is returned untransformed
+SurfacePtr transformSurface(SurfacePtr const& surface, SDL_RendererFlip flip, int quarter_turns) noexcept;
@@ -1,12 +1,28 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include "SDL.h"
 #include "SDL_image.h"
 #include "SDL_syswm.h"
 #include "SDLit.hpp"
+#include "animation_player.hpp"
+#include "compare_group.hpp"
+#include "directory_index.hpp"
+#include "frame_stats.hpp"
+#include "image_difference.hpp"
+#include "image_inspector.hpp"
+#include "image_loader.hpp"
+#include "tiled_texture.hpp"
 
 /// Pick an image to view using a dialog, returns the path to it if successful otherwise empty
 std::vector<std::filesystem::path> pickImageDialog();
@@ -17,6 +33,24 @@ SDL_FRect resizeToFit(SDL_Rect const& src, SDL_Rect const& dst);
 class ImageViewer final {
    public:
     static std::unique_ptr<ImageViewer> open(std::filesystem::path const image_path) noexcept;
+    static std::unique_ptr<ImageViewer> open(std::filesystem::path const image_path, SurfacePtr image_surface) noexcept;
+
+    /// Show the window with a placeholder right away and decode the image in the background
+    /// @note the texture is swapped in by processLoadedEvent once the decode completes
+    static std::unique_ptr<ImageViewer> openAsync(std::filesystem::path const image_path) noexcept;
+
+    /// User event type pushed when a background load completes, event.user.windowID identifies the viewer
+    static std::uint32_t loadedEventType() noexcept;
+
+    /// User event type pushed when a difference is computed, event.user.windowID identifies the viewer
+    static std::uint32_t differenceEventType() noexcept;
+
+    /// Flips, zoom and pan, with the view center relative to the image size so it applies to images of any size
+    struct ViewState {
+        SDL_RendererFlip flip{};
+        float zoom{1.0f};
+        SDL_FPoint center{0.5f, 0.5f};
+    };
 
     ImageViewer(ImageViewer const&) = delete;
     ImageViewer(ImageViewer&&) = delete;
@@ -26,10 +60,30 @@ class ImageViewer final {
     ~ImageViewer() noexcept;
 
     SDL_Window* window() const noexcept;
+    std::filesystem::path const& imagePath() const noexcept;
     SDL_Renderer* renderer() const noexcept;
-    SDL_Texture* texture() const noexcept;
+    TiledTexture* texture() const noexcept;
     SDL_SysWMinfo* windowManagerInfo() noexcept;
 
+    /// Hidden or minimized, nothing of the image is on screen
+    bool hidden() const noexcept;
+
+    /// Bytes held by the textures of the current and the recently shown images
+    std::size_t textureBytes() const noexcept;
+
+    /// Give texture memory back, keeping only a low resolution version of the current image until restoreTextures()
+    /// @note returns the bytes released
+    std::size_t releaseTextures() noexcept;
+
+    /// Bring the full texture back after releaseTextures(), from the image cache or a new decode
+    void restoreTextures() noexcept;
+
+    /// Whether releaseTextures() gave anything back since the image was last shown in full
+    bool texturesReleased() const noexcept;
+
+    /// Bytes the full texture of the current image held before it was released, about what restoring it takes
+    std::size_t releasedBytes() const noexcept;
+
     bool center() noexcept;
     bool customizeTitlebar() noexcept;
     bool focus() noexcept;
@@ -37,23 +91,206 @@ class ImageViewer final {
     bool repaint() noexcept;
     bool resize() noexcept;
 
+    /// Mark the window contents as outdated, the next update() repaints it
+    void invalidate() noexcept;
+
+    /// Advance the animation when its next frame is due, then repaint when invalidated, at most once per display
+    /// refresh, returns true when a frame was presented
+    bool update() noexcept;
+
+    /// When the pending repaint or the next animation frame is due, nothing when the window is up to date
+    std::optional<std::chrono::steady_clock::time_point> nextUpdateTime() const noexcept;
+
     void flipHorizontal() noexcept;
     void flipVertical() noexcept;
 
+    /// Show or hide the histograms of the image and the value of the pixel under the cursor
+    void toggleInspector() noexcept;
+
+    /// Show or hide the repaint timings and the texture bytes of the window, with the event and load stats of the
+    /// application, refreshed every second
+    void toggleFrameStats() noexcept;
+
+    /// Timings of the repaints of the window since it was opened
+    WindowFrameStats const& frameStats() const noexcept;
+
+    ViewState viewState() const noexcept;
+
+    /// Take over the view of a linked viewer, it is not passed on to the others
+    void setViewState(ViewState const& view_state) noexcept;
+
+    /// Join the compare group, flips, zoom and pan then apply to all its viewers, null leaves it
+    void link(std::shared_ptr<CompareGroup> compare_group) noexcept;
+    std::shared_ptr<CompareGroup> const& compareGroup() const noexcept;
+
+    /// Show the difference with the reference image of the compare group instead of the image, or the image again
+    void toggleDifference() noexcept;
+
+    /// Compute the difference shown again, e.g. after either image changed, nothing when no difference is shown
+    void updateDifference() noexcept;
+
+    /// Add images as tabs of the window, they are only decoded once shown
+    /// @note the window turns into a tabbed one, with the current image as its first tab
+    void addTabs(std::vector<std::filesystem::path> const& image_paths) noexcept;
+
+    /// Tabs of the window, none unless it is a tabbed one
+    std::size_t tabCount() const noexcept;
+
+    /// Show the image of another tab, with the view it was left with
+    bool showTab(std::size_t tab_index) noexcept;
+    bool showNextTab() noexcept;
+    bool showPreviousTab() noexcept;
+
+    /// Close the current tab and show the next one
+    /// @note returns false when there is no other tab, the window should close instead
+    bool closeTab() noexcept;
+
+    /// Step through the images in the directory of the current one, in natural order
+    /// @note while the directory is still being indexed, only the images found so far are stepped through
+    bool showNext() noexcept;
+    bool showPrevious() noexcept;
+    bool showFirst() noexcept;
+    bool showLast() noexcept;
+
+    void processKeyboardEvent(SDL_KeyboardEvent const& event);
     void processMouseButtonEvent(SDL_MouseButtonEvent const& event);
     void processMouseMotionEvent(SDL_MouseMotionEvent const& event);
     void processMouseWheelEvent(SDL_MouseWheelEvent const& event);
 
+    /// Swap in the texture of a background load, or of its latest preview, returns false when the image could not be
+    /// loaded
+    bool processLoadedEvent(SDL_UserEvent const& event) noexcept;
+
+    /// Decode the image again in the background after its file changed at changed_at, the view is kept as is
+    /// @note the time from the change to the first present of the new version is logged and traced
+    void reload(std::chrono::steady_clock::time_point changed_at) noexcept;
+
    private:
-    explicit ImageViewer(std::filesystem::path image_path, SDL_SysWMinfo window_info,
+    /// Mapping of the visible part of the image to the window, view coordinates are image coordinates after flip
+    struct Viewport {
+        SDL_FRect view{};
+        SDL_FRect dst{};
+        float scale{};
+    };
+
+    /// Decode result handed over from the worker to the main thread
+    struct PendingLoad {
+        std::atomic_bool cancelled{false};
+        std::mutex mutex{};
+        bool completed{false};
+        bool fit_window{false};
+        std::optional<std::chrono::steady_clock::time_point> changed_at{};
+        SurfacePtr surface{};
+        std::string error{};
+
+        /// Latest preview of a progressive decode not shown yet, until the load completes
+        SurfacePtr preview{};
+    };
+
+    /// Stats of the last complete period shown by the frame stats overlay, and where the current period started
+    struct FrameStatsOverlay {
+        std::chrono::steady_clock::time_point period_start{};
+        WindowFrameStats window_baseline{};
+        FrameStats::Totals totals_baseline{};
+        std::optional<std::chrono::steady_clock::duration> period{};
+        WindowFrameStats window_period{};
+        FrameStats::Totals totals_period{};
+    };
+
+    /// Image of a tab and its view, kept while another tab is shown
+    struct Tab {
+        std::filesystem::path image_path{};
+        std::optional<ViewState> view_state{};
+    };
+
+    /// Difference result handed over from the workers to the main thread
+    struct PendingDifference {
+        std::atomic_bool cancelled{false};
+        std::mutex mutex{};
+        bool completed{false};
+        SurfacePtr surface{};
+        DifferenceStats stats{};
+        std::string error{};
+    };
+
+    explicit ImageViewer(std::filesystem::path image_path, SDL_Rect image_rect, SDL_SysWMinfo window_info,
                          std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> window,
                          std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> renderer,
-                         std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> texture) noexcept;
+                         std::unique_ptr<TiledTexture> texture) noexcept;
+
+    void loadAsync(bool fit_window, bool full_resolution) noexcept;
+    DirectoryIndex& directoryIndex() noexcept;
+    bool showImage(std::filesystem::path image_path) noexcept;
+    void resetView() noexcept;
+    void updateTitle() noexcept;
+
+    /// Switch to the tab without keeping the view of the current one, which may be gone
+    bool enterTab(std::size_t tab_index) noexcept;
+
+    /// Strip along the top of the window with a cell per tab, in pixels, empty unless the window has several tabs
+    SDL_FRect tabBarRect() const noexcept;
+    bool renderTabBar() const noexcept;
+
+    /// Hand the pixels of the current image over to the inspector, when it is shown
+    /// @note without a surface, the image cache is looked up, then the image decoded again
+    void inspect(SurfacePtr image_surface) noexcept;
+
+    /// Play the current image when it is animated, the texture is then updated with each frame
+    void startAnimation() noexcept;
+    void showFrame(SurfacePtr frame_surface) noexcept;
+
+    /// Apply the view to the other viewers of the compare group
+    void syncView() noexcept;
+
+    /// Show the latest preview of the pending load, returns true until the load completes
+    bool takePreview() noexcept;
+
+    /// Swap in the texture of a completed difference, returns true when the window changed
+    bool takeDifference() noexcept;
+    void changeDifferenceOptions(DifferenceOptions difference_options) noexcept;
+
+    /// Draw the difference statistics in the bottom right corner of the window
+    bool renderDifferenceStats() const noexcept;
+
+    /// Draw the frame stats in the top right corner of the window, below the tab bar
+    bool renderFrameStats() const noexcept;
+
+    Viewport viewport() const noexcept;
+
+    /// Image pixel at the window point x, y, nothing when the point is off the image
+    std::optional<SDL_Point> imagePointAt(int x, int y) const noexcept;
+    float pixelDensity() const noexcept;
+    std::chrono::steady_clock::duration refreshInterval() const noexcept;
 
     std::filesystem::path m_image_path;
+    SDL_Rect m_image_rect;
     SDL_SysWMinfo m_window_info;
     std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> m_window;
     std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> m_renderer;
-    std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> m_texture;
+    std::unique_ptr<TiledTexture> m_texture;
     SDL_RendererFlip m_flip{};
+    float m_zoom{1.0f};
+    SDL_FPoint m_view_center{};
+    bool m_dirty{false};
+    bool m_texture_released{false};
+    std::size_t m_released_bytes{};
+    bool m_preview_shown{false};
+    bool m_full_resolution_requested{false};
+    std::chrono::steady_clock::time_point m_last_present{};
+    std::shared_ptr<PendingLoad> m_pending_load{};
+    std::unique_ptr<AnimationPlayer> m_animation{};
+    std::optional<std::chrono::steady_clock::time_point> m_reload_changed_at{};
+    std::optional<std::chrono::steady_clock::time_point> m_load_started_at{};
+    std::shared_ptr<DirectoryIndex> m_directory_index{};
+    std::unique_ptr<ImageInspector> m_inspector{};
+    std::shared_ptr<CompareGroup> m_compare_group{};
+    std::optional<DifferenceOptions> m_difference_options{};
+    std::shared_ptr<PendingDifference> m_pending_difference{};
+    std::unique_ptr<TiledTexture> m_difference_texture{};
+    std::optional<DifferenceStats> m_difference_stats{};
+    std::vector<Tab> m_tabs{};
+    std::size_t m_current_tab{};
+    WindowFrameStats m_frame_stats{};
+    std::unique_ptr<FrameStatsOverlay> m_frame_stats_overlay{};
+    std::list<std::pair<std::filesystem::path, std::unique_ptr<TiledTexture>>> m_recent_textures{};
 };
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+#include <filesystem>
+
+#include "SDL.h"
+
+/// Encode the surface in the format named by the file extension (png, jpg, bmp, qoi and webp when available)
+/// @note quality is only used by lossy formats, in the 0-100 range
+bool saveImage(SDL_Surface* surface, std::filesystem::path const& image_path, int quality = 90) noexcept;
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SDL.h"
+
+/// Local socket through which later invocations hand their images to the first running instance
+/// @note received paths are pushed as SDL_DROPFILE events, the main loop opens them like dropped files
+class InstanceServer final {
+   public:
+    /// Per user socket location shared by every instance
+    static std::filesystem::path defaultSocketPath() noexcept;
+
+    /// Send the images to the instance listening on socket_path, returns false when there is none
+    static bool forward(std::filesystem::path const& socket_path,
+                        std::vector<std::filesystem::path> const& image_paths) noexcept;
+
+    /// Start accepting images on socket_path, fails when another instance already owns it
+    static std::unique_ptr<InstanceServer> listen(std::filesystem::path socket_path) noexcept;
+
+    InstanceServer(InstanceServer const&) = delete;
+    InstanceServer(InstanceServer&&) = delete;
+    InstanceServer& operator=(const InstanceServer&) = delete;
+    InstanceServer& operator=(InstanceServer&&) = delete;
+
+    /// Stop accepting connections and remove the socket
+    ~InstanceServer() noexcept;
+
+   private:
+    InstanceServer(std::filesystem::path socket_path, int listen_fd) noexcept;
+
+    void run() noexcept;
+
+    std::filesystem::path m_socket_path;
+    int m_listen_fd;
+    std::atomic_bool m_stopping{false};
+    std::thread m_thread{};
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "SDL.h"
+
+#if IMGV2_HAVE_LIBJPEG
+#include <cstdio>
+#include <jpeglib.h>
+
+/// Decompressor handed to the function reading the pixels of decodeJpegWith
+struct JpegDecode {
+    jpeg_decompress_struct info{};
+
+    /// Surface the pixels are read into, freed when libjpeg reports an error
+    SDL_Surface* volatile surface{};
+};
+
+/// Set libjpeg up on the JPEG in data, read its header, then have read_pixels pick the scale of the RGB output and read
+/// it into surface
+/// @note libjpeg reports errors with SDL_SetError then longjmp out of read_pixels, nothing with a destructor may live
+/// in it, quiet drops the warnings, e.g. of an input cut short on purpose
+/// @note returns null when read_pixels returns false, for CMYK images as libjpeg has no conversion of them to RGB, and
+/// on failure
+SDL_Surface* decodeJpegWith(std::uint8_t const* data, std::size_t size, bool quiet,
+                            std::function<bool(JpegDecode& decode)> const& read_pixels) noexcept;
+
+/// RGB24 surface of the output size of the decompressor, into decode.surface
+bool createJpegSurface(JpegDecode& decode) noexcept;
+
+/// Read the output rows up to end_row into decode.surface
+void readJpegRows(JpegDecode& decode, JDIMENSION end_row);
+
+/// Stop the decode with message as the error, e.g. once it is cancelled
+[[noreturn]] void failJpegDecode(JpegDecode& decode, char const* message);
+#endif
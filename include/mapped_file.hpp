@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "SDL.h"
+
+/// Read only view of a whole file, memory mapped when possible and read in memory otherwise (pipes, special files)
+/// @note the contents must outlive every stream returned by rwops()
+class MappedFile final {
+   public:
+    static std::unique_ptr<MappedFile> open(std::filesystem::path const& file_path) noexcept;
+
+    /// Files opened from then on are only mapped when allowed, otherwise they are read in memory
+    /// @note a mapped file truncated while it is read, e.g. rewritten in place by another program, kills the process
+    /// with SIGBUS, so mapping is left out when files are expected to change under the viewer
+    static void setMappingAllowed(bool allowed) noexcept;
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    ~MappedFile() noexcept;
+
+    std::uint8_t const* data() const noexcept;
+    std::size_t size() const noexcept;
+
+    /// Whether the contents are mapped from the page cache instead of copied in memory
+    bool mapped() const noexcept;
+
+    /// Stream over the contents, to be handed to SDL_image
+    SDL_RWops* rwops() const noexcept;
+
+   private:
+    MappedFile(void* mapping, std::size_t mapping_size, std::vector<std::uint8_t> bytes) noexcept;
+
+    void* m_mapping;
+    std::size_t m_mapping_size;
+    std::vector<std::uint8_t> m_bytes;
+};
@@ -0,0 +1,7 @@
+#pragma once
+#include "SDL.h"
+#include "image_loader.hpp"
+
+/// Halve the surface dimensions with a 2x2 box filter, vectorized with SSE2 or NEON when available
+/// @note only 32 bits per pixel surfaces are supported, channels are averaged regardless of their order
+SurfacePtr downsampleSurface(SDL_Surface const* surface) noexcept;
@@ -0,0 +1,13 @@
+#pragma once
+#include <string_view>
+
+#include "SDL.h"
+
+/// Text of the overlays, drawn with a built-in 3x5 pixels font so no font library is needed
+/// @note digits, letters (lower case ones are shown upper case), space and . - + / : %, other characters are blank
+
+/// Size of the text where each font pixel is pixel_size, in the same unit
+SDL_FPoint textSize(std::string_view text, float pixel_size) noexcept;
+
+/// Draw the text in the current draw color with its top left corner at origin
+bool renderText(SDL_Renderer* renderer, std::string_view text, SDL_FPoint origin, float pixel_size) noexcept;
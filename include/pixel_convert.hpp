@@ -0,0 +1,22 @@
+#pragma once
+#include <optional>
+
+#include "SDL.h"
+
+/// Copy the rect of the surface into pixels laid out in format, e.g. the scratch rows uploaded to the tiles with
+/// SDL_UpdateTexture, or the rows compared for a difference or counted in a histogram
+/// @note RGB24, RGBA32 and BGRA32 to 32 bits conversions are vectorized with SSE2/SSSE3 or NEON when available,
+/// the other ones go through SDL_ConvertPixels
+bool convertPixels(SDL_Surface const* surface, SDL_Rect const& rect, Uint32 format, void* pixels, int pitch) noexcept;
+
+/// Position of the channels in the bytes of a pixel, in memory order
+struct ByteChannels {
+    int red{};
+    int green{};
+    int blue{};
+    int alpha{};
+};
+
+/// Channels of 32 bits formats with 8 bits channels, e.g. RGBA32 or ARGB8888, nothing for the other formats
+/// @note the alpha byte of formats without alpha is the padding one
+std::optional<ByteChannels> byteChannels(Uint32 format) noexcept;
@@ -0,0 +1,21 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <string_view>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+#include "mapped_file.hpp"
+
+/// Decode the image in full, handing previews of the part decoded so far to preview along the way
+/// @note handles JPEG, built with libjpeg, and PNG, built with libpng, progressive JPEG and interlaced PNG get a coarse
+/// preview of the whole image after their first scan or pass, the others fill in from the top band by band
+/// @note previews are handed over a few times a second at most, from the calling thread
+/// @note returns null for other formats, for images small enough to be decoded at once, on failure and once cancelled
+/// is set, the regular decode takes over for the first ones
+SurfacePtr decodeProgressive(MappedFile const& image_file, std::string_view extension,
+                             std::atomic_bool const* cancelled, PreviewCallback const& preview) noexcept;
+
+/// Whether the image is large enough and of a format for decodeProgressive to show it while it is decoded
+/// @note only the header of the file is read
+bool decodesProgressively(std::filesystem::path const& image_path) noexcept;
@@ -0,0 +1,14 @@
+#pragma once
+#include <string_view>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+#include "mapped_file.hpp"
+
+/// Decode the image with the codec scaling, to the smallest size still covering size_limit
+/// @note handles JPEG (DCT scaling by 1/2, 1/4 and 1/8) and still WebP, built with libjpeg and libwebp respectively,
+/// returns null for other formats or when the image is not large enough to be reduced
+SurfacePtr decodeReduced(MappedFile const& image_file, std::string_view extension, SDL_Point size_limit) noexcept;
+
+/// Halve the decoded surface with a box filter until it is about to get smaller than size_limit
+SurfacePtr downscaleToLimit(SurfacePtr surface, SDL_Point size_limit) noexcept;
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <unordered_set>
+
+class ImageViewer;
+
+/// Memory budget shared by the textures of every viewer window
+/// @note over budget, hidden and minimized windows give their textures back first, then the least recently focused
+/// ones, the most recently focused window is never touched
+/// @note windows keep a low resolution version of their image and restore it when they get the focus, or when they
+/// are exposed and it fits in the budget
+/// @note a visible window restored since the last focus change is not released again, so a window painted in the
+/// background is not rebuilt and released over and over
+/// @note only used from the main thread, like the windows themselves
+class TextureBudget final {
+   public:
+    /// Budget shared by all image viewers
+    static TextureBudget& shared() noexcept;
+
+    explicit TextureBudget(std::size_t budget_bytes) noexcept;
+
+    TextureBudget(TextureBudget const&) = delete;
+    TextureBudget(TextureBudget&&) = delete;
+    TextureBudget& operator=(const TextureBudget&) = delete;
+    TextureBudget& operator=(TextureBudget&&) = delete;
+
+    ~TextureBudget() noexcept;
+
+    void setBudget(std::size_t budget_bytes) noexcept;
+
+    std::size_t budget() const noexcept;
+
+    /// Bytes held by the textures of all the windows, as of the last enforce()
+    std::size_t usedBytes() const noexcept;
+
+    /// Windows register themselves for their whole lifetime, a new one counts as the most recently focused
+    void add(ImageViewer* image_viewer) noexcept;
+    void remove(ImageViewer* image_viewer) noexcept;
+
+    /// The window got the focus, its textures are the last ones to be released and are restored if they were
+    void touch(ImageViewer* image_viewer) noexcept;
+
+    /// The window was exposed, shown or restored, its textures are restored when they fit in the budget
+    void expose(ImageViewer* image_viewer) noexcept;
+
+    /// Release textures until they fit in the budget, the usage is logged and traced as it changes
+    void enforce() noexcept;
+
+   private:
+    std::size_t m_budget_bytes;
+    std::size_t m_used_bytes{};
+    std::list<ImageViewer*> m_image_viewers{};
+    std::unordered_set<ImageViewer const*> m_restored_image_viewers{};
+};
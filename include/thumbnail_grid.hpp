@@ -0,0 +1,109 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "SDL.h"
+#include "SDLit.hpp"
+#include "image_loader.hpp"
+
+/// Window showing many images at once as a grid of thumbnails, to browse directories too large for a window each
+/// @note thumbnails are decoded by the worker pool, the visible rows first, then the ones a screen ahead and behind
+/// @note they are packed in a single atlas texture, the slots of the thumbnails farthest from the view are reused, so
+/// memory stays the same whatever the number of images
+class ThumbnailGrid final {
+   public:
+    static std::unique_ptr<ThumbnailGrid> open(std::vector<std::filesystem::path> image_paths) noexcept;
+
+    /// User event type pushed when decoded thumbnails are ready, event.user.windowID identifies the grid
+    static std::uint32_t thumbnailEventType() noexcept;
+
+    ThumbnailGrid(ThumbnailGrid const&) = delete;
+    ThumbnailGrid(ThumbnailGrid&&) = delete;
+    ThumbnailGrid& operator=(const ThumbnailGrid&) = delete;
+    ThumbnailGrid& operator=(ThumbnailGrid&&) = delete;
+
+    ~ThumbnailGrid() noexcept;
+
+    SDL_Window* window() const noexcept;
+
+    bool repaint() noexcept;
+
+    /// Mark the window contents as outdated, the next update() repaints it
+    void invalidate() noexcept;
+
+    /// Upload the thumbnails decoded since the last call, then repaint when invalidated, at most once per display
+    /// refresh, returns true when a frame was presented
+    bool update() noexcept;
+
+    /// When the pending repaint is due, nothing when the window is up to date
+    std::optional<std::chrono::steady_clock::time_point> nextUpdateTime() const noexcept;
+
+    /// Arrows, page up/down, home and end move the selection, returns the image to open on enter
+    std::optional<std::filesystem::path> processKeyboardEvent(SDL_KeyboardEvent const& event) noexcept;
+
+    /// A click selects the thumbnail under the cursor, returns the image to open on double click
+    std::optional<std::filesystem::path> processMouseButtonEvent(SDL_MouseButtonEvent const& event) noexcept;
+
+    void processMouseWheelEvent(SDL_MouseWheelEvent const& event) noexcept;
+
+   private:
+    struct Pipeline;
+
+    /// Cells of the grid in window pixels
+    struct Layout {
+        int columns{};
+        int rows{};
+        int cell_size{};
+        int margin{};
+    };
+
+    explicit ThumbnailGrid(std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> window,
+                           std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> renderer,
+                           std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> atlas, int atlas_columns,
+                           std::shared_ptr<Pipeline> pipeline) noexcept;
+
+    /// Hand the requested thumbnails over to the worker pool, in as many tasks as there are idle workers
+    static void decodeThumbnails(std::shared_ptr<Pipeline> const& pipeline) noexcept;
+    static void decodeNextThumbnail(std::shared_ptr<Pipeline> const& pipeline) noexcept;
+
+    std::size_t imageCount() const noexcept;
+    int thumbnailSize() const noexcept;
+    Layout layout() const noexcept;
+    SDL_Point windowSize() const noexcept;
+    float pixelDensity() const noexcept;
+    std::chrono::steady_clock::duration refreshInterval() const noexcept;
+
+    /// Range of images with a cell at least partly in the window
+    std::pair<std::size_t, std::size_t> visibleRange() const noexcept;
+
+    void scrollTo(int scroll_offset) noexcept;
+    void select(std::size_t image_index) noexcept;
+    void takeThumbnails() noexcept;
+    void requestThumbnails() noexcept;
+    bool storeThumbnail(std::size_t image_index, SDL_Surface const* thumbnail_surface) noexcept;
+    std::optional<std::size_t> imageAt(int x, int y) const noexcept;
+
+    std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> m_window;
+    std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> m_renderer;
+    std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> m_atlas;
+    int m_atlas_columns;
+    std::shared_ptr<Pipeline> m_pipeline;
+
+    /// Atlas slot of each image, or -1, and the image and thumbnail size in each slot
+    std::vector<int> m_image_slots;
+    std::vector<std::size_t> m_slot_images;
+    std::vector<SDL_Point> m_slot_sizes;
+    std::vector<bool> m_failed;
+
+    int m_scroll_offset{};
+    std::size_t m_selected{};
+    bool m_dirty{false};
+    std::pair<std::size_t, std::size_t> m_requested_range{};
+    std::chrono::steady_clock::time_point m_last_present{};
+};
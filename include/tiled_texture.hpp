@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "SDL.h"
+#include "SDLit.hpp"
+#include "image_loader.hpp"
+
+/// Image uploaded to a renderer as a grid of textures, so its size is not bound to the renderer max texture size
+/// @note levels that fit in a single texture are uploaded at once and their surface is released
+/// @note the surface is only read, so it may be shared with the image cache
+/// @note a pyramid of downscaled levels is kept, so the renderer never minifies by more than half
+/// @note pixels are converted in bands into static textures of a format native to the renderer, so no copy of them is
+/// kept in system memory
+class TiledTexture final {
+   public:
+    static std::unique_ptr<TiledTexture> create(SDL_Renderer* renderer, SurfacePtr surface) noexcept;
+
+    TiledTexture(TiledTexture const&) = delete;
+    TiledTexture(TiledTexture&&) = delete;
+    TiledTexture& operator=(const TiledTexture&) = delete;
+    TiledTexture& operator=(TiledTexture&&) = delete;
+
+    ~TiledTexture() noexcept;
+
+    /// Dimensions of the image, render() takes its coordinates even when the texture was made from a reduced decode
+    int width() const noexcept;
+    int height() const noexcept;
+
+    /// Texture pixels per image pixel, 1 unless the surface was decoded reduced
+    float resolution() const noexcept;
+
+    /// Bytes currently held by the uploaded tiles
+    std::size_t residentBytes() const noexcept;
+
+    /// Drop every level but the smallest one, to give memory back while the image is not looked at closely
+    /// @note false when there was nothing to drop, the image then has to be created again to get its detail back
+    bool releaseDetail() noexcept;
+
+    /// Write the pixels of a surface of the same size in place, e.g. the next frame of an animation
+    /// @note the tiles already uploaded are rewritten, the other ones of tiled levels are uploaded from surface when
+    /// shown, so it is kept like the one given to create()
+    bool update(SurfacePtr surface) noexcept;
+
+    /// Draw the src region of the image (in image coordinates) into dst, uploading only the tiles it intersects
+    bool render(SDL_FRect const& src, SDL_FRect const& dst, SDL_RendererFlip flip) noexcept;
+
+   private:
+    struct Tile {
+        SDL_Rect rect{};
+        std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> texture{};
+        std::uint64_t last_used_frame{};
+    };
+
+    /// One step of the pyramid, level 0 has the full resolution and every next one half of the previous
+    struct Level {
+        SurfacePtr surface{};
+        int width{};
+        int height{};
+        int tile_size{};
+        int columns{};
+        Uint32 texture_format{};
+        std::vector<Tile> tiles{};
+    };
+
+    explicit TiledTexture(SDL_Renderer* renderer, SDL_Point image_size, std::vector<Level> levels) noexcept;
+
+    static bool makeLevel(SDL_Renderer* renderer, SDL_RendererInfo const& renderer_info, SurfacePtr surface,
+                          Level& level) noexcept;
+    static std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> createTexture(SDL_Renderer* renderer,
+                                                                          SDL_Surface const* surface,
+                                                                          SDL_Rect const& rect,
+                                                                          Uint32 texture_format) noexcept;
+    static bool writeTexture(SDL_Texture* texture, SDL_Surface const* surface, SDL_Rect const& rect,
+                             Uint32 texture_format) noexcept;
+
+    bool renderLevel(Level& level, SDL_FRect const& src, SDL_FRect const& dst, SDL_RendererFlip flip) noexcept;
+    bool upload(Level& level, Tile& tile) noexcept;
+    void evictUnusedTiles(Level& level, std::size_t visible_tiles) noexcept;
+
+    SDL_Renderer* m_renderer;
+    SDL_Point m_image_size;
+    std::vector<Level> m_levels;
+    std::uint64_t m_frame{};
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+#define IMGV2_TRACE_CONCAT_INNER(a, b) a##b
+#define IMGV2_TRACE_CONCAT(a, b) IMGV2_TRACE_CONCAT_INNER(a, b)
+
+/// Record the time spent until the end of the enclosing block, image may be null when the stage has none
+#define TRACE_SCOPE(name, image) TraceScope const IMGV2_TRACE_CONCAT(trace_scope_, __LINE__)(name, image)
+
+/// Timings of the startup stages, written as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev)
+/// @note while disabled, recording costs a relaxed atomic load
+namespace Trace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Start recording, the trace is written to trace_path by write()
+void enable(std::filesystem::path trace_path) noexcept;
+
+bool enabled() noexcept;
+
+/// Record a stage that ran on the calling thread between start and end
+void record(char const* name, char const* image, Clock::time_point start, Clock::time_point end) noexcept;
+
+/// Record the value of a counter at this moment, shown as a graph along the stages
+void counter(char const* name, std::int64_t value) noexcept;
+
+/// Write the events recorded so far, nothing happens when disabled
+bool write() noexcept;
+
+}  // namespace Trace
+
+/// Record the lifetime of the scope as a stage of the calling thread
+class TraceScope final {
+   public:
+    TraceScope(char const* name, char const* image) noexcept;
+
+    TraceScope(TraceScope const&) = delete;
+    TraceScope(TraceScope&&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    TraceScope& operator=(TraceScope&&) = delete;
+
+    ~TraceScope() noexcept;
+
+   private:
+    char const* m_name;
+    char const* m_image;
+    Trace::Clock::time_point m_start{};
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of threads that run tasks away from the main thread
+class WorkerPool final {
+   public:
+    using Task = std::function<void()>;
+
+    /// Pool shared by the whole application, sized after the number of cpu cores
+    static WorkerPool& shared() noexcept;
+
+    explicit WorkerPool(std::size_t thread_count);
+
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    /// Drop the pending tasks and wait for the running ones to finish
+    ~WorkerPool() noexcept;
+
+    std::size_t size() const noexcept;
+
+    /// Queue a task to be run by the first idle thread
+    void submit(Task task);
+
+   private:
+    void run() noexcept;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_tasks;
+    std::vector<std::thread> m_threads;
+    bool m_stopping{false};
+};
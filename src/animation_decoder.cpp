@@ -0,0 +1,799 @@
+#include "animation_decoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "SDL_image.h"
+#include "SDLit.hpp"
+#include "byte_order.hpp"
+#include "mapped_file.hpp"
+
+#if IMGV2_HAVE_LIBWEBPDEMUX
+#include <webp/demux.h>
+#endif
+
+namespace {
+
+/// Browsers play frames with a shorter delay at this pace, many files rely on it
+constexpr std::chrono::milliseconds kMinFrameDelay{20};
+constexpr std::chrono::milliseconds kDefaultFrameDelay{100};
+
+std::chrono::milliseconds frameDelay(std::chrono::milliseconds delay) noexcept {
+    return delay < kMinFrameDelay ? kDefaultFrameDelay : delay;
+}
+
+void appendBE32(std::vector<std::uint8_t>& bytes, std::uint32_t value) {
+    bytes.insert(bytes.end(), {static_cast<std::uint8_t>(value >> 24), static_cast<std::uint8_t>(value >> 16),
+                               static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value)});
+}
+
+/// Canvas the frames are composed on, RGBA with straight alpha and transparent to begin with
+SurfacePtr createCanvas(SDL_Point size) noexcept {
+    SurfacePtr canvas =
+        SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, size.x, size.y, 32, SDL_PIXELFORMAT_RGBA32);
+    if (canvas) {
+        SDL_FillRect(canvas.get(), nullptr, 0);
+    }
+    return canvas;
+}
+
+/// Copy of the canvas handed out as a frame, the canvas itself keeps being composed on
+SurfacePtr copyCanvas(SDL_Surface* canvas) noexcept { return SDLit::make_unique(SDL_DuplicateSurface, canvas); }
+
+/// Put back the pixels of rect saved before the frame was drawn, for the "restore to previous" disposal
+void restoreRect(SDL_Surface const* saved_canvas, SDL_Surface* canvas, SDL_Rect const& rect) noexcept {
+    for (int y = rect.y; y < rect.y + rect.h; ++y) {
+        std::memcpy(static_cast<std::uint8_t*>(canvas->pixels) + y * canvas->pitch + rect.x * 4,
+                    static_cast<std::uint8_t const*>(saved_canvas->pixels) + y * saved_canvas->pitch + rect.x * 4,
+                    static_cast<std::size_t>(rect.w) * 4U);
+    }
+}
+
+/// Save a copy of the canvas, allocated once and reused for every frame that needs it
+bool saveCanvas(SDL_Surface* canvas, SurfacePtr& saved_canvas) noexcept {
+    if (not saved_canvas) {
+        saved_canvas = copyCanvas(canvas);
+        return static_cast<bool>(saved_canvas);
+    }
+    std::memcpy(saved_canvas->pixels, canvas->pixels,
+                static_cast<std::size_t>(canvas->pitch) * static_cast<std::size_t>(canvas->h));
+    return true;
+}
+
+/// Walk over a chain of GIF sub-blocks, false when the file ends before its terminator
+bool skipSubBlocks(std::uint8_t const* data, std::size_t size, std::size_t& position) noexcept {
+    while (position < size) {
+        std::size_t const block_size = data[position++];
+        if (block_size == 0U) {
+            return true;
+        }
+        position += block_size;
+    }
+    return false;
+}
+
+/// Row of the image stored at decoded_row, GIF interlacing stores every 8th row first then fills the gaps
+int interlacedRow(int decoded_row, int height) noexcept {
+    int const first_pass = (height + 7) / 8;
+    if (decoded_row < first_pass) {
+        return decoded_row * 8;
+    }
+    decoded_row -= first_pass;
+
+    int const second_pass = (height + 3) / 8;
+    if (decoded_row < second_pass) {
+        return 4 + decoded_row * 8;
+    }
+    decoded_row -= second_pass;
+
+    int const third_pass = (height + 1) / 4;
+    if (decoded_row < third_pass) {
+        return 2 + decoded_row * 4;
+    }
+    decoded_row -= third_pass;
+    return 1 + decoded_row * 2;
+}
+
+class GifDecoder final : public AnimationDecoder {
+   public:
+    static std::unique_ptr<AnimationDecoder> open(std::unique_ptr<MappedFile> image_file) noexcept {
+        std::uint8_t const* data = image_file->data();
+        std::size_t const size = image_file->size();
+        if (size < 13U || std::memcmp(data, "GIF8", 4) != 0) {
+            SDL_SetError("not a gif file");
+            return {nullptr};
+        }
+
+        SDL_Point const canvas_size{readLE16(data + 6), readLE16(data + 8)};
+        std::uint8_t const screen_flags = data[10];
+        std::size_t position = 13U;
+        std::size_t palette_position = 0U;
+        int palette_colors = 0;
+        if (screen_flags & 0x80U) {
+            palette_position = position;
+            palette_colors = 2 << (screen_flags & 0x07U);
+            position += static_cast<std::size_t>(palette_colors) * 3U;
+        }
+        std::size_t const first_block = position;
+
+        // Only a second frame has to be found to know it is animated, the rest of the file is read while playing
+        int frame_count = 0;
+        while (position < size && frame_count < 2) {
+            std::uint8_t const block_type = data[position++];
+            if (block_type == 0x21U && position < size) {
+                ++position;
+                if (not skipSubBlocks(data, size, position)) {
+                    break;
+                }
+            } else if (block_type == 0x2CU && position + 10U <= size) {
+                std::uint8_t const image_flags = data[position + 8];
+                position += 9U;
+                if (image_flags & 0x80U) {
+                    position += static_cast<std::size_t>(2 << (image_flags & 0x07U)) * 3U;
+                }
+                ++position;
+                if (not skipSubBlocks(data, size, position)) {
+                    break;
+                }
+                ++frame_count;
+            } else {
+                break;
+            }
+        }
+
+        if (frame_count < 2 || canvas_size.x <= 0 || canvas_size.y <= 0 || position > size) {
+            SDL_SetError("gif is not animated");
+            return {nullptr};
+        }
+
+        SurfacePtr canvas = createCanvas(canvas_size);
+        if (not canvas) {
+            return {nullptr};
+        }
+        return std::unique_ptr<AnimationDecoder>{new GifDecoder{std::move(image_file), canvas_size, palette_position,
+                                                                palette_colors, first_block, std::move(canvas)}};
+    }
+
+    SDL_Point size() const noexcept override { return m_size; }
+
+    bool next(AnimationFrame& frame) noexcept override {
+        std::uint8_t const* data = m_file->data();
+        std::size_t const size = m_file->size();
+        disposePreviousFrame();
+
+        // Graphic control extension of the frame, when it has one
+        int disposal = 0;
+        int transparent_index = -1;
+        std::chrono::milliseconds delay{};
+        while (m_position < size) {
+            std::uint8_t const block_type = data[m_position++];
+            if (block_type == 0x3BU) {
+                break;
+            } else if (block_type == 0x21U && m_position < size) {
+                std::uint8_t const label = data[m_position++];
+                if (label == 0xF9U && m_position + 5U <= size && data[m_position] >= 4U) {
+                    std::uint8_t const control_flags = data[m_position + 1];
+                    disposal = (control_flags >> 2) & 0x07;
+                    delay = std::chrono::milliseconds{readLE16(data + m_position + 2) * 10};
+                    transparent_index = (control_flags & 0x01U) ? data[m_position + 4] : -1;
+                }
+                if (not skipSubBlocks(data, size, m_position)) {
+                    break;
+                }
+            } else if (block_type == 0x2CU) {
+                if (not drawImage(transparent_index, disposal == 3)) {
+                    return false;
+                }
+                m_disposal = disposal;
+                frame.surface = copyCanvas(m_canvas.get());
+                frame.delay = frameDelay(delay);
+                return static_cast<bool>(frame.surface);
+            } else {
+                SDL_SetError("corrupted gif block 0x%02x", block_type);
+                return false;
+            }
+        }
+
+        SDL_SetError("no more frames");
+        return false;
+    }
+
+    bool rewind() noexcept override {
+        m_position = m_first_block;
+        m_disposal = 0;
+        m_frame_rect = SDL_Rect{};
+        return SDL_FillRect(m_canvas.get(), nullptr, 0) == 0;
+    }
+
+   private:
+    /// String table of the LZW decompression, every code is a previous code followed by one more index
+    struct LzwTable {
+        std::array<std::uint16_t, 4096> prefix{};
+        std::array<std::uint8_t, 4096> suffix{};
+        std::array<std::uint8_t, 4096> first{};
+        std::array<std::uint16_t, 4096> length{};
+    };
+
+    GifDecoder(std::unique_ptr<MappedFile> file, SDL_Point size, std::size_t palette_position, int palette_colors,
+               std::size_t first_block, SurfacePtr canvas) noexcept
+        : m_file{std::move(file)},
+          m_size{size},
+          m_palette_position{palette_position},
+          m_palette_colors{palette_colors},
+          m_first_block{first_block},
+          m_position{first_block},
+          m_canvas{std::move(canvas)} {}
+
+    void disposePreviousFrame() noexcept {
+        if (m_disposal == 2) {
+            SDL_FillRect(m_canvas.get(), &m_frame_rect, 0);
+        } else if (m_disposal == 3 && m_saved_canvas) {
+            restoreRect(m_saved_canvas.get(), m_canvas.get(), m_frame_rect);
+        }
+        m_disposal = 0;
+    }
+
+    /// Decode the image starting at the image descriptor and draw it over the canvas
+    bool drawImage(int transparent_index, bool save_canvas) noexcept {
+        std::uint8_t const* data = m_file->data();
+        std::size_t const size = m_file->size();
+        if (m_position + 10U > size) {
+            SDL_SetError("truncated gif image descriptor");
+            return false;
+        }
+
+        int const left = readLE16(data + m_position);
+        int const top = readLE16(data + m_position + 2);
+        int const width = readLE16(data + m_position + 4);
+        int const height = readLE16(data + m_position + 6);
+        std::uint8_t const image_flags = data[m_position + 8];
+        m_position += 9U;
+
+        std::size_t palette_position = m_palette_position;
+        int palette_colors = m_palette_colors;
+        if (image_flags & 0x80U) {
+            palette_position = m_position;
+            palette_colors = 2 << (image_flags & 0x07U);
+            m_position += static_cast<std::size_t>(palette_colors) * 3U;
+        }
+        if (m_position >= size) {
+            SDL_SetError("truncated gif image");
+            return false;
+        }
+
+        int const min_code_size = data[m_position++];
+        if (min_code_size < 1 || min_code_size > 11) {
+            SDL_SetError("invalid gif lzw code size %d", min_code_size);
+            return false;
+        }
+
+        // Pixels missing from a truncated image are left transparent
+        m_indices.assign(static_cast<std::size_t>(width) * static_cast<std::size_t>(height),
+                         static_cast<std::uint8_t>(transparent_index >= 0 ? transparent_index : 0));
+        decodeLzw(min_code_size);
+
+        SDL_Rect const image_rect{left, top, width, height};
+        SDL_Rect const canvas_rect{0, 0, m_size.x, m_size.y};
+        if (not SDL_IntersectRect(&image_rect, &canvas_rect, &m_frame_rect)) {
+            m_frame_rect = SDL_Rect{};
+        }
+        if (save_canvas && not saveCanvas(m_canvas.get(), m_saved_canvas)) {
+            return false;
+        }
+
+        bool const interlaced = (image_flags & 0x40U) != 0U;
+        std::uint8_t const* palette = data + palette_position;
+        for (int decoded_row = 0; decoded_row < height; ++decoded_row) {
+            int const y = top + (interlaced ? interlacedRow(decoded_row, height) : decoded_row);
+            if (y < m_frame_rect.y || y >= m_frame_rect.y + m_frame_rect.h) {
+                continue;
+            }
+
+            std::uint8_t const* indices =
+                m_indices.data() + static_cast<std::size_t>(decoded_row) * static_cast<std::size_t>(width);
+            auto* pixels = static_cast<std::uint8_t*>(m_canvas->pixels) + y * m_canvas->pitch;
+            for (int x = m_frame_rect.x; x < m_frame_rect.x + m_frame_rect.w; ++x) {
+                int const index = indices[x - left];
+                if (index == transparent_index || index >= palette_colors) {
+                    continue;
+                }
+                std::memcpy(pixels + x * 4, palette + index * 3, 3U);
+                pixels[x * 4 + 3] = 0xFF;
+            }
+        }
+        return true;
+    }
+
+    /// Decompress the sub-blocks at the current position into m_indices, the position ends right after them
+    void decodeLzw(int min_code_size) noexcept {
+        std::uint8_t const* data = m_file->data();
+        std::size_t const size = m_file->size();
+
+        std::size_t block_remaining = 0U;
+        bool blocks_ended = false;
+        auto const read_byte = [&](std::uint32_t& byte) -> bool {
+            if (block_remaining == 0U) {
+                if (blocks_ended || m_position >= size) {
+                    return false;
+                }
+                block_remaining = data[m_position++];
+                if (block_remaining == 0U) {
+                    blocks_ended = true;
+                    return false;
+                }
+            }
+            if (m_position >= size) {
+                return false;
+            }
+            byte = data[m_position++];
+            --block_remaining;
+            return true;
+        };
+
+        int const clear_code = 1 << min_code_size;
+        int const end_code = clear_code + 1;
+        for (int code = 0; code < clear_code; ++code) {
+            m_table.suffix[code] = static_cast<std::uint8_t>(code);
+            m_table.first[code] = static_cast<std::uint8_t>(code);
+            m_table.length[code] = 1U;
+        }
+
+        int code_size = min_code_size + 1;
+        int next_code = clear_code + 2;
+        int previous_code = -1;
+        std::uint32_t bits = 0U;
+        int bit_count = 0;
+        std::size_t written = 0U;
+        std::size_t const index_count = m_indices.size();
+        while (written < index_count) {
+            bool has_code = true;
+            while (bit_count < code_size && has_code) {
+                std::uint32_t byte{};
+                has_code = read_byte(byte);
+                bits |= byte << bit_count;
+                bit_count += 8;
+            }
+            if (not has_code) {
+                break;
+            }
+
+            int const code = static_cast<int>(bits & ((1U << code_size) - 1U));
+            bits >>= code_size;
+            bit_count -= code_size;
+
+            if (code == clear_code) {
+                code_size = min_code_size + 1;
+                next_code = clear_code + 2;
+                previous_code = -1;
+                continue;
+            } else if (code == end_code) {
+                break;
+            } else if (previous_code < 0) {
+                if (code >= clear_code) {
+                    break;
+                }
+                m_indices[written++] = m_table.suffix[code];
+                previous_code = code;
+                continue;
+            } else if (code > next_code || (code == next_code && next_code >= 4096)) {
+                break;
+            }
+
+            // A code not in the table yet can only be the previous string followed by its own first index
+            if (next_code < 4096) {
+                std::uint8_t const first_index = code < next_code ? m_table.first[code] : m_table.first[previous_code];
+                m_table.prefix[next_code] = static_cast<std::uint16_t>(previous_code);
+                m_table.suffix[next_code] = first_index;
+                m_table.first[next_code] = m_table.first[previous_code];
+                m_table.length[next_code] = static_cast<std::uint16_t>(m_table.length[previous_code] + 1U);
+                ++next_code;
+                if (next_code == (1 << code_size) && code_size < 12) {
+                    ++code_size;
+                }
+            }
+
+            // Strings are chains from their last index back to the first one, written from the end
+            std::size_t const length = m_table.length[code];
+            int string_code = code;
+            for (std::size_t i = length; i > 0U; string_code = m_table.prefix[string_code]) {
+                --i;
+                if (written + i < index_count) {
+                    m_indices[written + i] = m_table.suffix[string_code];
+                }
+            }
+            written = std::min(written + length, index_count);
+            previous_code = code;
+        }
+
+        if (not blocks_ended) {
+            m_position += block_remaining;
+            skipSubBlocks(data, size, m_position);
+        }
+    }
+
+    std::unique_ptr<MappedFile> m_file;
+    SDL_Point m_size;
+    std::size_t m_palette_position;
+    int m_palette_colors;
+    std::size_t m_first_block;
+    std::size_t m_position;
+    SurfacePtr m_canvas;
+    SurfacePtr m_saved_canvas{};
+    SDL_Rect m_frame_rect{};
+    int m_disposal{};
+    std::vector<std::uint8_t> m_indices{};
+    LzwTable m_table{};
+};
+
+/// CRC of the PNG chunks, required by the decoder on the chunks put together for each frame
+std::uint32_t pngCrc(std::uint8_t const* data, std::size_t size, std::uint32_t crc = 0xFFFFFFFFU) noexcept {
+    static auto const table = [] {
+        std::array<std::uint32_t, 256> crc_table{};
+        for (std::uint32_t n = 0; n < 256U; ++n) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1U) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            }
+            crc_table[n] = c;
+        }
+        return crc_table;
+    }();
+
+    for (std::size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFFU] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+/// Draw the RGBA surface over the canvas at rect, both with straight alpha
+void composeOver(SDL_Surface const* surface, SDL_Surface* canvas, SDL_Rect const& rect) noexcept {
+    for (int y = 0; y < rect.h; ++y) {
+        auto const* source = static_cast<std::uint8_t const*>(surface->pixels) + y * surface->pitch;
+        auto* output = static_cast<std::uint8_t*>(canvas->pixels) + (rect.y + y) * canvas->pitch + rect.x * 4;
+        for (int x = 0; x < rect.w; ++x, source += 4, output += 4) {
+            std::uint32_t const source_alpha = source[3];
+            if (source_alpha == 0xFFU || output[3] == 0U) {
+                std::memcpy(output, source, 4U);
+                continue;
+            }
+
+            std::uint32_t const output_alpha = output[3] * (0xFFU - source_alpha) / 0xFFU;
+            std::uint32_t const alpha = source_alpha + output_alpha;
+            if (alpha == 0U) {
+                continue;
+            }
+            for (int channel = 0; channel < 3; ++channel) {
+                std::uint32_t const blended = source[channel] * source_alpha + output[channel] * output_alpha;
+                output[channel] = static_cast<std::uint8_t>(blended / alpha);
+            }
+            output[3] = static_cast<std::uint8_t>(alpha);
+        }
+    }
+}
+
+class ApngDecoder final : public AnimationDecoder {
+   public:
+    static std::unique_ptr<AnimationDecoder> open(std::unique_ptr<MappedFile> image_file) noexcept {
+        std::uint8_t const* data = image_file->data();
+        std::size_t const size = image_file->size();
+        if (size < 33U || std::memcmp(data, "\x89PNG\r\n\x1A\n", 8) != 0 ||
+            std::memcmp(data + 12, "IHDR", 4) != 0) {
+            SDL_SetError("not a png file");
+            return {nullptr};
+        }
+
+        std::unique_ptr<ApngDecoder> decoder{new ApngDecoder{std::move(image_file)}};
+        decoder->m_size = SDL_Point{static_cast<int>(readBE32(data + 16)), static_cast<int>(readBE32(data + 20))};
+
+        // Only the chunk layout is kept, frames are put back together from the file when they are decoded
+        bool animated = false;
+        bool image_data_seen = false;
+        bool default_image_is_frame = false;
+        for (std::size_t position = 8U; position + 12U <= size;) {
+            std::size_t const chunk_size = readBE32(data + position);
+            std::string_view const chunk_type{reinterpret_cast<char const*>(data + position + 4), 4U};
+            std::size_t const chunk_data = position + 8U;
+            if (chunk_size > size - chunk_data - 4U) {
+                break;
+            }
+
+            if (chunk_type == "acTL") {
+                animated = true;
+            } else if (chunk_type == "fcTL" && chunk_size >= 26U) {
+                decoder->m_frames.push_back(parseFrameControl(data + chunk_data));
+            } else if (chunk_type == "IDAT") {
+                // The default image is the first frame only when a frame control precedes it
+                if (not image_data_seen) {
+                    default_image_is_frame = decoder->m_frames.size() == 1U;
+                    image_data_seen = true;
+                }
+                if (default_image_is_frame) {
+                    decoder->m_frames.front().data.emplace_back(chunk_data, chunk_size);
+                }
+            } else if (chunk_type == "fdAT" && chunk_size >= 4U && not decoder->m_frames.empty()) {
+                decoder->m_frames.back().data.emplace_back(chunk_data + 4U, chunk_size - 4U);
+            } else if (chunk_type == "IEND") {
+                break;
+            } else if (not image_data_seen && chunk_type != "IHDR") {
+                decoder->m_shared_chunks.emplace_back(position, chunk_size + 12U);
+            }
+            position = chunk_data + chunk_size + 4U;
+        }
+
+        decoder->m_frames.erase(std::remove_if(decoder->m_frames.begin(), decoder->m_frames.end(),
+                                               [](Frame const& frame) { return frame.data.empty(); }),
+                                decoder->m_frames.end());
+        if (not animated || decoder->m_frames.size() < 2U || decoder->m_size.x <= 0 || decoder->m_size.y <= 0) {
+            SDL_SetError("png is not animated");
+            return {nullptr};
+        }
+
+        decoder->m_canvas = createCanvas(decoder->m_size);
+        if (not decoder->m_canvas) {
+            return {nullptr};
+        }
+        return decoder;
+    }
+
+    SDL_Point size() const noexcept override { return m_size; }
+
+    bool next(AnimationFrame& frame) noexcept override {
+        if (m_next_frame >= m_frames.size()) {
+            SDL_SetError("no more frames");
+            return false;
+        }
+
+        // The previous frame is disposed of only now, it had to be shown first
+        if (m_dispose_op == 1) {
+            SDL_FillRect(m_canvas.get(), &m_frame_rect, 0);
+        } else if (m_dispose_op == 2 && m_saved_canvas) {
+            restoreRect(m_saved_canvas.get(), m_canvas.get(), m_frame_rect);
+        }
+
+        Frame const& current_frame = m_frames[m_next_frame];
+        SurfacePtr frame_surface = decodeFrame(current_frame);
+        if (not frame_surface) {
+            return false;
+        }
+
+        SDL_Rect const canvas_rect{0, 0, m_size.x, m_size.y};
+        if (not SDL_IntersectRect(&current_frame.rect, &canvas_rect, &m_frame_rect)) {
+            m_frame_rect = SDL_Rect{};
+        }
+        m_frame_rect.w = std::min(m_frame_rect.w, frame_surface->w);
+        m_frame_rect.h = std::min(m_frame_rect.h, frame_surface->h);
+
+        // Restoring the first frame to the previous one clears it
+        m_dispose_op = current_frame.dispose_op == 2 && m_next_frame == 0U ? 1 : current_frame.dispose_op;
+        if (m_dispose_op == 2 && not saveCanvas(m_canvas.get(), m_saved_canvas)) {
+            return false;
+        }
+
+        if (current_frame.blend_op == 1) {
+            composeOver(frame_surface.get(), m_canvas.get(), m_frame_rect);
+        } else {
+            SDL_Rect const source_rect{0, 0, m_frame_rect.w, m_frame_rect.h};
+            SDL_Rect output_rect = m_frame_rect;
+            SDL_SetSurfaceBlendMode(frame_surface.get(), SDL_BLENDMODE_NONE);
+            if (SDL_BlitSurface(frame_surface.get(), &source_rect, m_canvas.get(), &output_rect)) {
+                return false;
+            }
+        }
+
+        ++m_next_frame;
+        frame.surface = copyCanvas(m_canvas.get());
+        frame.delay = frameDelay(current_frame.delay);
+        return static_cast<bool>(frame.surface);
+    }
+
+    bool rewind() noexcept override {
+        m_next_frame = 0U;
+        m_dispose_op = 0;
+        m_frame_rect = SDL_Rect{};
+        return SDL_FillRect(m_canvas.get(), nullptr, 0) == 0;
+    }
+
+   private:
+    struct Frame {
+        SDL_Rect rect{};
+        std::chrono::milliseconds delay{};
+        int dispose_op{};
+        int blend_op{};
+        /// Offset and size of the compressed image data, spread over one or more chunks
+        std::vector<std::pair<std::size_t, std::size_t>> data{};
+    };
+
+    static Frame parseFrameControl(std::uint8_t const* chunk_data) noexcept {
+        Frame frame{};
+        frame.rect = SDL_Rect{static_cast<int>(readBE32(chunk_data + 12)), static_cast<int>(readBE32(chunk_data + 16)),
+                              static_cast<int>(readBE32(chunk_data + 4)), static_cast<int>(readBE32(chunk_data + 8))};
+        int const delay_numerator = readBE16(chunk_data + 20);
+        int const delay_denominator = readBE16(chunk_data + 22) != 0U ? readBE16(chunk_data + 22) : 100;
+        frame.delay = std::chrono::milliseconds{delay_numerator * 1000 / delay_denominator};
+        frame.dispose_op = chunk_data[24];
+        frame.blend_op = chunk_data[25];
+        return frame;
+    }
+
+    explicit ApngDecoder(std::unique_ptr<MappedFile> file) noexcept : m_file{std::move(file)} {}
+
+    /// Put the frame back together as a still PNG of its own size and decode it
+    SurfacePtr decodeFrame(Frame const& frame) noexcept {
+        std::uint8_t const* data = m_file->data();
+        std::size_t png_size = 8U + 25U + 12U;
+        for (auto const& [offset, chunk_size] : m_shared_chunks) {
+            png_size += chunk_size;
+        }
+        for (auto const& [offset, chunk_size] : frame.data) {
+            png_size += chunk_size + 12U;
+        }
+        m_png.clear();
+        m_png.reserve(png_size);
+
+        auto const append_chunk = [this](char const* type, std::uint8_t const* chunk_data, std::size_t chunk_size) {
+            appendBE32(m_png, static_cast<std::uint32_t>(chunk_size));
+            std::size_t const type_position = m_png.size();
+            m_png.insert(m_png.end(), type, type + 4);
+            m_png.insert(m_png.end(), chunk_data, chunk_data + chunk_size);
+            appendBE32(m_png, pngCrc(m_png.data() + type_position, chunk_size + 4U) ^ 0xFFFFFFFFU);
+        };
+
+        m_png.insert(m_png.end(), data, data + 8);
+        std::array<std::uint8_t, 13> header{};
+        std::memcpy(header.data(), data + 16, header.size());
+        for (int i = 0; i < 4; ++i) {
+            header[i] = static_cast<std::uint8_t>(static_cast<std::uint32_t>(frame.rect.w) >> (24 - i * 8));
+            header[4 + i] = static_cast<std::uint8_t>(static_cast<std::uint32_t>(frame.rect.h) >> (24 - i * 8));
+        }
+        append_chunk("IHDR", header.data(), header.size());
+        for (auto const& [offset, chunk_size] : m_shared_chunks) {
+            m_png.insert(m_png.end(), data + offset, data + offset + chunk_size);
+        }
+        for (auto const& [offset, chunk_size] : frame.data) {
+            append_chunk("IDAT", data + offset, chunk_size);
+        }
+        append_chunk("IEND", nullptr, 0U);
+
+        SDL_RWops* source = SDL_RWFromConstMem(m_png.data(), static_cast<int>(m_png.size()));
+        if (source == nullptr) {
+            return {nullptr};
+        }
+        auto frame_surface = SDLit::make_unique(IMG_LoadTyped_RW, source, 1, "PNG");
+        if (not frame_surface) {
+            return {nullptr};
+        }
+        return SDLit::make_unique(SDL_ConvertSurfaceFormat, frame_surface.get(), SDL_PIXELFORMAT_RGBA32, 0);
+    }
+
+    std::unique_ptr<MappedFile> m_file;
+    SDL_Point m_size{};
+    std::vector<std::pair<std::size_t, std::size_t>> m_shared_chunks{};
+    std::vector<Frame> m_frames{};
+    std::size_t m_next_frame{};
+    SurfacePtr m_canvas{};
+    SurfacePtr m_saved_canvas{};
+    SDL_Rect m_frame_rect{};
+    int m_dispose_op{};
+    std::vector<std::uint8_t> m_png{};
+};
+
+#if IMGV2_HAVE_LIBWEBPDEMUX
+class WebpDecoder final : public AnimationDecoder {
+   public:
+    static std::unique_ptr<AnimationDecoder> open(std::unique_ptr<MappedFile> image_file) noexcept {
+        WebPAnimDecoderOptions options{};
+        if (not WebPAnimDecoderOptionsInit(&options)) {
+            SDL_SetError("incompatible libwebpdemux");
+            return {nullptr};
+        }
+        options.color_mode = MODE_RGBA;
+        options.use_threads = 0;
+
+        WebPData const webp_data{image_file->data(), image_file->size()};
+        WebPAnimDecoder* decoder = WebPAnimDecoderNew(&webp_data, &options);
+        if (decoder == nullptr) {
+            SDL_SetError("failed to parse webp animation");
+            return {nullptr};
+        }
+
+        WebPAnimInfo info{};
+        if (not WebPAnimDecoderGetInfo(decoder, &info) || info.frame_count < 2U) {
+            WebPAnimDecoderDelete(decoder);
+            SDL_SetError("webp is not animated");
+            return {nullptr};
+        }
+
+        SDL_Point const canvas_size{static_cast<int>(info.canvas_width), static_cast<int>(info.canvas_height)};
+        return std::unique_ptr<AnimationDecoder>{new WebpDecoder{std::move(image_file), decoder, canvas_size}};
+    }
+
+    ~WebpDecoder() noexcept override { WebPAnimDecoderDelete(m_decoder); }
+
+    SDL_Point size() const noexcept override { return m_size; }
+
+    bool next(AnimationFrame& frame) noexcept override {
+        if (not WebPAnimDecoderHasMoreFrames(m_decoder)) {
+            SDL_SetError("no more frames");
+            return false;
+        }
+
+        std::uint8_t* pixels = nullptr;
+        int timestamp = 0;
+        if (not WebPAnimDecoderGetNext(m_decoder, &pixels, &timestamp)) {
+            SDL_SetError("failed to decode webp frame");
+            return false;
+        }
+
+        // The decoder composes the canvas itself and reuses it for the next frame
+        frame.surface = createCanvas(m_size);
+        if (not frame.surface) {
+            return false;
+        }
+        auto const row_size = static_cast<std::size_t>(m_size.x) * 4U;
+        for (int y = 0; y < m_size.y; ++y) {
+            std::memcpy(static_cast<std::uint8_t*>(frame.surface->pixels) + y * frame.surface->pitch,
+                        pixels + y * row_size, row_size);
+        }
+        frame.delay = frameDelay(std::chrono::milliseconds{timestamp - m_timestamp});
+        m_timestamp = timestamp;
+        return true;
+    }
+
+    bool rewind() noexcept override {
+        WebPAnimDecoderReset(m_decoder);
+        m_timestamp = 0;
+        return true;
+    }
+
+   private:
+    WebpDecoder(std::unique_ptr<MappedFile> file, WebPAnimDecoder* decoder, SDL_Point size) noexcept
+        : m_file{std::move(file)}, m_decoder{decoder}, m_size{size} {}
+
+    std::unique_ptr<MappedFile> m_file;
+    WebPAnimDecoder* m_decoder;
+    SDL_Point m_size;
+    int m_timestamp{};
+};
+#endif
+
+}  // namespace
+
+std::unique_ptr<AnimationDecoder> AnimationDecoder::open(std::filesystem::path const& image_path) noexcept {
+    auto image_file = MappedFile::open(image_path);
+    if (not image_file) {
+        return {nullptr};
+    }
+
+    // Told apart by their signature, the extension may lie
+    std::uint8_t const* data = image_file->data();
+    std::size_t const size = image_file->size();
+    if (size >= 4U && std::memcmp(data, "GIF8", 4) == 0) {
+        return GifDecoder::open(std::move(image_file));
+    } else if (size >= 8U && std::memcmp(data, "\x89PNG", 4) == 0) {
+        return ApngDecoder::open(std::move(image_file));
+    } else if (size >= 12U && std::memcmp(data, "RIFF", 4) == 0 && std::memcmp(data + 8, "WEBP", 4) == 0) {
+#if IMGV2_HAVE_LIBWEBPDEMUX
+        return WebpDecoder::open(std::move(image_file));
+#else
+        SDL_SetError("webp animations need libwebpdemux");
+        return {nullptr};
+#endif
+    }
+
+    SDL_SetError("%s is not an animation format", image_path.c_str());
+    return {nullptr};
+}
+
+bool AnimationDecoder::isAnimationFile(std::filesystem::path const& file_path) noexcept {
+    std::string extension = file_path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".gif" || extension == ".png" || extension == ".apng" || extension == ".webp";
+}
@@ -0,0 +1,158 @@
+#include "animation_player.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include "animation_decoder.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+/// Frames decoded ahead are kept under this many bytes, but there are always a few of them to absorb hiccups
+constexpr std::size_t kMaxQueuedBytes = 64U * 1024U * 1024U;
+constexpr std::size_t kMinQueuedFrames = 2U;
+constexpr std::size_t kMaxQueuedFrames = 8U;
+
+}  // namespace
+
+/// Shared with the decoding task, so the player may be destroyed while a frame is being decoded
+struct AnimationPlayer::State {
+    std::filesystem::path image_path{};
+    std::uint32_t window_id{};
+    std::atomic_bool cancelled{false};
+
+    // Only touched by the decoding task, which never runs twice at once
+    std::unique_ptr<AnimationDecoder> decoder{};
+    bool opened{false};
+
+    mutable std::mutex mutex{};
+    std::deque<AnimationFrame> frames{};
+    std::size_t max_frames{kMinQueuedFrames};
+    bool decoding{false};
+    bool finished{false};
+    std::chrono::steady_clock::time_point next_frame_time{};
+};
+
+std::unique_ptr<AnimationPlayer> AnimationPlayer::open(std::filesystem::path const& image_path,
+                                                       std::uint32_t window_id) noexcept {
+    if (not AnimationDecoder::isAnimationFile(image_path)) {
+        SDL_SetError("%s is not an animation format", image_path.c_str());
+        return {nullptr};
+    }
+
+    auto state = std::make_shared<State>();
+    state->image_path = image_path;
+    state->window_id = window_id;
+    decodeAhead(state);
+    return std::unique_ptr<AnimationPlayer>{new AnimationPlayer{std::move(state)}};
+}
+
+std::uint32_t AnimationPlayer::frameDecodedEventType() noexcept {
+    static std::uint32_t const frame_decoded_event_type{SDL_RegisterEvents(1)};
+    return frame_decoded_event_type;
+}
+
+AnimationPlayer::AnimationPlayer(std::shared_ptr<State> state) noexcept : m_state{std::move(state)} {}
+
+AnimationPlayer::~AnimationPlayer() noexcept { m_state->cancelled = true; }
+
+std::optional<std::chrono::steady_clock::time_point> AnimationPlayer::nextFrameTime() const noexcept {
+    std::lock_guard lock{m_state->mutex};
+    if (m_state->frames.empty()) {
+        return std::nullopt;
+    }
+    return m_state->next_frame_time;
+}
+
+SurfacePtr AnimationPlayer::takeFrame(std::chrono::steady_clock::time_point now) noexcept {
+    AnimationFrame frame{};
+    {
+        std::lock_guard lock{m_state->mutex};
+        if (m_state->frames.empty() || now < m_state->next_frame_time) {
+            return {nullptr};
+        }
+        frame = std::move(m_state->frames.front());
+        m_state->frames.pop_front();
+
+        // Keep the pace of the file, unless the frame came so late that catching up would rush through the next ones
+        m_state->next_frame_time += frame.delay;
+        if (m_state->next_frame_time < now) {
+            m_state->next_frame_time = now + frame.delay;
+        }
+    }
+
+    decodeAhead(m_state);
+    return std::move(frame.surface);
+}
+
+void AnimationPlayer::decodeAhead(std::shared_ptr<State> const& state) noexcept {
+    {
+        std::lock_guard lock{state->mutex};
+        if (state->decoding || state->finished || state->frames.size() >= state->max_frames) {
+            return;
+        }
+        state->decoding = true;
+    }
+
+    WorkerPool::shared().submit([state] {
+        if (not state->opened) {
+            TRACE_SCOPE("open animation", state->image_path.c_str());
+            state->opened = true;
+            state->decoder = AnimationDecoder::open(state->image_path);
+
+            std::lock_guard lock{state->mutex};
+            if (not state->decoder) {
+                // Still images end up here as well, they simply never get a frame
+                state->finished = true;
+                state->decoding = false;
+                return;
+            }
+            SDL_Point const size = state->decoder->size();
+            std::size_t const frame_bytes = static_cast<std::size_t>(size.x) * static_cast<std::size_t>(size.y) * 4U;
+            state->max_frames = std::clamp(kMaxQueuedBytes / std::max<std::size_t>(frame_bytes, 1U),
+                                           kMinQueuedFrames, kMaxQueuedFrames);
+        }
+
+        for (;;) {
+            {
+                std::lock_guard lock{state->mutex};
+                if (state->cancelled || state->frames.size() >= state->max_frames) {
+                    state->decoding = false;
+                    return;
+                }
+            }
+
+            // Animations loop forever, the decoder starts over after the last frame
+            AnimationFrame frame{};
+            bool const decoded =
+                state->decoder->next(frame) || (state->decoder->rewind() && state->decoder->next(frame));
+            if (not decoded) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Stopped playing %s: %s", state->image_path.c_str(),
+                            SDL_GetError());
+                std::lock_guard lock{state->mutex};
+                state->finished = true;
+                state->decoding = false;
+                return;
+            }
+
+            bool was_empty{};
+            {
+                std::lock_guard lock{state->mutex};
+                was_empty = state->frames.empty();
+                state->frames.push_back(std::move(frame));
+            }
+
+            // The event loop only needs waking up when it has no frame to schedule
+            if (was_empty) {
+                SDL_Event event{};
+                event.type = frameDecodedEventType();
+                event.user.windowID = state->window_id;
+                SDL_PushEvent(&event);
+            }
+        }
+    });
+}
@@ -0,0 +1,114 @@
+#include "batch_export.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+#include "image_loader.hpp"
+#include "image_transform.hpp"
+#include "image_writer.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+/// File names in the output directory, in the order of the inputs
+std::vector<std::filesystem::path> outputPaths(std::vector<std::filesystem::path> const& image_paths,
+                                               ExportOptions const& options) noexcept {
+    std::vector<std::filesystem::path> output_paths{};
+    std::set<std::filesystem::path> taken_paths{};
+    output_paths.reserve(image_paths.size());
+    for (auto const& image_path : image_paths) {
+        auto const stem = image_path.stem().string();
+        auto output_path = options.output_directory / (stem + "." + options.format);
+        for (int suffix = 2; taken_paths.contains(output_path); ++suffix) {
+            output_path = options.output_directory / (stem + "-" + std::to_string(suffix) + "." + options.format);
+        }
+        taken_paths.insert(output_path);
+        output_paths.push_back(std::move(output_path));
+    }
+    return output_paths;
+}
+
+bool exportImage(std::filesystem::path const& image_path, std::filesystem::path const& output_path,
+                 ExportOptions const& options) noexcept {
+    // Fitting comes first so the transforms and the encoder only go through the pixels that are kept, the bounds
+    // are turned along with the image
+    SurfacePtr image_surface{};
+    {
+        TRACE_SCOPE("decode", image_path.c_str());
+        if (options.fit_size.x > 0 && options.fit_size.y > 0) {
+            SDL_Point const fit_size =
+                options.quarter_turns % 2 != 0 ? SDL_Point{options.fit_size.y, options.fit_size.x} : options.fit_size;
+            image_surface = loadThumbnail(image_path, fit_size);
+        } else {
+            image_surface = loadImage(image_path, nullptr, true);
+        }
+    }
+    if (not image_surface) {
+        return false;
+    }
+
+    {
+        TRACE_SCOPE("transform", image_path.c_str());
+        image_surface = transformSurface(image_surface, options.flip, options.quarter_turns);
+    }
+    if (not image_surface) {
+        return false;
+    }
+
+    TRACE_SCOPE("encode", output_path.c_str());
+    return saveImage(image_surface.get(), output_path, options.quality);
+}
+
+}  // namespace
+
+std::size_t exportImages(std::vector<std::filesystem::path> const& image_paths, ExportOptions const& options) noexcept {
+    std::error_code error{};
+    std::filesystem::create_directories(options.output_directory, error);
+    if (error) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create %s: %s", options.output_directory.c_str(),
+                     error.message().c_str());
+        return image_paths.size();
+    }
+
+    auto const output_paths = outputPaths(image_paths, options);
+    auto const export_start = std::chrono::steady_clock::now();
+
+    // One task per image, the pool keeps as many in memory at once as it has threads
+    std::mutex done_mutex{};
+    std::condition_variable done_condition{};
+    std::size_t done_count{};
+    std::atomic_size_t failure_count{};
+    for (std::size_t i = 0; i < image_paths.size(); ++i) {
+        WorkerPool::shared().submit([&image_paths, &output_paths, &options, &done_mutex, &done_condition, &done_count,
+                                     &failure_count, i] {
+            if (exportImage(image_paths[i], output_paths[i], options)) {
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Exported %s to %s", image_paths[i].c_str(),
+                            output_paths[i].c_str());
+            } else {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to export %s: %s", image_paths[i].c_str(),
+                             SDL_GetError());
+                ++failure_count;
+            }
+
+            std::lock_guard lock{done_mutex};
+            ++done_count;
+            done_condition.notify_one();
+        });
+    }
+
+    {
+        std::unique_lock lock{done_mutex};
+        done_condition.wait(lock, [&done_count, &image_paths] { return done_count == image_paths.size(); });
+    }
+
+    auto const export_end = std::chrono::steady_clock::now();
+    Trace::record("export", nullptr, export_start, export_end);
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Exported %zu of %zu images in %.1f seconds (%zu threads)",
+                image_paths.size() - failure_count.load(), image_paths.size(),
+                std::chrono::duration<double>(export_end - export_start).count(), WorkerPool::shared().size());
+    return failure_count.load();
+}
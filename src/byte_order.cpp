@@ -0,0 +1,19 @@
+#include "byte_order.hpp"
+
+std::uint16_t readLE16(std::uint8_t const* data) noexcept {
+    return static_cast<std::uint16_t>((data[1] << 8) | data[0]);
+}
+
+std::uint16_t readBE16(std::uint8_t const* data) noexcept {
+    return static_cast<std::uint16_t>((data[0] << 8) | data[1]);
+}
+
+std::uint32_t readLE32(std::uint8_t const* data) noexcept {
+    return (std::uint32_t{data[3]} << 24) | (std::uint32_t{data[2]} << 16) | (std::uint32_t{data[1]} << 8) |
+           std::uint32_t{data[0]};
+}
+
+std::uint32_t readBE32(std::uint8_t const* data) noexcept {
+    return (std::uint32_t{data[0]} << 24) | (std::uint32_t{data[1]} << 16) | (std::uint32_t{data[2]} << 8) |
+           std::uint32_t{data[3]};
+}
@@ -0,0 +1,54 @@
+#include "compare_group.hpp"
+
+#include <algorithm>
+
+#include "image_viewer.hpp"
+
+CompareGroup::CompareGroup() noexcept {}
+
+CompareGroup::~CompareGroup() noexcept {}
+
+void CompareGroup::add(ImageViewer* image_viewer) noexcept {
+    if (std::find(m_image_viewers.begin(), m_image_viewers.end(), image_viewer) == m_image_viewers.end()) {
+        m_image_viewers.push_back(image_viewer);
+    }
+}
+
+void CompareGroup::remove(ImageViewer* image_viewer) noexcept {
+    std::vector<ImageViewer*> compared_viewers{};
+    for (auto* other_viewer : m_image_viewers) {
+        if (other_viewer != image_viewer && reference(other_viewer) == image_viewer) {
+            compared_viewers.push_back(other_viewer);
+        }
+    }
+
+    std::erase(m_image_viewers, image_viewer);
+    for (auto* compared_viewer : compared_viewers) {
+        compared_viewer->updateDifference();
+    }
+}
+
+std::vector<ImageViewer*> const& CompareGroup::imageViewers() const noexcept { return m_image_viewers; }
+
+ImageViewer* CompareGroup::reference(ImageViewer const* image_viewer) const noexcept {
+    auto it = std::find_if(m_image_viewers.begin(), m_image_viewers.end(),
+                           [image_viewer](ImageViewer const* other_viewer) { return other_viewer != image_viewer; });
+    return it != m_image_viewers.end() ? *it : nullptr;
+}
+
+void CompareGroup::followView(ImageViewer const* image_viewer) noexcept {
+    auto const view_state = image_viewer->viewState();
+    for (auto* other_viewer : m_image_viewers) {
+        if (other_viewer != image_viewer) {
+            other_viewer->setViewState(view_state);
+        }
+    }
+}
+
+void CompareGroup::imageChanged(ImageViewer const* image_viewer) noexcept {
+    for (auto* other_viewer : m_image_viewers) {
+        if (other_viewer == image_viewer || reference(other_viewer) == image_viewer) {
+            other_viewer->updateDifference();
+        }
+    }
+}
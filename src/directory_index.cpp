@@ -0,0 +1,249 @@
+#include "directory_index.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+#include "SDL.h"
+#include "image_loader.hpp"
+#include "trace.hpp"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <dirent.h>
+#define IMGV2_DIRECTORY_INDEX_DIRENT 1
+#else
+#define IMGV2_DIRECTORY_INDEX_DIRENT 0
+#endif
+
+namespace {
+
+/// Names are published in batches, the first one small so navigation starts early, then as large as the index so
+/// merging them stays linear overall
+constexpr std::size_t kFirstBatchSize = 256U;
+
+bool isDigit(char c) noexcept { return std::isdigit(static_cast<unsigned char>(c)) != 0; }
+
+/// End of the run of digits starting at position
+std::size_t digitsEnd(std::string_view name, std::size_t position) noexcept {
+    while (position < name.size() && isDigit(name[position])) {
+        ++position;
+    }
+    return position;
+}
+
+}  // namespace
+
+bool naturalLess(std::string_view lhs, std::string_view rhs) noexcept {
+    std::size_t i = 0U;
+    std::size_t j = 0U;
+    while (i < lhs.size() && j < rhs.size()) {
+        if (isDigit(lhs[i]) && isDigit(rhs[j])) {
+            // Leading zeros aside, the longer number is the larger one, and same length numbers compare as text
+            std::size_t const lhs_end = digitsEnd(lhs, i);
+            std::size_t const rhs_end = digitsEnd(rhs, j);
+            while (i + 1U < lhs_end && lhs[i] == '0') {
+                ++i;
+            }
+            while (j + 1U < rhs_end && rhs[j] == '0') {
+                ++j;
+            }
+            if (lhs_end - i != rhs_end - j) {
+                return lhs_end - i < rhs_end - j;
+            }
+            if (int const order = lhs.substr(i, lhs_end - i).compare(rhs.substr(j, rhs_end - j)); order != 0) {
+                return order < 0;
+            }
+            i = lhs_end;
+            j = rhs_end;
+            continue;
+        }
+
+        int const lhs_char = std::tolower(static_cast<unsigned char>(lhs[i]));
+        int const rhs_char = std::tolower(static_cast<unsigned char>(rhs[j]));
+        if (lhs_char != rhs_char) {
+            return lhs_char < rhs_char;
+        }
+        ++i;
+        ++j;
+    }
+
+    if (i == lhs.size() && j == rhs.size()) {
+        return lhs < rhs;
+    }
+    return i == lhs.size();
+}
+
+std::shared_ptr<DirectoryIndex> DirectoryIndex::shared(std::filesystem::path const& directory_path) noexcept {
+    static std::mutex indexes_mutex{};
+    static std::unordered_map<std::string, std::weak_ptr<DirectoryIndex>> indexes{};
+
+    std::lock_guard lock{indexes_mutex};
+    std::erase_if(indexes, [](auto const& it) { return it.second.expired(); });
+
+    auto& index = indexes[directory_path.string()];
+    auto directory_index = index.lock();
+    if (not directory_index) {
+        directory_index = std::make_shared<DirectoryIndex>(directory_path);
+        index = directory_index;
+    }
+    return directory_index;
+}
+
+DirectoryIndex::DirectoryIndex(std::filesystem::path directory_path) noexcept
+    : m_directory_path{std::move(directory_path)} {
+    m_thread = std::thread{&DirectoryIndex::scan, this};
+}
+
+DirectoryIndex::~DirectoryIndex() noexcept {
+    m_stopping = true;
+    m_thread.join();
+}
+
+std::filesystem::path const& DirectoryIndex::directoryPath() const noexcept { return m_directory_path; }
+
+bool DirectoryIndex::complete() const noexcept {
+    std::lock_guard lock{m_mutex};
+    return m_complete;
+}
+
+std::size_t DirectoryIndex::size() const noexcept {
+    std::lock_guard lock{m_mutex};
+    return m_names.size();
+}
+
+std::optional<std::filesystem::path> DirectoryIndex::neighbor(std::filesystem::path const& image_path,
+                                                              std::ptrdiff_t offset) const noexcept {
+    auto const name = image_path.filename().string();
+    std::lock_guard lock{m_mutex};
+
+    // Counted from the first name after image_path going forward, from image_path itself going backward
+    auto const it = offset > 0 ? std::upper_bound(m_names.begin(), m_names.end(), name, naturalLess)
+                               : std::lower_bound(m_names.begin(), m_names.end(), name, naturalLess);
+    std::ptrdiff_t const position = (it - m_names.begin()) + (offset > 0 ? offset - 1 : offset);
+    if (offset == 0 || position < 0 || position >= static_cast<std::ptrdiff_t>(m_names.size())) {
+        return std::nullopt;
+    }
+    return imagePath(m_names[static_cast<std::size_t>(position)]);
+}
+
+std::optional<std::filesystem::path> DirectoryIndex::first() const noexcept {
+    std::lock_guard lock{m_mutex};
+    if (m_names.empty()) {
+        return std::nullopt;
+    }
+    return imagePath(m_names.front());
+}
+
+std::optional<std::filesystem::path> DirectoryIndex::last() const noexcept {
+    std::lock_guard lock{m_mutex};
+    if (m_names.empty()) {
+        return std::nullopt;
+    }
+    return imagePath(m_names.back());
+}
+
+std::pair<std::vector<std::filesystem::path>, std::size_t> DirectoryIndex::around(
+    std::filesystem::path const& image_path, std::size_t radius) const noexcept {
+    auto const name = image_path.filename().string();
+    std::vector<std::filesystem::path> image_paths{};
+    std::lock_guard lock{m_mutex};
+
+    auto const lower = std::lower_bound(m_names.begin(), m_names.end(), name, naturalLess);
+    auto const upper = std::upper_bound(lower, m_names.end(), name, naturalLess);
+    auto const before = static_cast<std::size_t>(lower - m_names.begin());
+    auto const after = static_cast<std::size_t>(m_names.end() - upper);
+    for (auto it = lower - static_cast<std::ptrdiff_t>(std::min(radius, before)); it != lower; ++it) {
+        image_paths.push_back(imagePath(*it));
+    }
+
+    std::size_t const position = image_paths.size();
+    image_paths.push_back(image_path);
+    for (auto it = upper; it != upper + static_cast<std::ptrdiff_t>(std::min(radius, after)); ++it) {
+        image_paths.push_back(imagePath(*it));
+    }
+    return {std::move(image_paths), position};
+}
+
+std::filesystem::path DirectoryIndex::imagePath(std::string const& name) const noexcept {
+    return m_directory_path / name;
+}
+
+void DirectoryIndex::publish(std::vector<std::string>& names) noexcept {
+    std::sort(names.begin(), names.end(), naturalLess);
+
+    std::lock_guard lock{m_mutex};
+    auto const previous_size = static_cast<std::ptrdiff_t>(m_names.size());
+    m_names.insert(m_names.end(), std::make_move_iterator(names.begin()), std::make_move_iterator(names.end()));
+    std::inplace_merge(m_names.begin(), m_names.begin() + previous_size, m_names.end(), naturalLess);
+    names.clear();
+}
+
+void DirectoryIndex::scan() noexcept {
+    TRACE_SCOPE("index directory", m_directory_path.c_str());
+    auto const scan_start = std::chrono::steady_clock::now();
+    auto const directory_path = m_directory_path.empty() ? std::filesystem::path{"."} : m_directory_path;
+
+    std::vector<std::string> names{};
+    std::size_t batch_size = kFirstBatchSize;
+    auto const add = [this, &names, &batch_size](std::string_view name) {
+        auto const extension = name.rfind('.');
+        if (extension == std::string_view::npos || not isImageExtension(name.substr(extension))) {
+            return;
+        }
+
+        names.emplace_back(name);
+        if (names.size() >= batch_size) {
+            publish(names);
+            batch_size = std::max(batch_size, size());
+        }
+    };
+
+#if IMGV2_DIRECTORY_INDEX_DIRENT
+    // readdir hands the entries over from large getdents buffers, with their type, so no file is ever stat'ed
+    if (DIR* directory = ::opendir(directory_path.c_str())) {
+        while (not m_stopping) {
+            dirent const* entry = ::readdir(directory);
+            if (entry == nullptr) {
+                break;
+            }
+
+            // Symbolic links and file systems without types (DT_UNKNOWN) are kept, they fail when shown if they are
+            // not images after all
+            if (entry->d_type != DT_DIR) {
+                add(entry->d_name);
+            }
+        }
+        ::closedir(directory);
+    } else {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to list %s: %s", directory_path.c_str(),
+                    std::strerror(errno));
+    }
+#else
+    std::error_code error{};
+    std::filesystem::directory_iterator it{directory_path, error};
+    for (; not error && not m_stopping && it != std::filesystem::directory_iterator{}; it.increment(error)) {
+        if (not it->is_directory(error)) {
+            add(it->path().filename().string());
+        }
+    }
+    if (error) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to list %s: %s", directory_path.c_str(),
+                    error.message().c_str());
+    }
+#endif
+
+    publish(names);
+    std::size_t image_count{};
+    {
+        std::lock_guard lock{m_mutex};
+        m_complete = true;
+        image_count = m_names.size();
+    }
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Indexed %zu images in %s in %.1f ms", image_count,
+                directory_path.c_str(),
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scan_start).count());
+}
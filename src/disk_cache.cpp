@@ -0,0 +1,363 @@
+#include "disk_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IMGV2_DISK_CACHE_MMAP 1
+#endif
+
+namespace {
+
+constexpr char kEntryMagic[4] = {'I', 'M', 'V', '2'};
+constexpr std::uint32_t kEntryVersion = 1U;
+constexpr char const* kEntryExtension = ".imgv2c";
+
+/// Pixels start at a page boundary, so the mapping hands SDL aligned rows
+constexpr std::uint64_t kPixelsAlignment = 4096U;
+
+/// Layout of the beginning of an entry, followed by the image path and then the pixels at pixels_offset
+struct EntryHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t pitch;
+    std::uint32_t format;
+    std::uint64_t source_size;
+    std::int64_t source_mtime;
+    std::uint64_t path_length;
+    std::uint64_t pixels_offset;
+};
+
+/// Eviction goes down to this fraction of the limit, so a full cache is not listed again by the very next store
+constexpr std::uintmax_t kEvictionTargetPercent = 90U;
+
+/// Entry file found in the cache directory
+struct Entry {
+    std::filesystem::path path{};
+    std::uintmax_t size{};
+    std::filesystem::file_time_type last_used{};
+};
+
+/// List the entries of the directory, returns their total size
+std::uintmax_t listEntries(std::filesystem::path const& directory, std::vector<Entry>& entries) noexcept {
+    std::uintmax_t total_size{};
+    std::error_code error{};
+    std::filesystem::directory_iterator it{directory, error};
+    for (; not error && it != std::filesystem::directory_iterator{}; it.increment(error)) {
+        if (it->path().extension() != kEntryExtension) {
+            continue;
+        }
+
+        std::error_code entry_error{};
+        Entry entry{it->path(), it->file_size(entry_error), it->last_write_time(entry_error)};
+        if (not entry_error) {
+            total_size += entry.size;
+            entries.push_back(std::move(entry));
+        }
+    }
+    return total_size;
+}
+
+/// Identity of the source file, an entry is only valid while it matches
+struct SourceStamp {
+    std::string path{};
+    std::uint64_t size{};
+    std::int64_t mtime{};
+};
+
+bool stampSource(std::filesystem::path const& image_path, SourceStamp& stamp) noexcept {
+    std::error_code error{};
+    auto const absolute_path = std::filesystem::absolute(image_path, error);
+    if (error) {
+        return false;
+    }
+
+    auto const size = std::filesystem::file_size(absolute_path, error);
+    if (error) {
+        return false;
+    }
+
+    auto const mtime = std::filesystem::last_write_time(absolute_path, error);
+    if (error) {
+        return false;
+    }
+
+    stamp.path = absolute_path.lexically_normal().string();
+    stamp.size = size;
+    stamp.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+    return true;
+}
+
+/// 64 bits FNV-1a of the stamp, names the entry file
+std::uint64_t hashStamp(SourceStamp const& stamp) noexcept {
+    std::uint64_t hash = 14695981039346656037ULL;
+    auto const mix = [&hash](void const* data, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<std::uint8_t const*>(data)[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(stamp.path.data(), stamp.path.size());
+    mix(&stamp.size, sizeof(stamp.size));
+    mix(&stamp.mtime, sizeof(stamp.mtime));
+    return hash;
+}
+
+}  // namespace
+
+DiskCache& DiskCache::shared() noexcept {
+    // Never destroyed, store tasks may still be running on the shared worker pool at exit
+    static DiskCache* disk_cache = new DiskCache{};
+    return *disk_cache;
+}
+
+DiskCache::DiskCache() noexcept {}
+
+DiskCache::~DiskCache() noexcept {}
+
+bool DiskCache::enable(std::filesystem::path directory, std::size_t limit_bytes) noexcept {
+#if IMGV2_DISK_CACHE_MMAP
+    std::error_code error{};
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        SDL_SetError("failed to create disk cache %s: %s", directory.c_str(), error.message().c_str());
+        return false;
+    }
+
+    std::vector<Entry> entries{};
+    std::uintmax_t const total_bytes = listEntries(directory, entries);
+    {
+        std::lock_guard lock{m_mutex};
+        m_directory = std::move(directory);
+        m_limit_bytes = limit_bytes;
+        m_total_bytes = total_bytes;
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Disk cache at %s limited to %zu MB, %ju MB used",
+                    m_directory.c_str(), m_limit_bytes / (1024U * 1024U), m_total_bytes / (1024U * 1024U));
+    }
+
+    // The limit may have been lowered since the last run
+    if (total_bytes > limit_bytes) {
+        evict();
+    }
+    return true;
+#else
+    SDL_SetError("disk cache requires memory mapped files");
+    return false;
+#endif
+}
+
+bool DiskCache::enabled() const noexcept {
+    std::lock_guard lock{m_mutex};
+    return not m_directory.empty();
+}
+
+std::filesystem::path DiskCache::entryPath(std::filesystem::path const& image_path) const noexcept {
+    SourceStamp stamp{};
+    if (not stampSource(image_path, stamp)) {
+        return {};
+    }
+
+    char entry_name[32]{};
+    std::snprintf(entry_name, sizeof(entry_name), "%016llx", static_cast<unsigned long long>(hashStamp(stamp)));
+
+    std::lock_guard lock{m_mutex};
+    return m_directory / (std::string{entry_name} + kEntryExtension);
+}
+
+SurfacePtr DiskCache::load(std::filesystem::path const& image_path) noexcept {
+#if IMGV2_DISK_CACHE_MMAP
+    if (not enabled()) {
+        return {nullptr};
+    }
+
+    SourceStamp stamp{};
+    auto const entry_path = entryPath(image_path);
+    if (entry_path.empty() || not stampSource(image_path, stamp)) {
+        return {nullptr};
+    }
+
+    int const fd = ::open(entry_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return {nullptr};
+    }
+
+    struct stat entry_stat {};
+    if (::fstat(fd, &entry_stat) != 0 || static_cast<std::size_t>(entry_stat.st_size) < sizeof(EntryHeader)) {
+        ::close(fd);
+        return {nullptr};
+    }
+
+    // Private writable mapping, pages are only copied if something ever writes to the surface
+    auto const mapping_size = static_cast<std::size_t>(entry_stat.st_size);
+    void* mapping = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return {nullptr};
+    }
+
+    EntryHeader header{};
+    std::memcpy(&header, mapping, sizeof(header));
+    auto const* entry_bytes = static_cast<std::uint8_t const*>(mapping);
+    std::string_view const entry_image_path{reinterpret_cast<char const*>(entry_bytes + sizeof(header)),
+                                            std::min<std::size_t>(header.path_length, mapping_size - sizeof(header))};
+
+    bool const valid = std::memcmp(header.magic, kEntryMagic, sizeof(kEntryMagic)) == 0 &&
+                       header.version == kEntryVersion && header.source_size == stamp.size &&
+                       header.source_mtime == stamp.mtime && entry_image_path == stamp.path &&
+                       header.pixels_offset + std::uint64_t{header.pitch} * header.height <= mapping_size;
+    if (not valid) {
+        ::munmap(mapping, mapping_size);
+        return {nullptr};
+    }
+
+    ::madvise(mapping, mapping_size, MADV_WILLNEED);
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(
+        static_cast<std::uint8_t*>(mapping) + header.pixels_offset, static_cast<int>(header.width),
+        static_cast<int>(header.height), static_cast<int>(SDL_BITSPERPIXEL(header.format)),
+        static_cast<int>(header.pitch), header.format);
+    if (surface == nullptr) {
+        ::munmap(mapping, mapping_size);
+        return {nullptr};
+    }
+
+    // Refresh the entry modification time, it is what eviction orders entries by
+    std::error_code error{};
+    std::filesystem::last_write_time(entry_path, std::filesystem::file_time_type::clock::now(), error);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Loading %s from disk cache", image_path.c_str());
+    return SurfacePtr{surface, [mapping, mapping_size](SDL_Surface* mapped_surface) {
+                          SDL_FreeSurface(mapped_surface);
+                          ::munmap(mapping, mapping_size);
+                      }};
+#else
+    return {nullptr};
+#endif
+}
+
+bool DiskCache::store(std::filesystem::path const& image_path, SDL_Surface const* surface) noexcept {
+    if (not enabled() || surface == nullptr) {
+        return false;
+    }
+
+    SourceStamp stamp{};
+    auto const entry_path = entryPath(image_path);
+    if (entry_path.empty() || not stampSource(image_path, stamp)) {
+        return false;
+    }
+
+    // Palettes and RLE are not stored, they go through a plain 32 bits copy
+    SurfacePtr converted_surface{};
+    if (SDL_ISPIXELFORMAT_INDEXED(surface->format->format) || (surface->flags & SDL_RLEACCEL)) {
+        converted_surface = SDLit::make_unique(SDL_ConvertSurfaceFormat, const_cast<SDL_Surface*>(surface),
+                                               SDL_PIXELFORMAT_ARGB8888, 0);
+        if (not converted_surface) {
+            return false;
+        }
+        surface = converted_surface.get();
+    }
+
+    EntryHeader header{};
+    std::memcpy(header.magic, kEntryMagic, sizeof(kEntryMagic));
+    header.version = kEntryVersion;
+    header.width = static_cast<std::uint32_t>(surface->w);
+    header.height = static_cast<std::uint32_t>(surface->h);
+    header.pitch = static_cast<std::uint32_t>(surface->pitch);
+    header.format = surface->format->format;
+    header.source_size = stamp.size;
+    header.source_mtime = stamp.mtime;
+    header.path_length = stamp.path.size();
+    header.pixels_offset =
+        (sizeof(header) + stamp.path.size() + kPixelsAlignment - 1U) / kPixelsAlignment * kPixelsAlignment;
+
+    // Written aside and renamed, readers never map a partial entry
+    auto temporary_path = entry_path;
+    temporary_path += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream entry_file{temporary_path, std::ios::binary | std::ios::trunc};
+        std::vector<char> const padding(header.pixels_offset - sizeof(header) - stamp.path.size(), '\0');
+        entry_file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        entry_file.write(stamp.path.data(), static_cast<std::streamsize>(stamp.path.size()));
+        entry_file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        entry_file.write(static_cast<char const*>(surface->pixels),
+                         static_cast<std::streamsize>(std::size_t{header.pitch} * header.height));
+        if (not entry_file) {
+            std::error_code error{};
+            std::filesystem::remove(temporary_path, error);
+            SDL_SetError("failed to write disk cache entry %s", temporary_path.c_str());
+            return false;
+        }
+    }
+
+    // An outdated entry of the same stamp may be replaced, it no longer counts
+    std::error_code error{};
+    std::uintmax_t replaced_size = std::filesystem::file_size(entry_path, error);
+    if (error) {
+        replaced_size = 0U;
+    }
+    std::filesystem::rename(temporary_path, entry_path, error);
+    if (error) {
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
+
+    bool over_limit{};
+    {
+        std::lock_guard lock{m_mutex};
+        m_total_bytes += header.pixels_offset + std::uint64_t{header.pitch} * header.height;
+        m_total_bytes -= std::min(replaced_size, m_total_bytes);
+        over_limit = m_total_bytes > m_limit_bytes;
+    }
+    if (over_limit) {
+        evict();
+    }
+    return true;
+}
+
+void DiskCache::evict() noexcept {
+    std::filesystem::path directory{};
+    std::size_t limit_bytes{};
+    {
+        std::lock_guard lock{m_mutex};
+        directory = m_directory;
+        limit_bytes = m_limit_bytes;
+    }
+
+    // Listed again rather than trusting the running total, entries may have been removed or written by another
+    // instance since the cache was enabled
+    std::vector<Entry> entries{};
+    std::uintmax_t total_size = listEntries(directory, entries);
+    std::uintmax_t const target_size = limit_bytes / 100U * kEvictionTargetPercent;
+    if (total_size > limit_bytes) {
+        std::sort(entries.begin(), entries.end(),
+                  [](Entry const& lhs, Entry const& rhs) { return lhs.last_used < rhs.last_used; });
+        for (auto const& entry : entries) {
+            if (total_size <= target_size) {
+                break;
+            }
+
+            std::error_code remove_error{};
+            if (std::filesystem::remove(entry.path, remove_error)) {
+                total_size -= entry.size;
+            }
+        }
+    }
+
+    std::lock_guard lock{m_mutex};
+    m_total_bytes = total_size;
+}
@@ -0,0 +1,233 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define IMGV2_FILE_WATCHER_INOTIFY 1
+#else
+#define IMGV2_FILE_WATCHER_INOTIFY 0
+#endif
+
+namespace {
+
+/// Quiet time after a write from a program that keeps the file open, its next write would waste a decode
+constexpr std::chrono::milliseconds kWriteQuietPeriod{100};
+
+/// Quiet time once the file is closed or renamed in place, just enough to coalesce the events of a single save
+constexpr std::chrono::milliseconds kCloseQuietPeriod{5};
+
+}  // namespace
+
+std::unique_ptr<FileWatcher> FileWatcher::create(std::uint32_t event_type) noexcept {
+#if IMGV2_FILE_WATCHER_INOTIFY
+    int const inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        SDL_SetError("failed to initialize inotify: %s", std::strerror(errno));
+        return {nullptr};
+    }
+
+    // Wakes the thread up when the watched files change or it has to stop
+    int const wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        SDL_SetError("failed to create eventfd: %s", std::strerror(errno));
+        ::close(inotify_fd);
+        return {nullptr};
+    }
+    return std::unique_ptr<FileWatcher>{new FileWatcher{inotify_fd, wake_fd, event_type}};
+#else
+    (void)event_type;
+    SDL_SetError("watching files requires inotify");
+    return {nullptr};
+#endif
+}
+
+FileWatcher::FileWatcher(int inotify_fd, int wake_fd, std::uint32_t event_type) noexcept
+    : m_inotify_fd(inotify_fd), m_wake_fd(wake_fd), m_event_type(event_type) {
+    m_thread = std::thread{&FileWatcher::run, this};
+}
+
+FileWatcher::~FileWatcher() noexcept {
+#if IMGV2_FILE_WATCHER_INOTIFY
+    m_stopping = true;
+    std::uint64_t const wake_count = 1U;
+    [[maybe_unused]] ssize_t const written = ::write(m_wake_fd, &wake_count, sizeof(wake_count));
+    m_thread.join();
+
+    ::close(m_wake_fd);
+    ::close(m_inotify_fd);
+#endif
+}
+
+std::uint32_t FileWatcher::eventType() const noexcept { return m_event_type; }
+
+void FileWatcher::setWatchedFiles(std::vector<std::pair<std::uint32_t, std::filesystem::path>> const& files) noexcept {
+    std::lock_guard lock{m_mutex};
+    bool changed = std::erase_if(m_files, [&files](auto const& watched_file) {
+                       return std::none_of(files.begin(), files.end(), [&watched_file](auto const& file) {
+                           return file.first == watched_file.first;
+                       });
+                   }) > 0U;
+
+    for (auto const& [window_id, file_path] : files) {
+        auto it = m_files.find(window_id);
+        if (it != m_files.end() && it->second.path == file_path) {
+            continue;
+        }
+
+        // Event names are relative to the watched directory, they are matched against the absolute path
+        std::error_code error{};
+        auto absolute_path = std::filesystem::absolute(file_path, error).lexically_normal();
+        m_files[window_id] = WatchedFile{file_path, error ? file_path : std::move(absolute_path)};
+        m_pending_changes.erase(window_id);
+        changed = true;
+    }
+
+    if (changed) {
+        updateDirectories();
+    }
+}
+
+std::vector<FileWatcher::Change> FileWatcher::takeChanges() noexcept {
+    std::lock_guard lock{m_mutex};
+    return std::exchange(m_changes, {});
+}
+
+void FileWatcher::updateDirectories() noexcept {
+#if IMGV2_FILE_WATCHER_INOTIFY
+    auto const is_watched = [this](std::filesystem::path const& directory) {
+        return std::any_of(m_files.begin(), m_files.end(), [&directory](auto const& watched_file) {
+            return watched_file.second.absolute_path.parent_path() == directory;
+        });
+    };
+    std::erase_if(m_directories, [this, &is_watched](auto const& watched_directory) {
+        if (is_watched(watched_directory.second)) {
+            return false;
+        }
+        ::inotify_rm_watch(m_inotify_fd, watched_directory.first);
+        return true;
+    });
+
+    for (auto const& [window_id, watched_file] : m_files) {
+        auto directory = watched_file.absolute_path.parent_path();
+        bool const already_watched = std::any_of(m_directories.begin(), m_directories.end(),
+                                                 [&directory](auto const& it) { return it.second == directory; });
+        if (already_watched) {
+            continue;
+        }
+
+        int const watch_descriptor = ::inotify_add_watch(m_inotify_fd, directory.c_str(),
+                                                         IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch_descriptor < 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Not watching %s: %s", directory.c_str(), std::strerror(errno));
+            continue;
+        }
+        m_directories[watch_descriptor] = std::move(directory);
+    }
+#endif
+}
+
+void FileWatcher::run() noexcept {
+#if IMGV2_FILE_WATCHER_INOTIFY
+    while (not m_stopping) {
+        // Sleep until the next file is due to be reported, or until something happens
+        int timeout = -1;
+        {
+            std::lock_guard lock{m_mutex};
+            auto const now = std::chrono::steady_clock::now();
+            for (auto const& [window_id, pending_change] : m_pending_changes) {
+                auto const remaining = std::chrono::ceil<std::chrono::milliseconds>(pending_change.deadline - now);
+                int const remaining_ms = static_cast<int>(std::max(remaining, std::chrono::milliseconds{0}).count());
+                timeout = timeout < 0 ? remaining_ms : std::min(timeout, remaining_ms);
+            }
+        }
+
+        pollfd fds[2]{{m_inotify_fd, POLLIN, 0}, {m_wake_fd, POLLIN, 0}};
+        if (::poll(fds, 2, timeout) < 0 && errno != EINTR) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Stopped watching files: %s", std::strerror(errno));
+            return;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            std::uint64_t wake_count{};
+            [[maybe_unused]] ssize_t const read_size = ::read(m_wake_fd, &wake_count, sizeof(wake_count));
+        }
+        if (fds[0].revents & POLLIN) {
+            readEvents();
+        }
+
+        bool has_changes = false;
+        {
+            std::lock_guard lock{m_mutex};
+            auto const now = std::chrono::steady_clock::now();
+            std::erase_if(m_pending_changes, [this, now, &has_changes](auto const& pending_change) {
+                if (pending_change.second.deadline > now) {
+                    return false;
+                }
+                m_changes.push_back(Change{pending_change.first, pending_change.second.changed_at});
+                has_changes = true;
+                return true;
+            });
+        }
+
+        if (has_changes) {
+            SDL_Event event{};
+            event.type = m_event_type;
+            SDL_PushEvent(&event);
+        }
+    }
+#endif
+}
+
+void FileWatcher::readEvents() noexcept {
+#if IMGV2_FILE_WATCHER_INOTIFY
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t const read_size = ::read(m_inotify_fd, buffer, sizeof(buffer));
+        if (read_size <= 0) {
+            return;
+        }
+
+        auto const now = std::chrono::steady_clock::now();
+        std::lock_guard lock{m_mutex};
+        auto const mark_changed = [this, now](std::uint32_t window_id, std::chrono::milliseconds quiet_period) {
+            auto [it, inserted] = m_pending_changes.try_emplace(window_id, PendingChange{now, now + quiet_period});
+            if (not inserted) {
+                it->second.deadline = now + quiet_period;
+            }
+        };
+
+        for (char const* position = buffer; position < buffer + read_size;) {
+            auto const* event = reinterpret_cast<inotify_event const*>(position);
+            position += sizeof(inotify_event) + event->len;
+
+            // Events were lost, any of the files may have changed
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (auto const& [window_id, watched_file] : m_files) {
+                    mark_changed(window_id, kWriteQuietPeriod);
+                }
+                continue;
+            }
+
+            auto directory = m_directories.find(event->wd);
+            if (event->len == 0U || directory == m_directories.end()) {
+                continue;
+            }
+
+            auto const changed_path = directory->second / event->name;
+            auto const quiet_period =
+                (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) ? kCloseQuietPeriod : kWriteQuietPeriod;
+            for (auto const& [window_id, watched_file] : m_files) {
+                if (watched_file.absolute_path == changed_path) {
+                    mark_changed(window_id, quiet_period);
+                }
+            }
+        }
+    }
+#endif
+}
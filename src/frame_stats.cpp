@@ -0,0 +1,161 @@
+#include "frame_stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+/// Buckets below this many microseconds are a microsecond wide, the others are an eighth of a power of two
+constexpr std::uint64_t kLinearMicroseconds = 8U;
+
+std::uint64_t bucketLowerBound(std::size_t bucket) noexcept {
+    if (bucket < kLinearMicroseconds) {
+        return bucket;
+    }
+    int const exponent = static_cast<int>(bucket / 8U) + 2;
+    return (8U + bucket % 8U) << (exponent - 3);
+}
+
+std::uint64_t bucketUpperBound(std::size_t bucket) noexcept {
+    return bucket + 1U < DurationHistogram::kBucketCount ? bucketLowerBound(bucket + 1U) : bucketLowerBound(bucket);
+}
+
+/// Counters of a thread, written by that thread only and read by any
+struct ThreadSlot {
+    std::array<std::atomic_uint64_t, FrameStats::kCounterCount> counters{};
+    std::array<std::array<std::atomic_uint64_t, DurationHistogram::kBucketCount>, FrameStats::kTimingCount> timings{};
+};
+
+struct State {
+    std::mutex mutex{};
+    std::vector<std::unique_ptr<ThreadSlot>> slots{};
+};
+
+State& state() noexcept {
+    // Never destroyed, worker threads may still count while the application exits
+    static State* stats_state = new State{};
+    return *stats_state;
+}
+
+ThreadSlot& threadSlot() noexcept {
+    // The lock is only taken by the first count of each thread, slots outlive their threads so totals keep them
+    thread_local ThreadSlot* const thread_slot = [] {
+        auto& stats_state = state();
+        std::lock_guard lock{stats_state.mutex};
+        return stats_state.slots.emplace_back(std::make_unique<ThreadSlot>()).get();
+    }();
+    return *thread_slot;
+}
+
+/// Only the owning thread writes to its slot, a load and a store are enough where a fetch_add would lock the bus
+void increment(std::atomic_uint64_t& counter, std::uint64_t value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+std::size_t DurationHistogram::bucket(std::chrono::steady_clock::duration duration) noexcept {
+    auto const microseconds =
+        static_cast<std::uint64_t>(std::max<std::int64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0));
+    if (microseconds < kLinearMicroseconds) {
+        return static_cast<std::size_t>(microseconds);
+    }
+    int const exponent = std::bit_width(microseconds) - 1;
+    std::size_t const bucket_index =
+        static_cast<std::size_t>(exponent - 2) * 8U + static_cast<std::size_t>((microseconds >> (exponent - 3)) & 7U);
+    return std::min(bucket_index, kBucketCount - 1U);
+}
+
+void DurationHistogram::add(std::chrono::steady_clock::duration duration) noexcept { add(bucket(duration), 1U); }
+
+void DurationHistogram::add(std::size_t bucket, std::uint64_t count) noexcept {
+    m_buckets[bucket] += count;
+    m_count += count;
+}
+
+std::uint64_t DurationHistogram::count() const noexcept { return m_count; }
+
+std::chrono::microseconds DurationHistogram::percentile(double fraction) const noexcept {
+    if (m_count == 0U) {
+        return std::chrono::microseconds{0};
+    }
+
+    // Rank of the sample in the sorted durations, the bucket holding it is found by walking the cumulative counts
+    auto const rank = std::max<std::uint64_t>(
+        static_cast<std::uint64_t>(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(m_count) + 0.5), 1U);
+    std::uint64_t seen{};
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            return std::chrono::microseconds{(bucketLowerBound(i) + bucketUpperBound(i)) / 2U};
+        }
+    }
+    return std::chrono::microseconds{bucketLowerBound(kBucketCount - 1U)};
+}
+
+std::string DurationHistogram::summary() const noexcept {
+    auto const milliseconds = [this](double fraction) {
+        return std::chrono::duration<double, std::milli>(percentile(fraction)).count();
+    };
+    char summary_text[96]{};
+    std::snprintf(summary_text, sizeof(summary_text), "p50 %.2f p95 %.2f p99 %.2f max %.2f ms", milliseconds(0.5),
+                  milliseconds(0.95), milliseconds(0.99), milliseconds(1.0));
+    return summary_text;
+}
+
+DurationHistogram& DurationHistogram::operator-=(DurationHistogram const& earlier) noexcept {
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+        m_buckets[i] -= std::min(earlier.m_buckets[i], m_buckets[i]);
+    }
+    m_count -= std::min(earlier.m_count, m_count);
+    return *this;
+}
+
+WindowFrameStats& WindowFrameStats::operator-=(WindowFrameStats const& earlier) noexcept {
+    repaints -= std::min(earlier.repaints, repaints);
+    repaint -= earlier.repaint;
+    render -= earlier.render;
+    present -= earlier.present;
+    return *this;
+}
+
+FrameStats::Totals& FrameStats::Totals::operator-=(Totals const& earlier) noexcept {
+    for (std::size_t i = 0; i < counters.size(); ++i) {
+        counters[i] -= std::min(earlier.counters[i], counters[i]);
+    }
+    for (std::size_t i = 0; i < timings.size(); ++i) {
+        timings[i] -= earlier.timings[i];
+    }
+    return *this;
+}
+
+void FrameStats::count(Counter counter) noexcept { increment(threadSlot().counters[counter], 1U); }
+
+void FrameStats::time(Timing timing, std::chrono::steady_clock::duration duration) noexcept {
+    increment(threadSlot().timings[timing][DurationHistogram::bucket(duration)], 1U);
+}
+
+FrameStats::Totals FrameStats::totals() noexcept {
+    Totals stats_totals{};
+    auto& stats_state = state();
+    std::lock_guard lock{stats_state.mutex};
+    for (auto const& slot : stats_state.slots) {
+        for (std::size_t i = 0; i < stats_totals.counters.size(); ++i) {
+            stats_totals.counters[i] += slot->counters[i].load(std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < stats_totals.timings.size(); ++i) {
+            for (std::size_t bucket = 0; bucket < DurationHistogram::kBucketCount; ++bucket) {
+                if (auto const count = slot->timings[i][bucket].load(std::memory_order_relaxed)) {
+                    stats_totals.timings[i].add(bucket, count);
+                }
+            }
+        }
+    }
+    return stats_totals;
+}
@@ -0,0 +1,228 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include "pixel_convert.hpp"
+#include "worker_pool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMGV2_HISTOGRAM_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMGV2_HISTOGRAM_NEON 1
+#endif
+
+namespace {
+
+/// Pixels counted by each task of countPixelsAsync, a millisecond or two of work
+constexpr int kBandPixels = 1 << 20;
+
+/// Luma weights of BT.709 in 8 bits fixed point, they add up to 256 so white stays at 255
+constexpr int kRedWeight = 54;
+constexpr int kGreenWeight = 183;
+constexpr int kBlueWeight = 19;
+
+/// Pixels handled per step of the vectorized loop
+constexpr int kChunkPixels = 16;
+
+/// Counters are spread over 4 copies of the histogram, so runs of equal pixels do not wait on the same counter
+using Counters = std::array<Histogram, 4>;
+
+std::uint8_t luma(std::uint8_t const* pixel, ByteChannels offsets) noexcept {
+    return static_cast<std::uint8_t>((kRedWeight * pixel[offsets.red] + kGreenWeight * pixel[offsets.green] +
+                                      kBlueWeight * pixel[offsets.blue] + 128) >>
+                                     8);
+}
+
+/// Luma of kChunkPixels pixels
+void lumaChunk(std::uint8_t const* pixels, ByteChannels offsets, std::uint8_t* lumas) noexcept {
+#if IMGV2_HISTOGRAM_SSE2
+    __m128i const byte_mask = _mm_set1_epi32(0xFF);
+    __m128i const red_shift = _mm_cvtsi32_si128(offsets.red * 8);
+    __m128i const green_shift = _mm_cvtsi32_si128(offsets.green * 8);
+    __m128i const blue_shift = _mm_cvtsi32_si128(offsets.blue * 8);
+    __m128i const red_weight = _mm_set1_epi32(kRedWeight);
+    __m128i const green_weight = _mm_set1_epi32(kGreenWeight);
+    __m128i const blue_weight = _mm_set1_epi32(kBlueWeight);
+    __m128i const rounding = _mm_set1_epi32(128);
+
+    // Channels are widened to 32 bits lanes, their products still fit in the low 16 bits
+    __m128i quads[4];
+    for (int i = 0; i < 4; ++i) {
+        __m128i const quad = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i * 16));
+        __m128i const red = _mm_and_si128(_mm_srl_epi32(quad, red_shift), byte_mask);
+        __m128i const green = _mm_and_si128(_mm_srl_epi32(quad, green_shift), byte_mask);
+        __m128i const blue = _mm_and_si128(_mm_srl_epi32(quad, blue_shift), byte_mask);
+        __m128i const sum = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(red, red_weight), rounding),
+                                          _mm_add_epi32(_mm_mullo_epi16(green, green_weight),
+                                                        _mm_mullo_epi16(blue, blue_weight)));
+        quads[i] = _mm_srli_epi32(sum, 8);
+    }
+    __m128i const packed = _mm_packus_epi16(_mm_packs_epi32(quads[0], quads[1]), _mm_packs_epi32(quads[2], quads[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lumas), packed);
+#elif IMGV2_HISTOGRAM_NEON
+    uint8x16x4_t const channels = vld4q_u8(pixels);
+    uint8x16_t const red = channels.val[offsets.red];
+    uint8x16_t const green = channels.val[offsets.green];
+    uint8x16_t const blue = channels.val[offsets.blue];
+
+    uint16x8_t low = vmull_u8(vget_low_u8(red), vdup_n_u8(kRedWeight));
+    low = vmlal_u8(low, vget_low_u8(green), vdup_n_u8(kGreenWeight));
+    low = vmlal_u8(low, vget_low_u8(blue), vdup_n_u8(kBlueWeight));
+    uint16x8_t high = vmull_u8(vget_high_u8(red), vdup_n_u8(kRedWeight));
+    high = vmlal_u8(high, vget_high_u8(green), vdup_n_u8(kGreenWeight));
+    high = vmlal_u8(high, vget_high_u8(blue), vdup_n_u8(kBlueWeight));
+    vst1q_u8(lumas, vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8)));
+#else
+    for (int i = 0; i < kChunkPixels; ++i) {
+        lumas[i] = luma(pixels + i * 4, offsets);
+    }
+#endif
+}
+
+void countRow(std::uint8_t const* pixels, int width, ByteChannels offsets, Counters& counters) noexcept {
+    int x = 0;
+    alignas(16) std::uint8_t lumas[kChunkPixels];
+    for (; x + kChunkPixels <= width; x += kChunkPixels) {
+        std::uint8_t const* chunk = pixels + x * 4;
+        lumaChunk(chunk, offsets, lumas);
+        for (int i = 0; i < kChunkPixels; ++i) {
+            auto& counts = counters[static_cast<std::size_t>(i & 3)].counts;
+            std::uint8_t const* pixel = chunk + i * 4;
+            ++counts[Histogram::kRed][pixel[offsets.red]];
+            ++counts[Histogram::kGreen][pixel[offsets.green]];
+            ++counts[Histogram::kBlue][pixel[offsets.blue]];
+            ++counts[Histogram::kLuma][lumas[i]];
+        }
+    }
+
+    for (; x < width; ++x) {
+        auto& counts = counters[0].counts;
+        std::uint8_t const* pixel = pixels + x * 4;
+        ++counts[Histogram::kRed][pixel[offsets.red]];
+        ++counts[Histogram::kGreen][pixel[offsets.green]];
+        ++counts[Histogram::kBlue][pixel[offsets.blue]];
+        ++counts[Histogram::kLuma][luma(pixel, offsets)];
+    }
+}
+
+}  // namespace
+
+void Histogram::add(Histogram const& histogram) noexcept {
+    for (std::size_t channel = 0U; channel < counts.size(); ++channel) {
+        for (std::size_t level = 0U; level < counts[channel].size(); ++level) {
+            counts[channel][level] += histogram.counts[channel][level];
+        }
+    }
+}
+
+void Histogram::subtract(Histogram const& histogram) noexcept {
+    for (std::size_t channel = 0U; channel < counts.size(); ++channel) {
+        for (std::size_t level = 0U; level < counts[channel].size(); ++level) {
+            counts[channel][level] -= histogram.counts[channel][level];
+        }
+    }
+}
+
+void countPixels(SDL_Surface const* surface, SDL_Rect const& rect, Histogram& histogram) noexcept {
+    SDL_Rect const surface_rect{0, 0, surface->w, surface->h};
+    SDL_Rect clipped_rect{};
+    if (not SDL_IntersectRect(&rect, &surface_rect, &clipped_rect)) {
+        return;
+    }
+
+    Counters counters{};
+    if (auto const channels = byteChannels(surface->format->format)) {
+        auto const* pixels = static_cast<std::uint8_t const*>(surface->pixels);
+        for (int y = clipped_rect.y; y < clipped_rect.y + clipped_rect.h; ++y) {
+            countRow(pixels + static_cast<std::ptrdiff_t>(y) * surface->pitch + clipped_rect.x * 4, clipped_rect.w,
+                     *channels, counters);
+        }
+    } else {
+        ByteChannels const row_channels = *byteChannels(SDL_PIXELFORMAT_ARGB8888);
+        std::vector<std::uint8_t> row(static_cast<std::size_t>(clipped_rect.w) * 4U);
+        for (int y = clipped_rect.y; y < clipped_rect.y + clipped_rect.h; ++y) {
+            SDL_Rect const row_rect{clipped_rect.x, y, clipped_rect.w, 1};
+            if (not convertPixels(surface, row_rect, SDL_PIXELFORMAT_ARGB8888, row.data(), clipped_rect.w * 4)) {
+                return;
+            }
+            countRow(row.data(), clipped_rect.w, row_channels, counters);
+        }
+    }
+
+    for (auto const& counter : counters) {
+        histogram.add(counter);
+    }
+}
+
+void countPixelsAsync(SurfacePtr surface, std::vector<SDL_Rect> const& added, std::vector<SDL_Rect> const& removed,
+                      std::shared_ptr<std::atomic_bool const> cancelled,
+                      std::function<void(Histogram const&)> done) noexcept {
+    struct Band {
+        SDL_Rect rect{};
+        bool removed{};
+    };
+
+    struct Job {
+        SurfacePtr surface{};
+        std::shared_ptr<std::atomic_bool const> cancelled{};
+        std::function<void(Histogram const&)> done{};
+        std::mutex mutex{};
+        Histogram sum{};
+        std::size_t remaining_bands{};
+    };
+
+    // Bands of about the same number of pixels, whatever the shape of the rects
+    std::vector<Band> bands{};
+    auto const split = [&bands](std::vector<SDL_Rect> const& rects, bool removed) {
+        for (auto const& rect : rects) {
+            int const band_rows = std::max(kBandPixels / std::max(rect.w, 1), 1);
+            for (int y = rect.y; y < rect.y + rect.h; y += band_rows) {
+                bands.push_back({{rect.x, y, rect.w, std::min(band_rows, rect.y + rect.h - y)}, removed});
+            }
+        }
+    };
+    split(added, false);
+    split(removed, true);
+
+    auto job = std::make_shared<Job>();
+    job->surface = std::move(surface);
+    job->cancelled = std::move(cancelled);
+    job->done = std::move(done);
+    job->remaining_bands = bands.size();
+    if (bands.empty()) {
+        WorkerPool::shared().submit([job] {
+            if (not(job->cancelled && *job->cancelled)) {
+                job->done(job->sum);
+            }
+        });
+        return;
+    }
+
+    for (auto const& band : bands) {
+        WorkerPool::shared().submit([job, band] {
+            bool const cancelled = job->cancelled && *job->cancelled;
+            Histogram band_histogram{};
+            if (not cancelled) {
+                countPixels(job->surface.get(), band.rect, band_histogram);
+            }
+
+            bool last_band{};
+            {
+                std::lock_guard lock{job->mutex};
+                if (band.removed) {
+                    job->sum.subtract(band_histogram);
+                } else {
+                    job->sum.add(band_histogram);
+                }
+                last_band = --job->remaining_bands == 0U;
+            }
+            if (last_band && not(job->cancelled && *job->cancelled)) {
+                job->done(job->sum);
+            }
+        });
+    }
+}
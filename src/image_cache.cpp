@@ -0,0 +1,159 @@
+#include "image_cache.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "image_loader.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+constexpr std::size_t kDefaultBudgetBytes = 512U * 1024U * 1024U;
+constexpr std::size_t kDefaultPrefetchRadius = 2U;
+
+std::size_t surfaceBytes(SDL_Surface const* surface) noexcept {
+    return static_cast<std::size_t>(surface->pitch) * static_cast<std::size_t>(surface->h);
+}
+
+}  // namespace
+
+ImageCache& ImageCache::shared() noexcept {
+    // Never destroyed, prefetch tasks may still be running on the shared worker pool at exit
+    static ImageCache* image_cache = new ImageCache{kDefaultBudgetBytes, kDefaultPrefetchRadius};
+    return *image_cache;
+}
+
+ImageCache::ImageCache(std::size_t budget_bytes, std::size_t prefetch_radius) noexcept
+    : m_budget_bytes{budget_bytes}, m_prefetch_radius{prefetch_radius} {}
+
+ImageCache::~ImageCache() noexcept {}
+
+void ImageCache::setBudget(std::size_t budget_bytes) noexcept {
+    std::lock_guard lock{m_mutex};
+    m_budget_bytes = budget_bytes;
+    evict();
+}
+
+void ImageCache::setPrefetchRadius(std::size_t prefetch_radius) noexcept {
+    std::lock_guard lock{m_mutex};
+    m_prefetch_radius = prefetch_radius;
+}
+
+std::size_t ImageCache::budget() const noexcept {
+    std::lock_guard lock{m_mutex};
+    return m_budget_bytes;
+}
+
+std::size_t ImageCache::prefetchRadius() const noexcept {
+    std::lock_guard lock{m_mutex};
+    return m_prefetch_radius;
+}
+
+std::size_t ImageCache::usedBytes() const noexcept {
+    std::lock_guard lock{m_mutex};
+    return m_used_bytes;
+}
+
+SurfacePtr ImageCache::find(std::filesystem::path const& image_path) noexcept {
+    std::lock_guard lock{m_mutex};
+    auto it = m_index.find(image_path.string());
+    if (it == m_index.end()) {
+        return {nullptr};
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->surface;
+}
+
+void ImageCache::insert(std::filesystem::path const& image_path, SurfacePtr surface) noexcept {
+    if (not surface) {
+        return;
+    }
+
+    std::size_t const bytes = surfaceBytes(surface.get());
+    std::string key = image_path.string();
+
+    std::lock_guard lock{m_mutex};
+    if (bytes > m_budget_bytes) {
+        return;
+    }
+
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        m_used_bytes -= it->second->bytes;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_entries.push_front(Entry{key, std::move(surface), bytes});
+    m_index.emplace(std::move(key), m_entries.begin());
+    m_used_bytes += bytes;
+    evict();
+}
+
+void ImageCache::prefetchAround(std::uint32_t requester, std::vector<std::filesystem::path> const& image_paths,
+                                std::size_t index) noexcept {
+    std::vector<std::filesystem::path> prefetch_paths{};
+    {
+        // Only the earlier prefetches of this requester are replaced, other windows keep theirs
+        std::lock_guard lock{m_mutex};
+        auto& wanted_keys = m_wanted[requester];
+        wanted_keys.clear();
+
+        // Nearest neighbors first, the next image before the previous one, neighbors past either end are skipped (the
+        // unsigned index - distance wraps to a huge value)
+        for (std::size_t distance = 1; distance <= m_prefetch_radius; ++distance) {
+            for (std::size_t const neighbor : {index + distance, index - distance}) {
+                if (neighbor >= image_paths.size()) {
+                    continue;
+                }
+
+                std::string key = image_paths[neighbor].string();
+                wanted_keys.insert(key);
+                if (not m_index.contains(key) && not m_loading.contains(key)) {
+                    m_loading.insert(std::move(key));
+                    prefetch_paths.push_back(image_paths[neighbor]);
+                }
+            }
+        }
+    }
+
+    for (auto& prefetch_path : prefetch_paths) {
+        WorkerPool::shared().submit([this, image_path = std::move(prefetch_path)] {
+            std::string const key = image_path.string();
+            {
+                // The user moved on before the worker got to it
+                std::lock_guard lock{m_mutex};
+                if (not wanted(key)) {
+                    m_loading.erase(key);
+                    return;
+                }
+            }
+
+            SurfacePtr surface = loadImage(image_path);
+            insert(image_path, std::move(surface));
+
+            std::lock_guard lock{m_mutex};
+            m_loading.erase(key);
+        });
+    }
+}
+
+void ImageCache::cancelPrefetch(std::uint32_t requester) noexcept {
+    std::lock_guard lock{m_mutex};
+    m_wanted.erase(requester);
+}
+
+bool ImageCache::wanted(std::string const& key) const noexcept {
+    return std::any_of(m_wanted.begin(), m_wanted.end(),
+                       [&key](auto const& requester_keys) { return requester_keys.second.contains(key); });
+}
+
+void ImageCache::evict() noexcept {
+    while (m_used_bytes > m_budget_bytes && not m_entries.empty()) {
+        Entry const& entry = m_entries.back();
+        m_used_bytes -= entry.bytes;
+        m_index.erase(entry.key);
+        m_entries.pop_back();
+    }
+}
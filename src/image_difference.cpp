@@ -0,0 +1,316 @@
+#include "image_difference.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pixel_convert.hpp"
+#include "worker_pool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMGV2_DIFFERENCE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMGV2_DIFFERENCE_NEON 1
+#endif
+
+namespace {
+
+/// Pixels compared by each task, a millisecond or two of work
+constexpr int kBandPixels = 1 << 20;
+
+/// Squared differences are summed in 32 bits lanes over this many pixels at most, then moved to 64 bits
+constexpr int kSquaresBlockPixels = 4096;
+
+/// Totals of a band of rows, summed over the bands once they are all done
+struct BandStats {
+    int max_error{};
+    std::uint64_t squared_error{};
+    std::uint64_t differing_pixels{};
+};
+
+/// Byte masks of 4 pixels, the color channels and the alpha one
+struct PixelMasks {
+    alignas(16) std::uint8_t color[16]{};
+    alignas(16) std::uint8_t alpha[16]{};
+};
+
+PixelMasks pixelMasks(ByteChannels channels) noexcept {
+    PixelMasks masks{};
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        masks.color[pixel * 4 + channels.red] = 0xFF;
+        masks.color[pixel * 4 + channels.green] = 0xFF;
+        masks.color[pixel * 4 + channels.blue] = 0xFF;
+        masks.alpha[pixel * 4 + channels.alpha] = 0xFF;
+    }
+    return masks;
+}
+
+/// Write the difference of a row of 32 bits pixels laid out the same way, opaque, and add it up into stats
+void differenceRow(std::uint8_t const* first, std::uint8_t const* second, std::uint8_t* output, int width,
+                   ByteChannels channels, PixelMasks const& masks, int threshold, int gain_shift,
+                   BandStats& stats) noexcept {
+    int x = 0;
+#if IMGV2_DIFFERENCE_SSE2
+    __m128i const color_mask = _mm_load_si128(reinterpret_cast<__m128i const*>(masks.color));
+    __m128i const alpha = _mm_load_si128(reinterpret_cast<__m128i const*>(masks.alpha));
+    __m128i const threshold_bytes = _mm_set1_epi8(static_cast<char>(threshold));
+    __m128i const zero = _mm_setzero_si128();
+    __m128i max_error = zero;
+    int const vector_width = width & ~3;
+    while (x < vector_width) {
+        int const block_end = std::min(vector_width, x + kSquaresBlockPixels);
+        __m128i squares = zero;
+        for (; x < block_end; x += 4) {
+            __m128i const first_pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first + x * 4));
+            __m128i const second_pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(second + x * 4));
+            __m128i const difference = _mm_and_si128(
+                _mm_or_si128(_mm_subs_epu8(first_pixels, second_pixels), _mm_subs_epu8(second_pixels, first_pixels)),
+                color_mask);
+            max_error = _mm_max_epu8(max_error, difference);
+
+            __m128i const low = _mm_unpacklo_epi8(difference, zero);
+            __m128i const high = _mm_unpackhi_epi8(difference, zero);
+            squares = _mm_add_epi32(squares, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+
+            // Differences up to the threshold are hidden, the other ones doubled gain_shift times
+            __m128i const over = _mm_subs_epu8(difference, threshold_bytes);
+            __m128i const hidden = _mm_cmpeq_epi8(over, zero);
+            __m128i amplified = difference;
+            for (int i = 0; i < gain_shift; ++i) {
+                amplified = _mm_adds_epu8(amplified, amplified);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x * 4),
+                             _mm_or_si128(_mm_andnot_si128(hidden, amplified), alpha));
+
+            int const same_pixels = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(over, zero)));
+            stats.differing_pixels += static_cast<std::uint64_t>(4 - std::popcount(static_cast<unsigned>(same_pixels)));
+        }
+
+        alignas(16) std::uint32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), squares);
+        stats.squared_error += std::uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    alignas(16) std::uint8_t max_bytes[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(max_bytes), max_error);
+    stats.max_error = std::max<int>(stats.max_error, *std::max_element(std::begin(max_bytes), std::end(max_bytes)));
+#elif IMGV2_DIFFERENCE_NEON
+    uint8x16_t const color_mask = vld1q_u8(masks.color);
+    uint8x16_t const alpha = vld1q_u8(masks.alpha);
+    uint8x16_t const threshold_bytes = vdupq_n_u8(static_cast<std::uint8_t>(threshold));
+    uint8x16_t max_error = vdupq_n_u8(0);
+    int const vector_width = width & ~3;
+    while (x < vector_width) {
+        int const block_end = std::min(vector_width, x + kSquaresBlockPixels);
+        uint32x4_t squares = vdupq_n_u32(0);
+        uint32x4_t differing = vdupq_n_u32(0);
+        for (; x < block_end; x += 4) {
+            uint8x16_t const difference =
+                vandq_u8(vabdq_u8(vld1q_u8(first + x * 4), vld1q_u8(second + x * 4)), color_mask);
+            max_error = vmaxq_u8(max_error, difference);
+
+            squares = vpadalq_u16(squares, vmull_u8(vget_low_u8(difference), vget_low_u8(difference)));
+            squares = vpadalq_u16(squares, vmull_u8(vget_high_u8(difference), vget_high_u8(difference)));
+
+            // Differences up to the threshold are hidden, the other ones doubled gain_shift times
+            uint8x16_t const shown = vcgtq_u8(difference, threshold_bytes);
+            uint8x16_t amplified = difference;
+            for (int i = 0; i < gain_shift; ++i) {
+                amplified = vqaddq_u8(amplified, amplified);
+            }
+            vst1q_u8(output + x * 4, vorrq_u8(vandq_u8(amplified, shown), alpha));
+
+            // All ones is -1, subtracting it counts the pixels with a channel shown
+            uint32x4_t const shown_pixels = vreinterpretq_u32_u8(shown);
+            differing = vsubq_u32(differing, vtstq_u32(shown_pixels, shown_pixels));
+        }
+
+        alignas(16) std::uint32_t lanes[4];
+        vst1q_u32(lanes, squares);
+        stats.squared_error += std::uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+        vst1q_u32(lanes, differing);
+        stats.differing_pixels += std::uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    alignas(16) std::uint8_t max_bytes[16];
+    vst1q_u8(max_bytes, max_error);
+    stats.max_error = std::max<int>(stats.max_error, *std::max_element(std::begin(max_bytes), std::end(max_bytes)));
+#else
+    (void)masks;
+#endif
+
+    for (; x < width; ++x) {
+        std::uint8_t const* first_pixel = first + x * 4;
+        std::uint8_t const* second_pixel = second + x * 4;
+        std::uint8_t* output_pixel = output + x * 4;
+        bool differing{false};
+        for (int const channel : {channels.red, channels.green, channels.blue}) {
+            int const difference = std::abs(int{first_pixel[channel]} - int{second_pixel[channel]});
+            stats.max_error = std::max(stats.max_error, difference);
+            stats.squared_error += static_cast<std::uint64_t>(difference * difference);
+            differing = differing || difference > threshold;
+            output_pixel[channel] =
+                difference > threshold ? static_cast<std::uint8_t>(std::min(difference << gain_shift, 255)) : 0U;
+        }
+        output_pixel[channels.alpha] = 0xFF;
+        stats.differing_pixels += differing ? 1U : 0U;
+    }
+}
+
+}  // namespace
+
+void computeDifferenceAsync(
+    SurfacePtr first_surface, SurfacePtr second_surface, DifferenceOptions options,
+    std::shared_ptr<std::atomic_bool const> cancelled,
+    std::function<void(SurfacePtr difference_surface, DifferenceStats const& stats, std::string const& error)>
+        done) noexcept {
+    struct Job {
+        SurfacePtr first_surface{};
+        SurfacePtr second_surface{};
+        SurfacePtr difference_surface{};
+        std::optional<ByteChannels> channels{};
+        PixelMasks masks{};
+        int threshold{};
+        int gain_shift{};
+        std::shared_ptr<std::atomic_bool const> cancelled{};
+        std::function<void(SurfacePtr, DifferenceStats const&, std::string const&)> done{};
+        std::mutex mutex{};
+        BandStats stats{};
+        std::string error{};
+        std::size_t remaining_bands{};
+
+        bool isCancelled() const noexcept { return cancelled && *cancelled; }
+    };
+
+    auto job = std::make_shared<Job>();
+    job->first_surface = std::move(first_surface);
+    job->second_surface = std::move(second_surface);
+    job->threshold = std::clamp(options.threshold, 0, 255);
+    job->gain_shift = std::clamp(static_cast<int>(std::bit_width(static_cast<unsigned>(std::max(options.gain, 1)))) - 1,
+                                 0, 7);
+    job->cancelled = std::move(cancelled);
+    job->done = std::move(done);
+
+    // The output is allocated by a worker too, clearing hundreds of megabytes is not for the main thread
+    WorkerPool::shared().submit([job] {
+        if (job->isCancelled()) {
+            return;
+        }
+
+        SDL_Surface const* first = job->first_surface.get();
+        SDL_Surface const* second = job->second_surface.get();
+        if (first == nullptr || second == nullptr) {
+            job->done(nullptr, {}, "no image to compare with");
+            return;
+        }
+        if (first->w <= 0 || first->h <= 0) {
+            job->done(nullptr, {}, "empty image");
+            return;
+        }
+        if (first->w != second->w || first->h != second->h) {
+            job->done(nullptr, {},
+                      "images of different sizes, " + std::to_string(first->w) + "x" + std::to_string(first->h) +
+                          " and " + std::to_string(second->w) + "x" + std::to_string(second->h));
+            return;
+        }
+
+        // Surfaces of the same 32 bits layout are compared in place, the other ones row by row as ARGB8888
+        auto const channels = byteChannels(first->format->format);
+        bool const in_place = channels && first->format->format == second->format->format;
+        Uint32 const output_format = in_place ? first->format->format : Uint32{SDL_PIXELFORMAT_ARGB8888};
+        job->channels = in_place ? channels : byteChannels(SDL_PIXELFORMAT_ARGB8888);
+        job->masks = pixelMasks(*job->channels);
+        job->difference_surface =
+            SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, first->w, first->h, 32, output_format);
+        if (not job->difference_surface) {
+            job->done(nullptr, {}, SDL_GetError());
+            return;
+        }
+
+        int const band_rows = std::max(kBandPixels / std::max(first->w, 1), 1);
+        job->remaining_bands = static_cast<std::size_t>((first->h + band_rows - 1) / band_rows);
+        for (int band_y = 0; band_y < first->h; band_y += band_rows) {
+            int const band_end = std::min(band_y + band_rows, first->h);
+            WorkerPool::shared().submit([job, band_y, band_end, in_place] {
+                BandStats band_stats{};
+                std::string band_error{};
+                if (not job->isCancelled()) {
+                    SDL_Surface const* first = job->first_surface.get();
+                    SDL_Surface const* second = job->second_surface.get();
+                    SDL_Surface* output = job->difference_surface.get();
+                    std::vector<std::uint8_t> first_row{};
+                    std::vector<std::uint8_t> second_row{};
+                    if (not in_place) {
+                        first_row.resize(static_cast<std::size_t>(first->w) * 4U);
+                        second_row.resize(static_cast<std::size_t>(first->w) * 4U);
+                    }
+
+                    for (int y = band_y; y < band_end; ++y) {
+                        auto const row = [y](SDL_Surface const* surface) {
+                            return static_cast<std::uint8_t const*>(surface->pixels) +
+                                   static_cast<std::ptrdiff_t>(y) * surface->pitch;
+                        };
+                        std::uint8_t const* first_pixels = row(first);
+                        std::uint8_t const* second_pixels = row(second);
+                        if (not in_place) {
+                            SDL_Rect const row_rect{0, y, first->w, 1};
+                            if (not convertPixels(first, row_rect, SDL_PIXELFORMAT_ARGB8888, first_row.data(),
+                                                  first->w * 4) ||
+                                not convertPixels(second, row_rect, SDL_PIXELFORMAT_ARGB8888, second_row.data(),
+                                                  first->w * 4)) {
+                                band_error = SDL_GetError();
+                                break;
+                            }
+                            first_pixels = first_row.data();
+                            second_pixels = second_row.data();
+                        }
+                        differenceRow(first_pixels, second_pixels,
+                                      static_cast<std::uint8_t*>(output->pixels) +
+                                          static_cast<std::ptrdiff_t>(y) * output->pitch,
+                                      first->w, *job->channels, job->masks, job->threshold, job->gain_shift,
+                                      band_stats);
+                    }
+                }
+
+                bool last_band{};
+                {
+                    std::lock_guard lock{job->mutex};
+                    job->stats.max_error = std::max(job->stats.max_error, band_stats.max_error);
+                    job->stats.squared_error += band_stats.squared_error;
+                    job->stats.differing_pixels += band_stats.differing_pixels;
+                    if (job->error.empty()) {
+                        job->error = std::move(band_error);
+                    }
+                    last_band = --job->remaining_bands == 0U;
+                }
+                if (not last_band || job->isCancelled()) {
+                    return;
+                }
+                if (not job->error.empty()) {
+                    job->done(nullptr, {}, job->error);
+                    return;
+                }
+
+                DifferenceStats stats{};
+                stats.max_error = job->stats.max_error;
+                stats.differing_pixels = job->stats.differing_pixels;
+                stats.pixel_count = static_cast<std::uint64_t>(job->first_surface->w) *
+                                    static_cast<std::uint64_t>(job->first_surface->h);
+                double const mean_squared_error =
+                    static_cast<double>(job->stats.squared_error) / (static_cast<double>(stats.pixel_count) * 3.0);
+                stats.psnr = mean_squared_error > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mean_squared_error)
+                                                      : std::numeric_limits<double>::infinity();
+                job->done(std::move(job->difference_surface), stats, {});
+            });
+        }
+    });
+}
@@ -0,0 +1,356 @@
+#include "image_inspector.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "overlay_text.hpp"
+
+namespace {
+
+/// Size of the overlay in window points, the histogram has one column per level
+constexpr float kHistogramWidth = 256.0f;
+constexpr float kHistogramHeight = 96.0f;
+constexpr float kMargin = 8.0f;
+constexpr float kPadding = 6.0f;
+
+/// Overlay text is drawn with squares of kFontScale points per font pixel
+constexpr float kFontScale = 2.0f;
+
+/// Color of the pixel at x, y of a surface of 8 bits or more per pixel
+std::optional<SDL_Color> readPixel(SDL_Surface const* surface, int x, int y) noexcept {
+    SDL_PixelFormat const* format = surface->format;
+    if (format->BitsPerPixel < 8) {
+        return std::nullopt;
+    }
+
+    auto const* pixel = static_cast<std::uint8_t const*>(surface->pixels) +
+                        static_cast<std::ptrdiff_t>(y) * surface->pitch + x * format->BytesPerPixel;
+    Uint32 value{};
+    switch (format->BytesPerPixel) {
+        case 1: {
+            value = pixel[0];
+            break;
+        }
+        case 2: {
+            Uint16 value16{};
+            std::memcpy(&value16, pixel, sizeof(value16));
+            value = value16;
+            break;
+        }
+        case 3: {
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+            value = (Uint32{pixel[0]} << 16) | (Uint32{pixel[1]} << 8) | Uint32{pixel[2]};
+#else
+            value = Uint32{pixel[0]} | (Uint32{pixel[1]} << 8) | (Uint32{pixel[2]} << 16);
+#endif
+            break;
+        }
+        default: {
+            std::memcpy(&value, pixel, sizeof(value));
+            break;
+        }
+    }
+
+    SDL_Color color{};
+    SDL_GetRGBA(value, format, &color.r, &color.g, &color.b, &color.a);
+    return color;
+}
+
+/// Parts of rect outside of excluded, as up to 4 rects
+std::vector<SDL_Rect> subtractRect(SDL_Rect const& rect, SDL_Rect const& excluded) noexcept {
+    SDL_Rect overlap{};
+    if (not SDL_IntersectRect(&rect, &excluded, &overlap)) {
+        return {rect};
+    }
+
+    std::vector<SDL_Rect> parts{};
+    auto const add = [&parts](SDL_Rect const& part) {
+        if (part.w > 0 && part.h > 0) {
+            parts.push_back(part);
+        }
+    };
+    add({rect.x, rect.y, rect.w, overlap.y - rect.y});
+    add({rect.x, overlap.y + overlap.h, rect.w, rect.y + rect.h - overlap.y - overlap.h});
+    add({rect.x, overlap.y, overlap.x - rect.x, overlap.h});
+    add({overlap.x + overlap.w, overlap.y, rect.x + rect.w - overlap.x - overlap.w, overlap.h});
+    return parts;
+}
+
+std::int64_t area(std::vector<SDL_Rect> const& rects) noexcept {
+    std::int64_t pixels{};
+    for (auto const& rect : rects) {
+        pixels += std::int64_t{rect.w} * rect.h;
+    }
+    return pixels;
+}
+
+}  // namespace
+
+/// Histograms handed over from the workers to the main thread
+struct ImageInspector::Results {
+    std::mutex mutex{};
+    std::optional<Histogram> image_histogram{};
+    std::optional<Histogram> region_change{};
+};
+
+std::uint32_t ImageInspector::histogramEventType() noexcept {
+    static std::uint32_t const histogram_event_type{SDL_RegisterEvents(1)};
+    return histogram_event_type;
+}
+
+ImageInspector::ImageInspector(std::uint32_t window_id) noexcept : m_window_id{window_id} {}
+
+ImageInspector::~ImageInspector() noexcept {
+    if (m_cancelled) {
+        *m_cancelled = true;
+    }
+}
+
+void ImageInspector::setSurface(SurfacePtr surface) noexcept {
+    if (surface == m_surface) {
+        return;
+    }
+
+    // Counts of the previous image still running are dropped, their results go to the previous Results
+    if (m_cancelled) {
+        *m_cancelled = true;
+    }
+    m_surface = std::move(surface);
+    m_image_size = m_surface ? imageSize(m_surface) : SDL_Point{};
+    m_cancelled = std::make_shared<std::atomic_bool>(false);
+    m_results = std::make_shared<Results>();
+    m_image_histogram.reset();
+    m_region_histogram.reset();
+    m_region = {};
+    m_requested_region = {};
+    m_counting_region.reset();
+    m_cursor.reset();
+    if (not m_surface) {
+        return;
+    }
+
+    m_requested_region = {0, 0, m_surface->w, m_surface->h};
+    std::uint32_t const window_id = m_window_id;
+    countPixelsAsync(m_surface, {m_requested_region}, {}, m_cancelled,
+                     [results = m_results, window_id](Histogram const& histogram) {
+                         {
+                             std::lock_guard lock{results->mutex};
+                             results->image_histogram = histogram;
+                         }
+
+                         SDL_Event event{};
+                         event.type = histogramEventType();
+                         event.user.windowID = window_id;
+                         SDL_PushEvent(&event);
+                     });
+}
+
+void ImageInspector::setVisibleRegion(SDL_Rect const& region) noexcept {
+    if (not m_surface) {
+        return;
+    }
+
+    SDL_Rect const requested_region = surfaceRect(region);
+    if (SDL_RectEquals(&requested_region, &m_requested_region)) {
+        return;
+    }
+    m_requested_region = requested_region;
+    countRegion();
+}
+
+void ImageInspector::countRegion() noexcept {
+    if (not m_surface || m_counting_region) {
+        return;
+    }
+
+    // The whole image is the histogram counted once for all
+    SDL_Rect const whole_region{0, 0, m_surface->w, m_surface->h};
+    if (SDL_RectEquals(&m_requested_region, &whole_region) || m_requested_region.w <= 0 || m_requested_region.h <= 0) {
+        m_region_histogram.reset();
+        return;
+    }
+    if (m_region_histogram && SDL_RectEquals(&m_requested_region, &m_region)) {
+        return;
+    }
+
+    // Panning and zooming step by step leave most of the view in place, only the pixels around it are counted
+    std::vector<SDL_Rect> added{m_requested_region};
+    std::vector<SDL_Rect> removed{};
+    m_counting_whole_region = true;
+    if (m_region_histogram) {
+        auto entering = subtractRect(m_requested_region, m_region);
+        auto leaving = subtractRect(m_region, m_requested_region);
+        if (area(entering) + area(leaving) < area(added)) {
+            added = std::move(entering);
+            removed = std::move(leaving);
+            m_counting_whole_region = false;
+        }
+    }
+
+    m_counting_region = m_requested_region;
+    std::uint32_t const window_id = m_window_id;
+    countPixelsAsync(m_surface, added, removed, m_cancelled,
+                     [results = m_results, window_id](Histogram const& histogram) {
+                         {
+                             std::lock_guard lock{results->mutex};
+                             results->region_change = histogram;
+                         }
+
+                         SDL_Event event{};
+                         event.type = histogramEventType();
+                         event.user.windowID = window_id;
+                         SDL_PushEvent(&event);
+                     });
+}
+
+bool ImageInspector::setCursor(std::optional<SDL_Point> image_point) noexcept {
+    std::optional<SDL_Color> color{};
+    if (image_point && m_surface && m_image_size.x > 0 && m_image_size.y > 0) {
+        int const x = static_cast<int>(static_cast<std::int64_t>(image_point->x) * m_surface->w / m_image_size.x);
+        int const y = static_cast<int>(static_cast<std::int64_t>(image_point->y) * m_surface->h / m_image_size.y);
+        if (x >= 0 && y >= 0 && x < m_surface->w && y < m_surface->h) {
+            color = readPixel(m_surface.get(), x, y);
+        }
+    }
+    if (not color) {
+        image_point.reset();
+    }
+
+    SDL_Color const cursor_color = color.value_or(SDL_Color{});
+    bool const changed = image_point.has_value() != m_cursor.has_value() ||
+                         (image_point && (image_point->x != m_cursor->x || image_point->y != m_cursor->y ||
+                                          std::memcmp(&cursor_color, &m_cursor_color, sizeof(SDL_Color)) != 0));
+    m_cursor = image_point;
+    m_cursor_color = cursor_color;
+    return changed;
+}
+
+bool ImageInspector::update() noexcept {
+    if (not m_results) {
+        return false;
+    }
+
+    std::optional<Histogram> image_histogram{};
+    std::optional<Histogram> region_change{};
+    {
+        std::lock_guard lock{m_results->mutex};
+        image_histogram = std::exchange(m_results->image_histogram, std::nullopt);
+        region_change = std::exchange(m_results->region_change, std::nullopt);
+    }
+
+    bool changed{false};
+    if (image_histogram) {
+        m_image_histogram = std::move(image_histogram);
+        changed = true;
+    }
+    if (region_change && m_counting_region) {
+        if (m_counting_whole_region || not m_region_histogram) {
+            m_region_histogram = std::move(region_change);
+        } else {
+            m_region_histogram->add(*region_change);
+        }
+        m_region = *m_counting_region;
+        m_counting_region.reset();
+        changed = true;
+
+        // The view may have moved on while counting
+        countRegion();
+    }
+    return changed;
+}
+
+SDL_Rect ImageInspector::surfaceRect(SDL_Rect const& image_rect) const noexcept {
+    if (not m_surface || m_image_size.x <= 0 || m_image_size.y <= 0) {
+        return {};
+    }
+
+    double const scale_x = static_cast<double>(m_surface->w) / m_image_size.x;
+    double const scale_y = static_cast<double>(m_surface->h) / m_image_size.y;
+    int const left = std::clamp(static_cast<int>(std::floor(image_rect.x * scale_x)), 0, m_surface->w);
+    int const top = std::clamp(static_cast<int>(std::floor(image_rect.y * scale_y)), 0, m_surface->h);
+    int const right =
+        std::clamp(static_cast<int>(std::ceil((image_rect.x + image_rect.w) * scale_x)), left, m_surface->w);
+    int const bottom =
+        std::clamp(static_cast<int>(std::ceil((image_rect.y + image_rect.h) * scale_y)), top, m_surface->h);
+    return {left, top, right - left, bottom - top};
+}
+
+bool ImageInspector::render(SDL_Renderer* renderer, float density) const noexcept {
+    int output_width{};
+    int output_height{};
+    if (SDL_GetRendererOutputSize(renderer, &output_width, &output_height)) {
+        return false;
+    }
+
+    char text[64]{};
+    if (m_cursor) {
+        std::snprintf(text, sizeof(text), "X %d Y %d  R %d G %d B %d A %d", m_cursor->x, m_cursor->y,
+                      m_cursor_color.r, m_cursor_color.g, m_cursor_color.b, m_cursor_color.a);
+    }
+    SDL_FPoint const text_size = textSize(text, kFontScale * density);
+    float const panel_width = std::max(kHistogramWidth * density, text_size.x) + 2.0f * kPadding * density;
+    float const panel_height =
+        (kHistogramHeight + 2.0f * kPadding) * density + (m_cursor ? kPadding * density + text_size.y : 0.0f);
+    SDL_FRect const panel{kMargin * density, static_cast<float>(output_height) - (kMargin * density + panel_height),
+                          panel_width, panel_height};
+
+    if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) ||
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xB0) || SDL_RenderFillRectF(renderer, &panel)) {
+        return false;
+    }
+
+    // The visible region while zoomed in, the whole image otherwise or until the region is counted
+    SDL_Rect const whole_region{0, 0, m_surface ? m_surface->w : 0, m_surface ? m_surface->h : 0};
+    bool const show_region = m_region_histogram && not SDL_RectEquals(&m_requested_region, &whole_region);
+    Histogram const* histogram =
+        show_region ? &*m_region_histogram : (m_image_histogram ? &*m_image_histogram : nullptr);
+    if (histogram != nullptr) {
+        // Clipped shadows and highlights would flatten everything else, the scale ignores the extreme levels
+        std::uint32_t max_count{1U};
+        for (auto const& counts : histogram->counts) {
+            max_count = std::max(max_count, *std::max_element(counts.begin() + 1, counts.end() - 1));
+        }
+
+        static constexpr std::array<SDL_Color, Histogram::kChannelCount> kChannelColors{{
+            {0xFF, 0x50, 0x50, 0xC0},
+            {0x50, 0xFF, 0x50, 0xC0},
+            {0x60, 0x80, 0xFF, 0xC0},
+            {0xFF, 0xFF, 0xFF, 0xC0},
+        }};
+        float const left = panel.x + kPadding * density;
+        float const bottom = panel.y + (kPadding + kHistogramHeight) * density;
+        std::array<SDL_FPoint, 256> points{};
+        for (std::size_t channel = 0U; channel < histogram->counts.size(); ++channel) {
+            for (std::size_t level = 0U; level < points.size(); ++level) {
+                float const height =
+                    std::min(static_cast<float>(histogram->counts[channel][level]) / static_cast<float>(max_count),
+                             1.0f);
+                points[level] = {left + static_cast<float>(level) * density,
+                                 bottom - height * kHistogramHeight * density};
+            }
+
+            SDL_Color const color = kChannelColors[channel];
+            if (SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a) ||
+                SDL_RenderDrawLinesF(renderer, points.data(), static_cast<int>(points.size()))) {
+                return false;
+            }
+        }
+    }
+
+    if (m_cursor) {
+        SDL_FPoint const text_origin{panel.x + kPadding * density,
+                                     panel.y + panel.h - kPadding * density - text_size.y};
+        if (SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF) ||
+            not renderText(renderer, text, text_origin, kFontScale * density)) {
+            return false;
+        }
+    }
+
+    return SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE) == 0;
+}
@@ -0,0 +1,341 @@
+#include "image_loader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "byte_order.hpp"
+#include "directory_index.hpp"
+#include "disk_cache.hpp"
+#include "mapped_file.hpp"
+#include "progressive_decode.hpp"
+#include "reduced_decode.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+/// Extensions of the formats listed by pickImageDialog
+constexpr std::array<std::string_view, 29> kImageExtensions{
+    ".avif", ".bmp", ".gif", ".iff", ".ilbm", ".lbm", ".jpg", ".jpeg", ".jpe", ".jif", ".jfif", ".jxl", ".xv", ".cur",
+    ".ico",  ".pcx", ".pcc", ".dcx", ".pnm",  ".png", ".svg", ".tif",  ".tiff", ".qoi", ".tga", ".xpm",  ".pm", ".xcf",
+    ".webp"};
+
+/// Decode size limit, 0 when images are always decoded in full
+std::atomic_int g_decode_width_limit{0};
+std::atomic_int g_decode_height_limit{0};
+
+/// Deleter of reduced surfaces, releases the surface it holds
+struct ReducedSurface {
+    SDL_Point image_size{};
+    SurfacePtr surface{};
+
+    void operator()(SDL_Surface*) noexcept { surface.reset(); }
+};
+
+/// SDL_RWops that forwards to another stream until the load is cancelled
+SDL_RWops* makeCancellableRW(SDL_RWops* source, std::atomic_bool const* cancelled) noexcept {
+    SDL_RWops* rw = SDL_AllocRW();
+    if (rw == nullptr) {
+        SDL_RWclose(source);
+        return nullptr;
+    }
+
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = source;
+    rw->hidden.unknown.data2 = const_cast<std::atomic_bool*>(cancelled);
+    rw->size = [](SDL_RWops* context) -> Sint64 {
+        return SDL_RWsize(static_cast<SDL_RWops*>(context->hidden.unknown.data1));
+    };
+    rw->seek = [](SDL_RWops* context, Sint64 offset, int whence) -> Sint64 {
+        return SDL_RWseek(static_cast<SDL_RWops*>(context->hidden.unknown.data1), offset, whence);
+    };
+    rw->read = [](SDL_RWops* context, void* ptr, size_t size, size_t maxnum) -> size_t {
+        if (static_cast<std::atomic_bool*>(context->hidden.unknown.data2)->load(std::memory_order_relaxed)) {
+            SDL_SetError("image load was cancelled");
+            return 0;
+        }
+        return SDL_RWread(static_cast<SDL_RWops*>(context->hidden.unknown.data1), ptr, size, maxnum);
+    };
+    rw->write = [](SDL_RWops*, void const*, size_t, size_t) -> size_t {
+        SDL_SetError("image stream is read only");
+        return 0;
+    };
+    rw->close = [](SDL_RWops* context) -> int {
+        int const result = SDL_RWclose(static_cast<SDL_RWops*>(context->hidden.unknown.data1));
+        SDL_FreeRW(context);
+        return result;
+    };
+    return rw;
+}
+
+/// Walk the JPEG markers until the start of frame which holds the dimensions
+std::optional<SDL_Point> probeJpegSize(SDL_RWops* rw) noexcept {
+    std::array<std::uint8_t, 8> segment{};
+    if (SDL_RWseek(rw, 2, RW_SEEK_SET) < 0) {
+        return std::nullopt;
+    }
+
+    while (SDL_RWread(rw, segment.data(), 1, 4) == 4) {
+        if (segment[0] != 0xFF) {
+            return std::nullopt;
+        }
+
+        std::uint8_t const marker = segment[1];
+        std::uint16_t const length = readBE16(&segment[2]);
+        bool const is_start_of_frame =
+            marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (is_start_of_frame) {
+            if (SDL_RWread(rw, segment.data(), 1, 5) != 5) {
+                return std::nullopt;
+            }
+            return SDL_Point{readBE16(&segment[3]), readBE16(&segment[1])};
+        }
+
+        if (length < 2 || SDL_RWseek(rw, length - 2, RW_SEEK_CUR) < 0) {
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+}  // namespace
+
+void setDecodeSizeLimit(SDL_Point size_limit) noexcept {
+    g_decode_width_limit.store(size_limit.x, std::memory_order_relaxed);
+    g_decode_height_limit.store(size_limit.y, std::memory_order_relaxed);
+}
+
+SurfacePtr makeReducedSurface(SurfacePtr surface, SDL_Point image_size) noexcept {
+    if (not surface) {
+        return surface;
+    }
+
+    // The deleter holds the surface and carries the image size along, imageSize() finds it back with get_deleter
+    SDL_Surface* reduced_surface = surface.get();
+    return SurfacePtr{reduced_surface, ReducedSurface{image_size, std::move(surface)}};
+}
+
+SDL_Point imageSize(SurfacePtr const& surface) noexcept {
+    if (auto const* reduced_surface = std::get_deleter<ReducedSurface>(surface)) {
+        return reduced_surface->image_size;
+    }
+    return surface ? SDL_Point{surface->w, surface->h} : SDL_Point{};
+}
+
+SurfacePtr loadImage(std::filesystem::path const& image_path, std::atomic_bool const* cancelled,
+                     bool full_resolution, PreviewCallback const& preview) noexcept {
+    SDL_Point const size_limit{g_decode_width_limit.load(std::memory_order_relaxed),
+                               g_decode_height_limit.load(std::memory_order_relaxed)};
+    bool const reduce = not full_resolution && size_limit.x > 0 && size_limit.y > 0;
+    auto const extension = image_path.extension().string();
+
+    // Decoders read straight from the page cache instead of through many small stdio reads and seeks
+    auto const map_file = [&image_path] {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Loading %s", image_path.c_str());
+        TRACE_SCOPE("map file", image_path.c_str());
+        return MappedFile::open(image_path);
+    };
+
+    // The codec scaling reads less than the full size entry of the disk cache, so it is tried first
+    std::unique_ptr<MappedFile> image_file{};
+    if (reduce) {
+        image_file = map_file();
+        if (image_file) {
+            TRACE_SCOPE("decode reduced", image_path.c_str());
+            if (auto reduced_surface = decodeReduced(*image_file, extension, size_limit)) {
+                return reduced_surface;
+            }
+        }
+    }
+
+    if (DiskCache::shared().enabled()) {
+        TRACE_SCOPE("disk cache lookup", image_path.c_str());
+        if (auto cached_surface = DiskCache::shared().load(image_path)) {
+            if (reduce) {
+                TRACE_SCOPE("downscale", image_path.c_str());
+                return downscaleToLimit(std::move(cached_surface), size_limit);
+            }
+            return cached_surface;
+        }
+    }
+
+    if (not reduce) {
+        image_file = map_file();
+    }
+
+    // Large images are shown as they fill in, the formats without a progressive decoder go through SDL_image
+    SurfacePtr image_surface{};
+    if (preview && image_file) {
+        TRACE_SCOPE("decode progressive", image_path.c_str());
+        image_surface = decodeProgressive(*image_file, extension, cancelled, preview);
+    }
+    if (not image_surface && cancelled != nullptr && *cancelled) {
+        SDL_SetError("image load was cancelled");
+        return {nullptr};
+    }
+
+    if (not image_surface) {
+        SDL_RWops* source = image_file ? image_file->rwops() : SDL_RWFromFile(image_path.c_str(), "rb");
+        if (source == nullptr) {
+            return {nullptr};
+        }
+
+        if (cancelled != nullptr) {
+            source = makeCancellableRW(source, cancelled);
+            if (source == nullptr) {
+                return {nullptr};
+            }
+        }
+
+        // The extension is the only hint for formats without a signature, like TGA
+        TRACE_SCOPE("decode", image_path.c_str());
+        image_surface = SDLit::make_unique(IMG_LoadTyped_RW, source, 1,
+                                           extension.empty() ? nullptr : extension.c_str() + 1);
+    }
+
+    // Writing the entry would delay the display, the surface is shared with the store task instead, and at full size
+    // the entry serves reduced and full resolution loads alike
+    if (image_surface && DiskCache::shared().enabled()) {
+        WorkerPool::shared().submit(
+            [image_path, image_surface] { DiskCache::shared().store(image_path, image_surface.get()); });
+    }
+
+    // Codecs without scaling are decoded in full and downscaled, which still spares the upload and the memory
+    if (image_surface && reduce) {
+        TRACE_SCOPE("downscale", image_path.c_str());
+        return downscaleToLimit(std::move(image_surface), size_limit);
+    }
+    return image_surface;
+}
+
+SurfacePtr loadThumbnail(std::filesystem::path const& image_path, SDL_Point thumbnail_size,
+                         std::atomic_bool const* cancelled) noexcept {
+    if (thumbnail_size.x <= 0 || thumbnail_size.y <= 0) {
+        SDL_SetError("invalid thumbnail size %dx%d", thumbnail_size.x, thumbnail_size.y);
+        return {nullptr};
+    }
+
+    auto image_file = MappedFile::open(image_path);
+    if (not image_file) {
+        return {nullptr};
+    }
+
+    auto const extension = image_path.extension().string();
+    SurfacePtr image_surface = decodeReduced(*image_file, extension, thumbnail_size);
+    if (not image_surface) {
+        SDL_RWops* source = image_file->rwops();
+        if (source != nullptr && cancelled != nullptr) {
+            source = makeCancellableRW(source, cancelled);
+        }
+        if (source == nullptr) {
+            return {nullptr};
+        }
+
+        image_surface = SDLit::make_unique(IMG_LoadTyped_RW, source, 1,
+                                           extension.empty() ? nullptr : extension.c_str() + 1);
+        if (not image_surface) {
+            return {nullptr};
+        }
+        image_surface = downscaleToLimit(std::move(image_surface), thumbnail_size);
+    }
+
+    // The last step is at most a halving, a linear stretch is sharp enough for it
+    SurfacePtr argb_surface = image_surface;
+    if (image_surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        argb_surface = SDLit::make_unique(SDL_ConvertSurfaceFormat, image_surface.get(), SDL_PIXELFORMAT_ARGB8888, 0);
+        if (not argb_surface) {
+            return {nullptr};
+        }
+    }
+
+    float const scale = std::min({static_cast<float>(thumbnail_size.x) / static_cast<float>(argb_surface->w),
+                                  static_cast<float>(thumbnail_size.y) / static_cast<float>(argb_surface->h), 1.0f});
+    int const width = std::max(static_cast<int>(static_cast<float>(argb_surface->w) * scale), 1);
+    int const height = std::max(static_cast<int>(static_cast<float>(argb_surface->h) * scale), 1);
+    if (width == argb_surface->w && height == argb_surface->h) {
+        return argb_surface;
+    }
+
+    SurfacePtr thumbnail_surface =
+        SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (not thumbnail_surface || SDL_SoftStretchLinear(argb_surface.get(), nullptr, thumbnail_surface.get(), nullptr)) {
+        return {nullptr};
+    }
+    return thumbnail_surface;
+}
+
+std::optional<SDL_Point> probeImageSize(std::filesystem::path const& image_path) noexcept {
+    auto rw = SDLit::make_unique(SDL_RWFromFile, image_path.c_str(), "rb");
+    if (not rw) {
+        return std::nullopt;
+    }
+
+    std::array<std::uint8_t, 32> header{};
+    if (SDL_RWread(rw.get(), header.data(), 1, header.size()) != header.size()) {
+        return std::nullopt;
+    }
+
+    auto const starts_with = [&header](std::string_view magic, std::size_t offset = 0U) -> bool {
+        return std::string_view{reinterpret_cast<char const*>(header.data()) + offset, magic.size()} == magic;
+    };
+
+    if (starts_with("\x89PNG\r\n\x1a\n") && starts_with("IHDR", 12)) {
+        return SDL_Point{static_cast<int>(readBE32(&header[16])), static_cast<int>(readBE32(&header[20]))};
+    } else if (header[0] == 0xFF && header[1] == 0xD8) {
+        return probeJpegSize(rw.get());
+    } else if (starts_with("GIF87a") || starts_with("GIF89a")) {
+        return SDL_Point{readLE16(&header[6]), readLE16(&header[8])};
+    } else if (starts_with("BM")) {
+        auto const height = static_cast<std::int32_t>(readLE32(&header[22]));
+        return SDL_Point{static_cast<int>(readLE32(&header[18])), height < 0 ? -height : height};
+    } else if (starts_with("qoif")) {
+        return SDL_Point{static_cast<int>(readBE32(&header[4])), static_cast<int>(readBE32(&header[8]))};
+    } else if (starts_with("RIFF") && starts_with("WEBP", 8)) {
+        if (starts_with("VP8 ", 12)) {
+            return SDL_Point{readLE16(&header[26]) & 0x3FFF, readLE16(&header[28]) & 0x3FFF};
+        } else if (starts_with("VP8L", 12)) {
+            std::uint32_t const bits = readLE32(&header[21]);
+            return SDL_Point{static_cast<int>((bits & 0x3FFF) + 1), static_cast<int>(((bits >> 14) & 0x3FFF) + 1)};
+        } else if (starts_with("VP8X", 12)) {
+            int const width = 1 + (header[24] | (header[25] << 8) | (header[26] << 16));
+            int const height = 1 + (header[27] | (header[28] << 8) | (header[29] << 16));
+            return SDL_Point{width, height};
+        }
+    }
+    return std::nullopt;
+}
+
+bool isImageFile(std::filesystem::path const& file_path) noexcept {
+    return isImageExtension(file_path.extension().string());
+}
+
+bool isImageExtension(std::string_view extension) noexcept {
+    return std::any_of(kImageExtensions.begin(), kImageExtensions.end(), [extension](std::string_view image_extension) {
+        return std::equal(extension.begin(), extension.end(), image_extension.begin(), image_extension.end(),
+                          [](char c, char image_c) { return std::tolower(static_cast<unsigned char>(c)) == image_c; });
+    });
+}
+
+std::vector<std::filesystem::path> listDirectoryImages(std::filesystem::path const& directory_path) noexcept {
+    std::vector<std::filesystem::path> image_paths{};
+    std::error_code error{};
+    std::filesystem::directory_iterator it{directory_path, error};
+    for (; not error && it != std::filesystem::directory_iterator{}; it.increment(error)) {
+        if (isImageFile(it->path())) {
+            image_paths.push_back(it->path());
+        }
+    }
+
+    if (error) {
+        SDL_SetError("failed to list %s: %s", directory_path.c_str(), error.message().c_str());
+    }
+
+    std::sort(image_paths.begin(), image_paths.end(), [](auto const& lhs, auto const& rhs) {
+        return naturalLess(lhs.filename().string(), rhs.filename().string());
+    });
+    return image_paths;
+}
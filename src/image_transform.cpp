@@ -0,0 +1,116 @@
+#include "image_transform.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+/// Edge of the blocks a transposing copy goes through, a block of 4 bytes pixels from the source and one from the
+/// destination take 32 KiB together and stay in the L1 cache while the block is copied
+constexpr int kBlockSize = 64;
+
+}  // namespace
+
+SurfacePtr transformSurface(SurfacePtr const& surface, SDL_RendererFlip flip, int quarter_turns) noexcept {
+    if (not surface) {
+        SDL_SetError("no surface to transform");
+        return {nullptr};
+    }
+
+    quarter_turns = ((quarter_turns % 4) + 4) % 4;
+    if (quarter_turns == 0 && flip == SDL_FLIP_NONE) {
+        return surface;
+    }
+
+    // Pixels are moved as 32 bits words
+    SurfacePtr source = surface;
+    if (source->format->BytesPerPixel != 4 || SDL_ISPIXELFORMAT_INDEXED(source->format->format)) {
+        source = SDLit::make_unique(SDL_ConvertSurfaceFormat, source.get(), SDL_PIXELFORMAT_ARGB8888, 0);
+        if (not source) {
+            return {nullptr};
+        }
+    }
+
+    int const width = source->w;
+    int const height = source->h;
+    bool const transposed = quarter_turns % 2 == 1;
+    int const output_width = transposed ? height : width;
+    int const output_height = transposed ? width : height;
+    auto output = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, output_width, output_height, 32,
+                                     source->format->format);
+    if (not output) {
+        return {nullptr};
+    }
+
+    // Output pixel (x, y) comes from (x0 + x * x_step.x + y * y_step.x, y0 + x * x_step.y + y * y_step.y) in the
+    // flipped image, the rotation is worked out first and the flip mirrors it back into the source
+    SDL_Point origin{};
+    SDL_Point x_step{};
+    SDL_Point y_step{};
+    switch (quarter_turns) {
+        case 1: {
+            origin = SDL_Point{0, height - 1};
+            x_step = SDL_Point{0, -1};
+            y_step = SDL_Point{1, 0};
+            break;
+        }
+        case 2: {
+            origin = SDL_Point{width - 1, height - 1};
+            x_step = SDL_Point{-1, 0};
+            y_step = SDL_Point{0, -1};
+            break;
+        }
+        case 3: {
+            origin = SDL_Point{width - 1, 0};
+            x_step = SDL_Point{0, 1};
+            y_step = SDL_Point{-1, 0};
+            break;
+        }
+        default: {
+            x_step = SDL_Point{1, 0};
+            y_step = SDL_Point{0, 1};
+            break;
+        }
+    }
+    if (flip & SDL_FLIP_HORIZONTAL) {
+        origin.x = width - 1 - origin.x;
+        x_step.x = -x_step.x;
+        y_step.x = -y_step.x;
+    }
+    if (flip & SDL_FLIP_VERTICAL) {
+        origin.y = height - 1 - origin.y;
+        x_step.y = -x_step.y;
+        y_step.y = -y_step.y;
+    }
+
+    std::ptrdiff_t const pitch = source->pitch;
+    std::ptrdiff_t const origin_offset = origin.y * pitch + origin.x * 4;
+    std::ptrdiff_t const x_stride = x_step.y * pitch + x_step.x * 4;
+    std::ptrdiff_t const y_stride = y_step.y * pitch + y_step.x * 4;
+    auto const* source_pixels = static_cast<std::uint8_t const*>(source->pixels);
+    auto* output_pixels = static_cast<std::uint8_t*>(output->pixels);
+
+    // Flips keep the rows of the source together and are copied a whole row at a time
+    int const block_width = transposed ? kBlockSize : output_width;
+    int const block_height = transposed ? kBlockSize : output_height;
+    for (int block_y = 0; block_y < output_height; block_y += block_height) {
+        int const block_bottom = std::min(block_y + block_height, output_height);
+        for (int block_x = 0; block_x < output_width; block_x += block_width) {
+            int const block_right = std::min(block_x + block_width, output_width);
+            for (int y = block_y; y < block_bottom; ++y) {
+                std::uint8_t const* input = source_pixels + origin_offset + y * y_stride + block_x * x_stride;
+                std::uint8_t* row = output_pixels + y * output->pitch;
+                if (x_stride == 4) {
+                    std::memcpy(row + block_x * 4, input, static_cast<std::size_t>(block_right - block_x) * 4U);
+                    continue;
+                }
+                for (int x = block_x; x < block_right; ++x, input += x_stride) {
+                    std::memcpy(row + x * 4, input, 4U);
+                }
+            }
+        }
+    }
+    return output;
+}
@@ -1,10 +1,21 @@
 #include "image_viewer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
+#include "animation_decoder.hpp"
+#include "image_cache.hpp"
 #include "native_window.h"
+#include "overlay_text.hpp"
 #include "portable-file-dialogs.h"
+#include "texture_budget.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
 
 std::vector<std::filesystem::path> pickImageDialog() {
     auto const user_selection =
@@ -82,16 +93,39 @@ SDL_FRect resizeToFit(SDL_Rect const& src, SDL_Rect const& dst) {
     return inner_rect;
 }
 
-std::unique_ptr<ImageViewer> ImageViewer::open(std::filesystem::path const image_path) noexcept {
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Loading %s", image_path.c_str());
-    auto image_surface = SDLit::make_unique(IMG_Load, image_path.c_str());
-    if (not image_surface) {
-        return {nullptr};
-    }
+namespace {
+
+/// Textures of previously shown images kept by each viewer, so going back and forth does not upload them again
+constexpr std::size_t kRecentTextures = 4U;
+
+/// Differences start amplified, those of a lossy encode would be too dark to see otherwise
+constexpr int kDifferenceGain = 8;
+constexpr int kMaxDifferenceGain = 128;
+constexpr int kMaxDifferenceThreshold = 128;
 
-    auto image_window = SDLit::make_unique(SDL_CreateWindow, image_path.filename().c_str(), SDL_WINDOWPOS_UNDEFINED,
-                                           SDL_WINDOWPOS_UNDEFINED, image_surface->w, image_surface->h,
-                                           SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+/// Tab bar of tabbed windows, in window points, overlays draw their text with squares of kFontScale points
+constexpr float kTabBarHeight = 8.0f;
+constexpr float kFontScale = 2.0f;
+constexpr float kOverlayMargin = 8.0f;
+constexpr float kOverlayPadding = 6.0f;
+
+/// The frame stats overlay shows the stats of the last period, long enough for the percentiles to settle
+constexpr std::chrono::seconds kFrameStatsPeriod{1};
+
+/// Create a customized window with its renderer, both sized for an image of width x height
+bool createWindow(std::filesystem::path const& image_path, int const width, int const height,
+                  std::unique_ptr<SDL_Window, SDLit::SDL_Deleter>& image_window,
+                  SDL_SysWMinfo& image_window_manager_info,
+                  std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter>& image_renderer) noexcept {
+    {
+        TRACE_SCOPE("create window", image_path.c_str());
+        image_window = SDLit::make_unique(SDL_CreateWindow, image_path.filename().c_str(), SDL_WINDOWPOS_UNDEFINED,
+                                          SDL_WINDOWPOS_UNDEFINED, width, height,
+                                          SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+    }
+    if (not image_window) {
+        return false;
+    }
 
 #if 0  // Prevents double click
     SDL_SetWindowHitTest(image_window.get(),
@@ -100,60 +134,264 @@ std::unique_ptr<ImageViewer> ImageViewer::open(std::filesystem::path const image
         }, nullptr);
 #endif
 
-    SDL_SysWMinfo image_window_manager_info{};
-    if (not SDL_GetWindowWMInfo(image_window.get(), &image_window_manager_info)) {
+    // Video drivers without native windows (e.g. dummy) have no info, the window is just left uncustomized
+    bool has_window_manager_info{};
+    {
+        TRACE_SCOPE("get window manager info", image_path.c_str());
+        has_window_manager_info = SDL_GetWindowWMInfo(image_window.get(), &image_window_manager_info);
+    }
+    if (has_window_manager_info) {
+        TRACE_SCOPE("customize title bar", image_path.c_str());
+        NativeWindow_customizeTitleBar(&image_window_manager_info);
+    } else {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "No window manager info: %s", SDL_GetError());
+    }
+
+    TRACE_SCOPE("create renderer", image_path.c_str());
+    image_renderer = SDLit::make_unique(SDL_CreateRenderer, image_window.get(), -1,
+                                        SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    return static_cast<bool>(image_renderer);
+}
+
+}  // namespace
+
+std::unique_ptr<ImageViewer> ImageViewer::open(std::filesystem::path const image_path) noexcept {
+    auto image_surface = loadImage(image_path);
+    if (not image_surface) {
         return {nullptr};
     }
+    return open(std::move(image_path), std::move(image_surface));
+}
 
-    NativeWindow_customizeTitleBar(&image_window_manager_info);
+std::unique_ptr<ImageViewer> ImageViewer::open(std::filesystem::path const image_path,
+                                               SurfacePtr image_surface) noexcept {
+    if (not image_surface) {
+        SDL_SetError("no image surface to display");
+        return {nullptr};
+    }
 
-    auto image_renderer = SDLit::make_unique(SDL_CreateRenderer, image_window.get(), -1,
-                                             SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    if (not image_renderer) {
+    TRACE_SCOPE("open viewer", image_path.c_str());
+    std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> image_window{};
+    SDL_SysWMinfo image_window_manager_info{};
+    std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> image_renderer{};
+    // Reduced decodes are shown at the size of the image they come from
+    SDL_Point const image_size = imageSize(image_surface);
+    if (not createWindow(image_path, image_size.x, image_size.y, image_window, image_window_manager_info,
+                         image_renderer)) {
         return {nullptr};
     }
 
-    auto image_texture = SDLit::make_unique(SDL_CreateTextureFromSurface, image_renderer.get(), image_surface.get());
+    SDL_Rect const image_rect{0, 0, image_size.x, image_size.y};
+    std::unique_ptr<TiledTexture> image_texture{};
+    {
+        TRACE_SCOPE("upload texture", image_path.c_str());
+        image_texture = TiledTexture::create(image_renderer.get(), std::move(image_surface));
+    }
     if (not image_texture) {
         return {nullptr};
     }
 
     auto image_viewer = std::unique_ptr<ImageViewer>{
-        new ImageViewer{std::move(image_path), std::move(image_window_manager_info), std::move(image_window),
-                        std::move(image_renderer), std::move(image_texture)}};
+        new ImageViewer{std::move(image_path), image_rect, std::move(image_window_manager_info),
+                        std::move(image_window), std::move(image_renderer), std::move(image_texture)}};
 
     image_viewer->resize();
     image_viewer->center();
-    image_viewer->repaint();
+    {
+        TRACE_SCOPE("first repaint", image_path.c_str());
+        image_viewer->repaint();
+    }
     image_viewer->focus();
+    image_viewer->startAnimation();
 
     // Force window to appear immediately by pumping sdl events
-    SDL_PumpEvents();
+    {
+        TRACE_SCOPE("pump events", image_path.c_str());
+        SDL_PumpEvents();
+    }
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Displaying %s", image_path.c_str());
 
     return image_viewer;
 }
 
-ImageViewer::ImageViewer(std::filesystem::path image_path, SDL_SysWMinfo window_info,
+std::unique_ptr<ImageViewer> ImageViewer::openAsync(std::filesystem::path const image_path) noexcept {
+    // Without a recognizable header, start with a modest window and resize it once the image is decoded
+    SDL_Point const image_size = probeImageSize(image_path).value_or(SDL_Point{640, 480});
+    if (image_size.x <= 0 || image_size.y <= 0) {
+        SDL_SetError("invalid image dimensions %dx%d", image_size.x, image_size.y);
+        return {nullptr};
+    }
+
+    std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> image_window{};
+    SDL_SysWMinfo image_window_manager_info{};
+    std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> image_renderer{};
+    if (not createWindow(image_path, image_size.x, image_size.y, image_window, image_window_manager_info,
+                         image_renderer)) {
+        return {nullptr};
+    }
+
+    SDL_Rect const image_rect{0, 0, image_size.x, image_size.y};
+    auto image_viewer = std::unique_ptr<ImageViewer>{new ImageViewer{
+        image_path, image_rect, std::move(image_window_manager_info), std::move(image_window),
+        std::move(image_renderer), std::unique_ptr<TiledTexture>{}}};
+
+    image_viewer->resize();
+    image_viewer->center();
+    image_viewer->repaint();
+    image_viewer->focus();
+
+    image_viewer->loadAsync(true, false);
+
+    SDL_PumpEvents();
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Displaying placeholder for %s", image_path.c_str());
+
+    return image_viewer;
+}
+
+void ImageViewer::loadAsync(bool fit_window, bool full_resolution) noexcept {
+    if (m_pending_load) {
+        m_pending_load->cancelled = true;
+    }
+
+    auto pending_load = std::make_shared<PendingLoad>();
+    pending_load->fit_window = fit_window;
+    m_pending_load = pending_load;
+
+    // The worker only holds the pending load, the viewer may be closed before the decode completes
+    std::uint32_t const window_id = SDL_GetWindowID(m_window.get());
+    std::uint32_t const event_type = loadedEventType();
+
+    // With nothing on screen, large images are shown as they decode, an event is pushed once the last preview is taken
+    PreviewCallback preview{};
+    if (not m_texture) {
+        m_load_started_at = std::chrono::steady_clock::now();
+        preview = [pending_load, window_id, event_type](SurfacePtr preview_surface) {
+            bool notify{};
+            {
+                std::lock_guard lock{pending_load->mutex};
+                notify = not pending_load->preview;
+                pending_load->preview = std::move(preview_surface);
+            }
+            if (notify && not pending_load->cancelled) {
+                SDL_Event event{};
+                event.type = event_type;
+                event.user.windowID = window_id;
+                SDL_PushEvent(&event);
+            }
+        };
+    }
+
+    WorkerPool::shared().submit([image_path = m_image_path, pending_load, window_id, event_type, full_resolution,
+                                 preview = std::move(preview)] {
+        auto const load_start = std::chrono::steady_clock::now();
+        SurfacePtr image_surface = loadImage(image_path, &pending_load->cancelled, full_resolution, preview);
+        if (pending_load->cancelled) {
+            return;
+        }
+        FrameStats::count(FrameStats::kLoads);
+        FrameStats::time(FrameStats::kLoadTime, std::chrono::steady_clock::now() - load_start);
+        ImageCache::shared().insert(image_path, image_surface);
+
+        {
+            std::lock_guard lock{pending_load->mutex};
+            pending_load->completed = true;
+            pending_load->error = image_surface ? std::string{} : std::string{SDL_GetError()};
+            pending_load->surface = std::move(image_surface);
+        }
+
+        SDL_Event event{};
+        event.type = event_type;
+        event.user.windowID = window_id;
+        SDL_PushEvent(&event);
+    });
+}
+
+std::uint32_t ImageViewer::loadedEventType() noexcept {
+    static std::uint32_t const loaded_event_type{SDL_RegisterEvents(1)};
+    return loaded_event_type;
+}
+
+std::uint32_t ImageViewer::differenceEventType() noexcept {
+    static std::uint32_t const difference_event_type{SDL_RegisterEvents(1)};
+    return difference_event_type;
+}
+
+ImageViewer::ImageViewer(std::filesystem::path image_path, SDL_Rect image_rect, SDL_SysWMinfo window_info,
                          std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> window,
                          std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> renderer,
-                         std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> texture) noexcept
+                         std::unique_ptr<TiledTexture> texture) noexcept
     : m_image_path{std::move(image_path)},
+      m_image_rect{image_rect},
       m_window_info{std::move(window_info)},
       m_window{std::move(window)},
       m_renderer{std::move(renderer)},
-      m_texture{std::move(texture)} {}
+      m_texture{std::move(texture)},
+      m_view_center{static_cast<float>(image_rect.w) / 2.0f, static_cast<float>(image_rect.h) / 2.0f} {
+    TextureBudget::shared().add(this);
+}
 
-ImageViewer::~ImageViewer() noexcept {}
+ImageViewer::~ImageViewer() noexcept {
+    TextureBudget::shared().remove(this);
+    ImageCache::shared().cancelPrefetch(SDL_GetWindowID(m_window.get()));
+    if (m_pending_load) {
+        m_pending_load->cancelled = true;
+    }
+    if (m_pending_difference) {
+        m_pending_difference->cancelled = true;
+    }
+    if (m_compare_group) {
+        m_compare_group->remove(this);
+    }
+}
 
 SDL_Window* ImageViewer::window() const noexcept { return m_window.get(); }
 
+std::filesystem::path const& ImageViewer::imagePath() const noexcept { return m_image_path; }
+
 SDL_Renderer* ImageViewer::renderer() const noexcept { return m_renderer.get(); }
 
-SDL_Texture* ImageViewer::texture() const noexcept { return m_texture.get(); }
+TiledTexture* ImageViewer::texture() const noexcept { return m_texture.get(); }
 
 SDL_SysWMinfo* ImageViewer::windowManagerInfo() noexcept { return &m_window_info; }
 
+bool ImageViewer::hidden() const noexcept {
+    return (SDL_GetWindowFlags(m_window.get()) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED)) != 0U;
+}
+
+std::size_t ImageViewer::textureBytes() const noexcept {
+    std::size_t texture_bytes = m_texture ? m_texture->residentBytes() : 0U;
+    if (m_difference_texture) {
+        texture_bytes += m_difference_texture->residentBytes();
+    }
+    for (auto const& recent_texture : m_recent_textures) {
+        texture_bytes += recent_texture.second->residentBytes();
+    }
+    return texture_bytes;
+}
+
+std::size_t ImageViewer::releaseTextures() noexcept {
+    std::size_t const previous_bytes = textureBytes();
+    std::size_t const previous_texture_bytes = m_texture ? m_texture->residentBytes() : 0U;
+    m_recent_textures.clear();
+
+    // The difference is computed again once the textures are restored
+    m_difference_texture.reset();
+
+    // The animation would write full size frames into the texture, it starts over once the texture is restored
+    if (m_texture && m_texture->releaseDetail()) {
+        m_released_bytes += previous_texture_bytes - m_texture->residentBytes();
+        m_animation.reset();
+    }
+
+    std::size_t const released_bytes = previous_bytes - textureBytes();
+    m_texture_released = m_texture_released || released_bytes > 0U;
+    return released_bytes;
+}
+
+bool ImageViewer::texturesReleased() const noexcept { return m_texture_released; }
+
+std::size_t ImageViewer::releasedBytes() const noexcept { return m_released_bytes; }
+
 bool ImageViewer::center() noexcept {
     SDL_SetWindowPosition(m_window.get(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_CENTERED);
     return true;
@@ -175,10 +413,7 @@ bool ImageViewer::maximize() noexcept {
 }
 
 bool ImageViewer::resize() noexcept {
-    SDL_Rect image_rect{};
-    if (SDL_QueryTexture(m_texture.get(), nullptr, nullptr, &image_rect.w, &image_rect.h)) {
-        return false;
-    }
+    SDL_Rect const image_rect = m_image_rect;
 
     SDL_SetError("");
     int const display_index = SDL_GetWindowDisplayIndex(m_window.get());
@@ -218,15 +453,23 @@ bool ImageViewer::resize() noexcept {
 }
 
 bool ImageViewer::repaint() noexcept {
-    SDL_Rect window_rect{};
-    SDL_GetWindowSizeInPixels(m_window.get(), &window_rect.w, &window_rect.h);
+    auto const repaint_start = std::chrono::steady_clock::now();
+    m_dirty = false;
+    Viewport const image_viewport = viewport();
 
-    SDL_Rect image_rect{};
-    if (SDL_QueryTexture(m_texture.get(), nullptr, nullptr, &image_rect.w, &image_rect.h)) {
-        return false;
+    if (m_difference_options && not m_texture_released && not m_difference_texture && not m_pending_difference &&
+        not hidden()) {
+        updateDifference();
     }
 
-    SDL_FRect viewport_frect = resizeToFit(image_rect, window_rect);
+    // A reduced decode is enough until the image is shown larger than it, then the full resolution is decoded, once
+    // per image since a full decode cannot get any sharper when zoomed past 1:1
+    if (m_texture && not m_texture_released && not m_pending_load && not m_full_resolution_requested &&
+        m_texture->resolution() < 1.0f && image_viewport.scale > m_texture->resolution()) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Loading full resolution of %s", m_image_path.c_str());
+        m_full_resolution_requested = true;
+        loadAsync(false, true);
+    }
 
     if (SDL_SetRenderDrawColor(m_renderer.get(), 0xC0, 0xC0, 0xC0, 0xFF)) {
         return false;
@@ -236,21 +479,233 @@ bool ImageViewer::repaint() noexcept {
         return false;
     }
 
-    if (SDL_RenderCopyExF(m_renderer.get(), m_texture.get(), nullptr, &viewport_frect, 0, nullptr, m_flip)) {
+    if (not m_texture) {
+        // Placeholder while the image is still being decoded
+        if (SDL_SetRenderDrawColor(m_renderer.get(), 0xA0, 0xA0, 0xA0, 0xFF)) {
+            return false;
+        }
+
+        if (SDL_RenderFillRectF(m_renderer.get(), &image_viewport.dst)) {
+            return false;
+        }
+    } else {
+        // Only the visible region is handed to the renderer, flipping mirrors it back into image coordinates
+        SDL_FRect image_frect = image_viewport.view;
+        if (m_flip & SDL_FLIP_HORIZONTAL) {
+            image_frect.x = static_cast<float>(m_image_rect.w) - image_frect.x - image_frect.w;
+        }
+        if (m_flip & SDL_FLIP_VERTICAL) {
+            image_frect.y = static_cast<float>(m_image_rect.h) - image_frect.y - image_frect.h;
+        }
+
+        // The difference has the size of the image, so it is drawn in its place with the same view
+        TiledTexture* image_texture = m_difference_texture ? m_difference_texture.get() : m_texture.get();
+        auto const render_start = std::chrono::steady_clock::now();
+        if (not image_texture->render(image_frect, image_viewport.dst, m_flip)) {
+            return false;
+        }
+        m_frame_stats.render.add(std::chrono::steady_clock::now() - render_start);
+
+        if (m_inspector) {
+            int const left = static_cast<int>(std::floor(image_frect.x));
+            int const top = static_cast<int>(std::floor(image_frect.y));
+            m_inspector->setVisibleRegion({left, top, static_cast<int>(std::ceil(image_frect.x + image_frect.w)) - left,
+                                           static_cast<int>(std::ceil(image_frect.y + image_frect.h)) - top});
+        }
+    }
+
+    if (m_inspector && not m_inspector->render(m_renderer.get(), pixelDensity())) {
+        return false;
+    }
+
+    if (m_difference_options && not renderDifferenceStats()) {
+        return false;
+    }
+
+    if (not renderTabBar()) {
+        return false;
+    }
+
+    if (m_frame_stats_overlay && not renderFrameStats()) {
         return false;
     }
 
+    auto const present_start = std::chrono::steady_clock::now();
     SDL_RenderPresent(m_renderer.get());
+    m_last_present = std::chrono::steady_clock::now();
+    m_frame_stats.present.add(m_last_present - present_start);
+    m_frame_stats.repaint.add(m_last_present - repaint_start);
+    ++m_frame_stats.repaints;
+
+    // Index the directory as soon as the window shows something, so it is ready by the time the user navigates
+    if (m_texture) {
+        directoryIndex();
+    }
+
+    if (m_load_started_at && m_texture) {
+        Trace::record("first pixels", m_image_path.c_str(), *m_load_started_at, m_last_present);
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "First pixels of %s presented %.1f ms after its load started",
+                    m_image_path.c_str(),
+                    std::chrono::duration<double, std::milli>(m_last_present - *m_load_started_at).count());
+        m_load_started_at.reset();
+    }
+
+    if (m_reload_changed_at && m_texture) {
+        Trace::record("reload", m_image_path.c_str(), *m_reload_changed_at, m_last_present);
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Reloaded %s, presented %.1f ms after it changed",
+                    m_image_path.c_str(),
+                    std::chrono::duration<double, std::milli>(m_last_present - *m_reload_changed_at).count());
+        m_reload_changed_at.reset();
+    }
     return true;
 }
 
+void ImageViewer::invalidate() noexcept { m_dirty = true; }
+
+bool ImageViewer::update() noexcept {
+    auto const now = std::chrono::steady_clock::now();
+    if (m_animation) {
+        if (auto frame_surface = m_animation->takeFrame(now)) {
+            showFrame(std::move(frame_surface));
+        }
+    }
+    if (m_inspector && m_inspector->update()) {
+        invalidate();
+    }
+    if (m_pending_difference && takeDifference()) {
+        invalidate();
+    }
+
+    // The overlay moves on to the next period, what was counted since the last one is what it shows
+    if (m_frame_stats_overlay && now >= m_frame_stats_overlay->period_start + kFrameStatsPeriod) {
+        auto& overlay = *m_frame_stats_overlay;
+        FrameStats::Totals totals = FrameStats::totals();
+        overlay.window_period = m_frame_stats;
+        overlay.window_period -= overlay.window_baseline;
+        overlay.totals_period = totals;
+        overlay.totals_period -= overlay.totals_baseline;
+        overlay.period = now - overlay.period_start;
+        overlay.window_baseline = m_frame_stats;
+        overlay.totals_baseline = std::move(totals);
+        overlay.period_start = now;
+        invalidate();
+    }
+
+    if (not m_dirty || m_last_present + refreshInterval() > now) {
+        return false;
+    }
+    return repaint();
+}
+
+std::optional<std::chrono::steady_clock::time_point> ImageViewer::nextUpdateTime() const noexcept {
+    std::optional<std::chrono::steady_clock::time_point> next_update_time{};
+    if (m_dirty) {
+        next_update_time = m_last_present + refreshInterval();
+    }
+
+    // The next animation frame is taken by update() as well
+    if (auto const next_frame_time = m_animation ? m_animation->nextFrameTime() : std::nullopt) {
+        if (not next_update_time || *next_frame_time < *next_update_time) {
+            next_update_time = next_frame_time;
+        }
+    }
+
+    // So is the end of the period of the frame stats overlay
+    if (m_frame_stats_overlay) {
+        auto const period_end = m_frame_stats_overlay->period_start + kFrameStatsPeriod;
+        if (not next_update_time || period_end < *next_update_time) {
+            next_update_time = period_end;
+        }
+    }
+    return next_update_time;
+}
+
+std::chrono::steady_clock::duration ImageViewer::refreshInterval() const noexcept {
+    SDL_DisplayMode display_mode{};
+    int const refresh_rate =
+        (SDL_GetWindowDisplayMode(m_window.get(), &display_mode) == 0 && display_mode.refresh_rate > 0)
+            ? display_mode.refresh_rate
+            : 60;
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds{1}) / refresh_rate;
+}
+
+ImageViewer::Viewport ImageViewer::viewport() const noexcept {
+    SDL_Rect window_rect{};
+    SDL_GetWindowSizeInPixels(m_window.get(), &window_rect.w, &window_rect.h);
+
+    SDL_FRect const fit_frect = resizeToFit(m_image_rect, window_rect);
+    if (m_zoom <= 1.0f || m_image_rect.w <= 0 || m_image_rect.h <= 0) {
+        return {{0.0f, 0.0f, static_cast<float>(m_image_rect.w), static_cast<float>(m_image_rect.h)},
+                fit_frect,
+                fit_frect.w / static_cast<float>(m_image_rect.w)};
+    }
+
+    Viewport zoomed_viewport{};
+    zoomed_viewport.scale = m_zoom * fit_frect.w / static_cast<float>(m_image_rect.w);
+
+    // Per axis, either the image overflows the window and the view follows the center, or it is centered
+    auto const fit_axis = [scale = zoomed_viewport.scale](float window_extent, float image_extent, float center,
+                                                          float& view_origin, float& view_extent, float& dst_origin,
+                                                          float& dst_extent) {
+        float const visible_extent = window_extent / scale;
+        if (visible_extent >= image_extent) {
+            view_origin = 0.0f;
+            view_extent = image_extent;
+            dst_origin = (window_extent - image_extent * scale) / 2.0f;
+        } else {
+            view_origin = std::clamp(center - visible_extent / 2.0f, 0.0f, image_extent - visible_extent);
+            view_extent = visible_extent;
+            dst_origin = 0.0f;
+        }
+        dst_extent = view_extent * scale;
+    };
+
+    fit_axis(static_cast<float>(window_rect.w), static_cast<float>(m_image_rect.w), m_view_center.x,
+             zoomed_viewport.view.x, zoomed_viewport.view.w, zoomed_viewport.dst.x, zoomed_viewport.dst.w);
+    fit_axis(static_cast<float>(window_rect.h), static_cast<float>(m_image_rect.h), m_view_center.y,
+             zoomed_viewport.view.y, zoomed_viewport.view.h, zoomed_viewport.dst.y, zoomed_viewport.dst.h);
+    return zoomed_viewport;
+}
+
+std::optional<SDL_Point> ImageViewer::imagePointAt(int x, int y) const noexcept {
+    Viewport const image_viewport = viewport();
+    float const density = pixelDensity();
+    SDL_FPoint const point{static_cast<float>(x) * density, static_cast<float>(y) * density};
+    SDL_FRect const& dst = image_viewport.dst;
+    if (image_viewport.scale <= 0.0f || point.x < dst.x || point.y < dst.y || point.x >= dst.x + dst.w ||
+        point.y >= dst.y + dst.h) {
+        return std::nullopt;
+    }
+
+    // View coordinates are mirrored back into image coordinates
+    float image_x = image_viewport.view.x + (point.x - dst.x) / image_viewport.scale;
+    float image_y = image_viewport.view.y + (point.y - dst.y) / image_viewport.scale;
+    if (m_flip & SDL_FLIP_HORIZONTAL) {
+        image_x = static_cast<float>(m_image_rect.w) - image_x;
+    }
+    if (m_flip & SDL_FLIP_VERTICAL) {
+        image_y = static_cast<float>(m_image_rect.h) - image_y;
+    }
+    return SDL_Point{std::clamp(static_cast<int>(std::floor(image_x)), 0, m_image_rect.w - 1),
+                     std::clamp(static_cast<int>(std::floor(image_y)), 0, m_image_rect.h - 1)};
+}
+
+float ImageViewer::pixelDensity() const noexcept {
+    int window_width{};
+    int window_width_in_pixels{};
+    SDL_GetWindowSize(m_window.get(), &window_width, nullptr);
+    SDL_GetWindowSizeInPixels(m_window.get(), &window_width_in_pixels, nullptr);
+    return window_width > 0 ? static_cast<float>(window_width_in_pixels) / static_cast<float>(window_width) : 1.0f;
+}
+
 void ImageViewer::flipHorizontal() noexcept {
     if (m_flip & SDL_FLIP_HORIZONTAL) {
         m_flip = static_cast<SDL_RendererFlip>(m_flip & ~SDL_FLIP_HORIZONTAL);
     } else {
         m_flip = static_cast<SDL_RendererFlip>(m_flip | SDL_FLIP_HORIZONTAL);
     }
-    repaint();
+    invalidate();
+    syncView();
 }
 
 void ImageViewer::flipVertical() noexcept {
@@ -259,15 +714,869 @@ void ImageViewer::flipVertical() noexcept {
     } else {
         m_flip = static_cast<SDL_RendererFlip>(m_flip | SDL_FLIP_VERTICAL);
     }
-    repaint();
+    invalidate();
+    syncView();
+}
+
+void ImageViewer::toggleInspector() noexcept {
+    if (m_inspector) {
+        m_inspector.reset();
+    } else {
+        m_inspector = std::make_unique<ImageInspector>(SDL_GetWindowID(m_window.get()));
+        inspect(nullptr);
+    }
+    invalidate();
+}
+
+void ImageViewer::toggleFrameStats() noexcept {
+    if (m_frame_stats_overlay) {
+        m_frame_stats_overlay.reset();
+    } else {
+        m_frame_stats_overlay = std::make_unique<FrameStatsOverlay>();
+        m_frame_stats_overlay->period_start = std::chrono::steady_clock::now();
+        m_frame_stats_overlay->window_baseline = m_frame_stats;
+        m_frame_stats_overlay->totals_baseline = FrameStats::totals();
+    }
+    invalidate();
+}
+
+WindowFrameStats const& ImageViewer::frameStats() const noexcept { return m_frame_stats; }
+
+ImageViewer::ViewState ImageViewer::viewState() const noexcept {
+    if (m_image_rect.w <= 0 || m_image_rect.h <= 0) {
+        return {m_flip, m_zoom};
+    }
+    return {m_flip,
+            m_zoom,
+            {m_view_center.x / static_cast<float>(m_image_rect.w),
+             m_view_center.y / static_cast<float>(m_image_rect.h)}};
+}
+
+void ImageViewer::setViewState(ViewState const& view_state) noexcept {
+    m_flip = view_state.flip;
+    m_zoom = view_state.zoom;
+    m_view_center = {view_state.center.x * static_cast<float>(m_image_rect.w),
+                     view_state.center.y * static_cast<float>(m_image_rect.h)};
+    invalidate();
+}
+
+void ImageViewer::link(std::shared_ptr<CompareGroup> compare_group) noexcept {
+    if (m_compare_group) {
+        m_compare_group->remove(this);
+    }
+
+    m_compare_group = std::move(compare_group);
+    if (m_compare_group) {
+        m_compare_group->add(this);
+    }
+    updateDifference();
+}
+
+std::shared_ptr<CompareGroup> const& ImageViewer::compareGroup() const noexcept { return m_compare_group; }
+
+void ImageViewer::syncView() noexcept {
+    if (m_compare_group) {
+        m_compare_group->followView(this);
+    }
+}
+
+void ImageViewer::toggleDifference() noexcept {
+    if (m_difference_options) {
+        if (m_pending_difference) {
+            m_pending_difference->cancelled = true;
+            m_pending_difference.reset();
+        }
+        m_difference_options.reset();
+        m_difference_texture.reset();
+        m_difference_stats.reset();
+    } else {
+        m_difference_options = DifferenceOptions{0, kDifferenceGain};
+        updateDifference();
+    }
+    invalidate();
+}
+
+void ImageViewer::changeDifferenceOptions(DifferenceOptions difference_options) noexcept {
+    if (not m_difference_options || (difference_options.threshold == m_difference_options->threshold &&
+                                      difference_options.gain == m_difference_options->gain)) {
+        return;
+    }
+    m_difference_options = difference_options;
+    updateDifference();
+}
+
+void ImageViewer::updateDifference() noexcept {
+    if (not m_difference_options) {
+        return;
+    }
+
+    if (m_pending_difference) {
+        m_pending_difference->cancelled = true;
+        m_pending_difference.reset();
+    }
+
+    ImageViewer const* reference = m_compare_group ? m_compare_group->reference(this) : nullptr;
+    if (reference == nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "No image to compare %s with, the windows are not linked",
+                    m_image_path.c_str());
+        toggleDifference();
+        return;
+    }
+
+    auto pending_difference = std::make_shared<PendingDifference>();
+    m_pending_difference = pending_difference;
+    invalidate();
+
+    // Both images are compared in full, the cached surfaces are only reused when they are not reduced decodes
+    std::uint32_t const window_id = SDL_GetWindowID(m_window.get());
+    std::uint32_t const event_type = differenceEventType();
+    WorkerPool::shared().submit([image_path = m_image_path, reference_path = reference->imagePath(),
+                                 difference_options = *m_difference_options, pending_difference, window_id,
+                                 event_type] {
+        auto const complete = [pending_difference, window_id, event_type](
+                                  SurfacePtr difference_surface, DifferenceStats const& stats,
+                                  std::string const& error) {
+            {
+                std::lock_guard lock{pending_difference->mutex};
+                pending_difference->completed = true;
+                pending_difference->surface = std::move(difference_surface);
+                pending_difference->stats = stats;
+                pending_difference->error = error;
+            }
+
+            SDL_Event event{};
+            event.type = event_type;
+            event.user.windowID = window_id;
+            SDL_PushEvent(&event);
+        };
+
+        auto const load = [&pending_difference](std::filesystem::path const& path) {
+            SurfacePtr surface = ImageCache::shared().find(path);
+            if (surface && imageSize(surface).x == surface->w) {
+                return surface;
+            }
+            return loadImage(path, &pending_difference->cancelled, true);
+        };
+
+        SurfacePtr image_surface = load(image_path);
+        SurfacePtr reference_surface = image_surface ? load(reference_path) : SurfacePtr{};
+        if (pending_difference->cancelled) {
+            return;
+        }
+        if (not reference_surface) {
+            complete(nullptr, {}, SDL_GetError());
+            return;
+        }
+
+        // The pending difference owns the flag, the workers only see it through the aliasing pointer
+        std::shared_ptr<std::atomic_bool const> cancelled{pending_difference, &pending_difference->cancelled};
+        computeDifferenceAsync(std::move(image_surface), std::move(reference_surface), difference_options,
+                               std::move(cancelled), complete);
+    });
+}
+
+bool ImageViewer::takeDifference() noexcept {
+    SurfacePtr difference_surface{};
+    DifferenceStats stats{};
+    std::string error{};
+    {
+        std::lock_guard lock{m_pending_difference->mutex};
+        if (not m_pending_difference->completed) {
+            return false;
+        }
+        difference_surface = std::move(m_pending_difference->surface);
+        stats = m_pending_difference->stats;
+        error = std::move(m_pending_difference->error);
+    }
+    m_pending_difference.reset();
+
+    bool const computed = static_cast<bool>(difference_surface);
+    auto difference_texture =
+        computed ? TiledTexture::create(m_renderer.get(), std::move(difference_surface)) : nullptr;
+    if (not difference_texture) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to compare %s: %s", m_image_path.c_str(),
+                    computed ? SDL_GetError() : error.c_str());
+        toggleDifference();
+        return true;
+    }
+
+    m_difference_texture = std::move(difference_texture);
+    m_difference_stats = stats;
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Compared %s: max error %d, PSNR %.2f dB, %llu of %llu pixels differ",
+                m_image_path.c_str(), stats.max_error, stats.psnr,
+                static_cast<unsigned long long>(stats.differing_pixels),
+                static_cast<unsigned long long>(stats.pixel_count));
+    return true;
+}
+
+bool ImageViewer::renderDifferenceStats() const noexcept {
+    int output_width{};
+    int output_height{};
+    if (SDL_GetRendererOutputSize(m_renderer.get(), &output_width, &output_height)) {
+        return false;
+    }
+
+    char stats_text[96]{"COMPARING..."};
+    if (m_difference_stats && not m_pending_difference) {
+        double const differing_percent =
+            m_difference_stats->pixel_count > 0U ? 100.0 * static_cast<double>(m_difference_stats->differing_pixels) /
+                                                       static_cast<double>(m_difference_stats->pixel_count)
+                                                 : 0.0;
+        if (std::isinf(m_difference_stats->psnr)) {
+            std::snprintf(stats_text, sizeof(stats_text), "IDENTICAL");
+        } else {
+            std::snprintf(stats_text, sizeof(stats_text), "MAX %d  PSNR %.2f DB  DIFFERENT %.2f%%",
+                          m_difference_stats->max_error, m_difference_stats->psnr, differing_percent);
+        }
+    }
+    char options_text[64]{};
+    std::snprintf(options_text, sizeof(options_text), "THRESHOLD %d  GAIN %dX", m_difference_options->threshold,
+                  m_difference_options->gain);
+
+    // Same look as the inspector overlay, in the opposite corner so both can be shown
+    float const density = pixelDensity();
+    float const pixel_size = kFontScale * density;
+    float const margin = kOverlayMargin * density;
+    float const padding = kOverlayPadding * density;
+    SDL_FPoint const stats_size = textSize(stats_text, pixel_size);
+    SDL_FPoint const options_size = textSize(options_text, pixel_size);
+    float const panel_width = std::max(stats_size.x, options_size.x) + 2.0f * padding;
+    float const panel_height = stats_size.y + options_size.y + 3.0f * padding;
+    SDL_FRect const panel{static_cast<float>(output_width) - margin - panel_width,
+                          static_cast<float>(output_height) - margin - panel_height, panel_width, panel_height};
+
+    SDL_Renderer* renderer = m_renderer.get();
+    if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) ||
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xB0) || SDL_RenderFillRectF(renderer, &panel)) {
+        return false;
+    }
+    if (SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF) ||
+        not renderText(renderer, stats_text, {panel.x + padding, panel.y + padding}, pixel_size) ||
+        not renderText(renderer, options_text, {panel.x + padding, panel.y + 2.0f * padding + stats_size.y},
+                       pixel_size)) {
+        return false;
+    }
+    return SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE) == 0;
+}
+
+bool ImageViewer::renderFrameStats() const noexcept {
+    int output_width{};
+    int output_height{};
+    if (SDL_GetRendererOutputSize(m_renderer.get(), &output_width, &output_height)) {
+        return false;
+    }
+
+    // Counts are shown per second, the period may have run longer while the event loop was busy
+    std::vector<std::string> lines{};
+    auto const& overlay = *m_frame_stats_overlay;
+    if (not overlay.period) {
+        lines.emplace_back("MEASURING...");
+    } else {
+        auto const& window_period = overlay.window_period;
+        auto const& totals_period = overlay.totals_period;
+        double const seconds = std::max(std::chrono::duration<double>(*overlay.period).count(), 1e-3);
+        auto const rate = [seconds](std::uint64_t count) { return static_cast<double>(count) / seconds; };
+
+        char line[128]{};
+        std::snprintf(line, sizeof(line), "REPAINTS %.0f/S  RESIZE REPAINTS %.0f/S", rate(window_period.repaints),
+                      rate(totals_period.counters[FrameStats::kResizeRepaints]));
+        lines.emplace_back(line);
+        lines.push_back("REPAINT " + window_period.repaint.summary());
+        lines.push_back("RENDER " + window_period.render.summary());
+        lines.push_back("PRESENT " + window_period.present.summary());
+        std::snprintf(line, sizeof(line), "EVENTS %.0f/S  LATENCY %s",
+                      rate(totals_period.counters[FrameStats::kEvents]),
+                      totals_period.timings[FrameStats::kEventLatency].summary().c_str());
+        lines.emplace_back(line);
+        std::snprintf(line, sizeof(line), "LOADS %.1f/S  %s", rate(totals_period.counters[FrameStats::kLoads]),
+                      totals_period.timings[FrameStats::kLoadTime].summary().c_str());
+        lines.emplace_back(line);
+        std::snprintf(line, sizeof(line), "TEXTURES %.1f MB",
+                      static_cast<double>(textureBytes()) / (1024.0 * 1024.0));
+        lines.emplace_back(line);
+    }
+
+    // Same look as the other overlays, in the corner they leave free
+    float const density = pixelDensity();
+    float const pixel_size = kFontScale * density;
+    float const margin = kOverlayMargin * density;
+    float const padding = kOverlayPadding * density;
+    SDL_FPoint panel_size{0.0f, padding};
+    for (auto const& line : lines) {
+        SDL_FPoint const line_size = textSize(line, pixel_size);
+        panel_size.x = std::max(panel_size.x, line_size.x + 2.0f * padding);
+        panel_size.y += line_size.y + padding;
+    }
+    SDL_FRect const tab_bar = tabBarRect();
+    SDL_FRect const panel{static_cast<float>(output_width) - margin - panel_size.x, tab_bar.y + tab_bar.h + margin,
+                          panel_size.x, panel_size.y};
+
+    SDL_Renderer* renderer = m_renderer.get();
+    if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) ||
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xB0) || SDL_RenderFillRectF(renderer, &panel) ||
+        SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF)) {
+        return false;
+    }
+    SDL_FPoint origin{panel.x + padding, panel.y + padding};
+    for (auto const& line : lines) {
+        if (not renderText(renderer, line, origin, pixel_size)) {
+            return false;
+        }
+        origin.y += textSize(line, pixel_size).y + padding;
+    }
+    return SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE) == 0;
+}
+
+void ImageViewer::addTabs(std::vector<std::filesystem::path> const& image_paths) noexcept {
+    if (m_tabs.empty()) {
+        m_tabs.push_back({m_image_path});
+    }
+    for (auto const& image_path : image_paths) {
+        m_tabs.push_back({image_path});
+    }
+    updateTitle();
+    invalidate();
+}
+
+std::size_t ImageViewer::tabCount() const noexcept { return m_tabs.size(); }
+
+bool ImageViewer::showTab(std::size_t tab_index) noexcept {
+    if (tab_index >= m_tabs.size() || tab_index == m_current_tab) {
+        return false;
+    }
+    m_tabs[m_current_tab].view_state = viewState();
+    return enterTab(tab_index);
+}
+
+bool ImageViewer::showNextTab() noexcept {
+    return m_tabs.size() > 1U && showTab((m_current_tab + 1U) % m_tabs.size());
+}
+
+bool ImageViewer::showPreviousTab() noexcept {
+    return m_tabs.size() > 1U && showTab((m_current_tab + m_tabs.size() - 1U) % m_tabs.size());
+}
+
+bool ImageViewer::closeTab() noexcept {
+    if (m_tabs.size() <= 1U) {
+        return false;
+    }
+
+    m_tabs.erase(m_tabs.begin() + static_cast<std::ptrdiff_t>(m_current_tab));
+    enterTab(std::min(m_current_tab, m_tabs.size() - 1U));
+    return true;
+}
+
+bool ImageViewer::enterTab(std::size_t tab_index) noexcept {
+    m_current_tab = tab_index;
+    Tab const tab = m_tabs[tab_index];
+    if (not showImage(tab.image_path)) {
+        return false;
+    }
+    if (tab.view_state) {
+        setViewState(*tab.view_state);
+    }
+
+    // Tabs are switched through more often than the directory is stepped through, their neighbors are decoded ahead
+    std::vector<std::filesystem::path> tab_paths{};
+    tab_paths.reserve(m_tabs.size());
+    for (auto const& other_tab : m_tabs) {
+        tab_paths.push_back(other_tab.image_path);
+    }
+    ImageCache::shared().prefetchAround(SDL_GetWindowID(m_window.get()), tab_paths, m_current_tab);
+    return true;
+}
+
+void ImageViewer::updateTitle() noexcept {
+    std::string title = m_image_path.filename().string();
+    if (m_tabs.size() > 1U) {
+        title += " (" + std::to_string(m_current_tab + 1U) + "/" + std::to_string(m_tabs.size()) + ")";
+    }
+    SDL_SetWindowTitle(m_window.get(), title.c_str());
+}
+
+SDL_FRect ImageViewer::tabBarRect() const noexcept {
+    if (m_tabs.size() < 2U) {
+        return {};
+    }
+
+    int output_width{};
+    SDL_GetWindowSizeInPixels(m_window.get(), &output_width, nullptr);
+    return {0.0f, 0.0f, static_cast<float>(output_width), kTabBarHeight * pixelDensity()};
+}
+
+bool ImageViewer::renderTabBar() const noexcept {
+    SDL_FRect const bar = tabBarRect();
+    if (bar.w <= 0.0f) {
+        return true;
+    }
+
+    // A cell per tab across the window, hundreds of tabs leave a pixel or two each but stay reachable with a click
+    float const density = pixelDensity();
+    float const cell_width = bar.w / static_cast<float>(m_tabs.size());
+    float const gap = cell_width >= 4.0f * density ? density : 0.0f;
+    std::vector<SDL_FRect> cells{};
+    cells.reserve(m_tabs.size());
+    for (std::size_t tab_index = 0U; tab_index < m_tabs.size(); ++tab_index) {
+        if (tab_index != m_current_tab) {
+            cells.push_back({static_cast<float>(tab_index) * cell_width, bar.y, cell_width - gap, bar.h});
+        }
+    }
+    SDL_FRect const current_cell{static_cast<float>(m_current_tab) * cell_width, bar.y, cell_width - gap, bar.h};
+
+    char label[48]{};
+    std::snprintf(label, sizeof(label), "%zu/%zu", m_current_tab + 1U, m_tabs.size());
+    float const pixel_size = kFontScale * density;
+    float const padding = kOverlayPadding * density;
+    SDL_FPoint const label_size = textSize(label, pixel_size);
+    SDL_FRect const label_panel{bar.w - kOverlayMargin * density - label_size.x - 2.0f * padding,
+                                bar.h + kOverlayMargin * density, label_size.x + 2.0f * padding,
+                                label_size.y + 2.0f * padding};
+
+    SDL_Renderer* renderer = m_renderer.get();
+    if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) ||
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xB0) || SDL_RenderFillRectF(renderer, &bar) ||
+        SDL_RenderFillRectF(renderer, &label_panel)) {
+        return false;
+    }
+    if (SDL_SetRenderDrawColor(renderer, 0x80, 0x80, 0x80, 0xC0) ||
+        SDL_RenderFillRectsF(renderer, cells.data(), static_cast<int>(cells.size())) ||
+        SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF) || SDL_RenderFillRectF(renderer, &current_cell) ||
+        not renderText(renderer, label, {label_panel.x + padding, label_panel.y + padding}, pixel_size)) {
+        return false;
+    }
+    return SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE) == 0;
+}
+
+bool ImageViewer::showNext() noexcept {
+    auto next_path = directoryIndex().neighbor(m_image_path, 1);
+    return next_path && showImage(std::move(*next_path));
+}
+
+bool ImageViewer::showPrevious() noexcept {
+    auto previous_path = directoryIndex().neighbor(m_image_path, -1);
+    return previous_path && showImage(std::move(*previous_path));
+}
+
+bool ImageViewer::showFirst() noexcept {
+    auto first_path = directoryIndex().first();
+    if (not first_path || first_path->filename() == m_image_path.filename()) {
+        return false;
+    }
+    return showImage(std::move(*first_path));
+}
+
+bool ImageViewer::showLast() noexcept {
+    auto last_path = directoryIndex().last();
+    if (not last_path || last_path->filename() == m_image_path.filename()) {
+        return false;
+    }
+    return showImage(std::move(*last_path));
+}
+
+DirectoryIndex& ImageViewer::directoryIndex() noexcept {
+    if (not m_directory_index) {
+        m_directory_index = DirectoryIndex::shared(m_image_path.parent_path());
+    }
+    return *m_directory_index;
+}
+
+bool ImageViewer::showImage(std::filesystem::path image_path) noexcept {
+    // The preview of an unfinished decode would never be replaced, it is dropped instead
+    if (m_texture && not m_preview_shown) {
+        m_recent_textures.emplace_front(m_image_path, std::move(m_texture));
+    }
+    m_texture.reset();
+    m_preview_shown = false;
+    m_full_resolution_requested = false;
+    m_load_started_at.reset();
+
+    if (m_pending_load) {
+        m_pending_load->cancelled = true;
+        m_pending_load.reset();
+    }
+    m_animation.reset();
+    m_texture_released = false;
+    m_released_bytes = 0U;
+
+    m_image_path = std::move(image_path);
+    if (not m_tabs.empty()) {
+        m_tabs[m_current_tab].image_path = m_image_path;
+    }
+    updateTitle();
+
+    // Recently shown textures, then decoded surfaces, and only then decode it with a placeholder meanwhile
+    auto recent = std::find_if(m_recent_textures.begin(), m_recent_textures.end(),
+                               [this](auto const& recent_texture) { return recent_texture.first == m_image_path; });
+    if (recent != m_recent_textures.end()) {
+        m_texture = std::move(recent->second);
+        m_recent_textures.erase(recent);
+    } else if (auto image_surface = ImageCache::shared().find(m_image_path)) {
+        // The viewer already moved on to the image, without a texture it is decoded again like on a cache miss
+        m_texture = TiledTexture::create(m_renderer.get(), std::move(image_surface));
+        if (not m_texture) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to upload cached %s: %s", m_image_path.c_str(),
+                        SDL_GetError());
+        }
+    }
+
+    while (m_recent_textures.size() > kRecentTextures) {
+        m_recent_textures.pop_back();
+    }
+
+    if (m_texture) {
+        m_image_rect = SDL_Rect{0, 0, m_texture->width(), m_texture->height()};
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Displaying %s", m_image_path.c_str());
+        startAnimation();
+    } else {
+        SDL_Point const image_size = probeImageSize(m_image_path).value_or(SDL_Point{m_image_rect.w, m_image_rect.h});
+        m_image_rect = SDL_Rect{0, 0, image_size.x, image_size.y};
+        loadAsync(false, false);
+    }
+    inspect(nullptr);
+
+    // Linked viewers keep showing the same part of their images
+    resetView();
+    if (ImageViewer const* reference = m_compare_group ? m_compare_group->reference(this) : nullptr) {
+        setViewState(reference->viewState());
+    }
+    if (m_compare_group) {
+        m_compare_group->imageChanged(this);
+    }
+    invalidate();
+    auto const [prefetch_paths, position] =
+        directoryIndex().around(m_image_path, ImageCache::shared().prefetchRadius());
+    ImageCache::shared().prefetchAround(SDL_GetWindowID(m_window.get()), prefetch_paths, position);
+    return true;
+}
+
+void ImageViewer::resetView() noexcept {
+    m_zoom = 1.0f;
+    m_view_center = {static_cast<float>(m_image_rect.w) / 2.0f, static_cast<float>(m_image_rect.h) / 2.0f};
+}
+
+void ImageViewer::inspect(SurfacePtr image_surface) noexcept {
+    if (not m_inspector) {
+        return;
+    }
+
+    // Textures do not keep the pixels, the decode completing hands them over when none is cached
+    if (not image_surface) {
+        image_surface = ImageCache::shared().find(m_image_path);
+    }
+    if (not image_surface && not m_pending_load) {
+        loadAsync(false, m_texture && m_texture->resolution() >= 1.0f);
+    }
+    m_inspector->setSurface(std::move(image_surface));
+}
+
+void ImageViewer::restoreTextures() noexcept {
+    if (not m_texture_released) {
+        return;
+    }
+
+    // Only the detail of the current image has to come back, the rest is made again as it is needed
+    bool const detail_released = m_released_bytes > 0U;
+    m_texture_released = false;
+    m_released_bytes = 0U;
+    invalidate();
+    if (not detail_released || m_pending_load) {
+        return;
+    }
+
+    m_full_resolution_requested = false;
+
+    if (auto image_surface = ImageCache::shared().find(m_image_path)) {
+        if (auto image_texture = TiledTexture::create(m_renderer.get(), std::move(image_surface))) {
+            m_texture = std::move(image_texture);
+            startAnimation();
+            return;
+        }
+    }
+
+    // The low resolution texture stays on screen until the decode completes
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Restoring %s", m_image_path.c_str());
+    loadAsync(false, false);
+}
+
+void ImageViewer::startAnimation() noexcept {
+    if (not m_animation && AnimationDecoder::isAnimationFile(m_image_path)) {
+        m_animation = AnimationPlayer::open(m_image_path, SDL_GetWindowID(m_window.get()));
+    }
+}
+
+void ImageViewer::showFrame(SurfacePtr frame_surface) noexcept {
+    // Frames have the size of the image, so the texture is written in place unless it comes from a reduced decode
+    if (not m_texture || not m_texture->update(frame_surface)) {
+        auto frame_texture = TiledTexture::create(m_renderer.get(), std::move(frame_surface));
+        if (not frame_texture) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to show frame of %s: %s", m_image_path.c_str(),
+                        SDL_GetError());
+            return;
+        }
+        m_texture = std::move(frame_texture);
+    }
+    invalidate();
+}
+
+void ImageViewer::processKeyboardEvent(SDL_KeyboardEvent const& event) {
+    if (event.type != SDL_KEYDOWN) {
+        return;
+    }
+
+    switch (event.keysym.sym) {
+        case SDLK_RIGHT:
+        case SDLK_PAGEDOWN:
+        case SDLK_SPACE: {
+            showNext();
+            break;
+        }
+        case SDLK_LEFT:
+        case SDLK_PAGEUP:
+        case SDLK_BACKSPACE: {
+            showPrevious();
+            break;
+        }
+        case SDLK_HOME: {
+            showFirst();
+            break;
+        }
+        case SDLK_END: {
+            showLast();
+            break;
+        }
+        case SDLK_i: {
+            toggleInspector();
+            break;
+        }
+        case SDLK_f: {
+            toggleFrameStats();
+            break;
+        }
+        case SDLK_TAB: {
+            if (event.keysym.mod & KMOD_SHIFT) {
+                showPreviousTab();
+            } else {
+                showNextTab();
+            }
+            break;
+        }
+        case SDLK_d: {
+            toggleDifference();
+            break;
+        }
+        case SDLK_RIGHTBRACKET: {
+            if (m_difference_options) {
+                int const threshold = m_difference_options->threshold;
+                changeDifferenceOptions({std::min(threshold > 0 ? threshold * 2 : 1, kMaxDifferenceThreshold),
+                                         m_difference_options->gain});
+            }
+            break;
+        }
+        case SDLK_LEFTBRACKET: {
+            if (m_difference_options) {
+                changeDifferenceOptions({m_difference_options->threshold / 2, m_difference_options->gain});
+            }
+            break;
+        }
+        case SDLK_EQUALS: {
+            if (m_difference_options) {
+                changeDifferenceOptions(
+                    {m_difference_options->threshold, std::min(m_difference_options->gain * 2, kMaxDifferenceGain)});
+            }
+            break;
+        }
+        case SDLK_MINUS: {
+            if (m_difference_options) {
+                changeDifferenceOptions({m_difference_options->threshold, std::max(m_difference_options->gain / 2, 1)});
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
 }
 
 void ImageViewer::processMouseButtonEvent(SDL_MouseButtonEvent const& event) {
-    if (event.type == SDL_MOUSEBUTTONDOWN && event.button == SDL_BUTTON_LEFT && event.clicks == 2U) {
+    if (event.type != SDL_MOUSEBUTTONDOWN || event.button != SDL_BUTTON_LEFT) {
+        return;
+    }
+
+    // A click on the tab bar shows the tab under the cursor
+    SDL_FRect const tab_bar = tabBarRect();
+    float const density = pixelDensity();
+    SDL_FPoint const point{static_cast<float>(event.x) * density, static_cast<float>(event.y) * density};
+    if (tab_bar.w > 0.0f && point.y < tab_bar.y + tab_bar.h) {
+        auto const tab_index = static_cast<std::size_t>(std::max(point.x, 0.0f) / tab_bar.w *
+                                                        static_cast<float>(m_tabs.size()));
+        showTab(std::min(tab_index, m_tabs.size() - 1U));
+        return;
+    }
+
+    if (event.clicks == 2U) {
         maximize();
     }
 }
 
-void ImageViewer::processMouseMotionEvent(SDL_MouseMotionEvent const& event) {}
+bool ImageViewer::processLoadedEvent([[maybe_unused]] SDL_UserEvent const& event) noexcept {
+    // Until the load completes, only its latest preview is shown
+    if (not m_pending_load || takePreview()) {
+        return true;
+    }
+
+    // Events of cancelled loads are never pushed, but the current load may not be done yet
+    SurfacePtr image_surface{};
+    bool fit_window{};
+    std::optional<std::chrono::steady_clock::time_point> changed_at{};
+    {
+        std::lock_guard lock{m_pending_load->mutex};
+        if (not m_pending_load->completed) {
+            return true;
+        }
+        if (not m_pending_load->surface && m_pending_load->changed_at) {
+            // The file may be caught in the middle of a rewrite, the next change reloads it again
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Keeping the previous version of %s: %s", m_image_path.c_str(),
+                        m_pending_load->error.c_str());
+            m_pending_load.reset();
+            startAnimation();
+            return true;
+        }
+        if (not m_pending_load->surface) {
+            SDL_SetError("%s", m_pending_load->error.c_str());
+            return false;
+        }
+        image_surface = std::move(m_pending_load->surface);
+        fit_window = m_pending_load->fit_window;
+        changed_at = m_pending_load->changed_at;
+    }
+    m_pending_load.reset();
+
+    // Only resize when the header probe got it wrong, the user may already have resized the window
+    SDL_Point const image_size = imageSize(image_surface);
+    SDL_Rect const image_rect{0, 0, image_size.x, image_size.y};
+    auto image_texture = TiledTexture::create(m_renderer.get(), image_surface);
+    if (not image_texture) {
+        return false;
+    }
+    inspect(std::move(image_surface));
+
+    bool const image_size_changed = image_rect.w != m_image_rect.w || image_rect.h != m_image_rect.h;
+    m_image_rect = image_rect;
+    m_texture = std::move(image_texture);
+    m_texture_released = false;
+    m_released_bytes = 0U;
+    m_preview_shown = false;
+    m_reload_changed_at = changed_at;
+    if (image_size_changed) {
+        resetView();
+        if (fit_window) {
+            resize();
+        }
+    }
+    invalidate();
+    startAnimation();
+    if (changed_at && m_compare_group) {
+        m_compare_group->imageChanged(this);
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Displaying %s", m_image_path.c_str());
+    return true;
+}
+
+bool ImageViewer::takePreview() noexcept {
+    SurfacePtr preview_surface{};
+    bool fit_window{};
+    {
+        std::lock_guard lock{m_pending_load->mutex};
+        if (m_pending_load->completed) {
+            return false;
+        }
+        preview_surface = std::move(m_pending_load->preview);
+        fit_window = m_pending_load->fit_window;
+    }
+    if (not preview_surface) {
+        return true;
+    }
+
+    // Previews know the size of the image, the header probe may have got it wrong
+    SDL_Point const image_size = imageSize(preview_surface);
+    if (image_size.x != m_image_rect.w || image_size.y != m_image_rect.h) {
+        m_image_rect = SDL_Rect{0, 0, image_size.x, image_size.y};
+        resetView();
+        if (fit_window) {
+            resize();
+        }
+    }
+
+    // Previews of the same image have the same size, all but the first one are written in place
+    showFrame(std::move(preview_surface));
+    m_preview_shown = true;
+    return true;
+}
+
+void ImageViewer::reload(std::chrono::steady_clock::time_point changed_at) noexcept {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Reloading %s", m_image_path.c_str());
+
+    // The window, the renderer and the view stay, only the texture is swapped once the new version is decoded
+    m_animation.reset();
+    m_full_resolution_requested = false;
+    loadAsync(false, m_texture && m_texture->resolution() >= 1.0f);
+    m_pending_load->changed_at = changed_at;
+}
+
+void ImageViewer::processMouseMotionEvent(SDL_MouseMotionEvent const& event) {
+    // Only one pixel is read, the overlay is drawn with the next repaint
+    if (m_inspector && m_inspector->setCursor(imagePointAt(event.x, event.y))) {
+        invalidate();
+    }
 
-void ImageViewer::processMouseWheelEvent(SDL_MouseWheelEvent const& event) {}
\ No newline at end of file
+    if (m_zoom <= 1.0f || not(event.state & SDL_BUTTON_LMASK)) {
+        return;
+    }
+
+    // Drag the image along with the cursor, the view center is kept where the viewport can reach
+    Viewport const image_viewport = viewport();
+    float const density = pixelDensity();
+    m_view_center.x = std::clamp(m_view_center.x - static_cast<float>(event.xrel) * density / image_viewport.scale,
+                                 image_viewport.view.w / 2.0f,
+                                 static_cast<float>(m_image_rect.w) - image_viewport.view.w / 2.0f);
+    m_view_center.y = std::clamp(m_view_center.y - static_cast<float>(event.yrel) * density / image_viewport.scale,
+                                 image_viewport.view.h / 2.0f,
+                                 static_cast<float>(m_image_rect.h) - image_viewport.view.h / 2.0f);
+    invalidate();
+    syncView();
+}
+
+void ImageViewer::processMouseWheelEvent(SDL_MouseWheelEvent const& event) {
+    if (event.preciseY == 0.0f || m_image_rect.w <= 0 || m_image_rect.h <= 0) {
+        return;
+    }
+
+    Viewport const previous_viewport = viewport();
+    float const fit_scale = previous_viewport.scale / std::max(m_zoom, 1.0f);
+
+    // Zoom in up to 32 screen pixels per image pixel, zooming out stops at fit to window
+    float const max_zoom = std::max(32.0f / fit_scale, 1.0f);
+    float const direction = event.direction == SDL_MOUSEWHEEL_FLIPPED ? -1.0f : 1.0f;
+    m_zoom = std::clamp(m_zoom * std::pow(1.1f, direction * event.preciseY), 1.0f, max_zoom);
+
+    // Keep the image point under the cursor in place
+    float const density = pixelDensity();
+    SDL_FPoint const cursor{static_cast<float>(event.mouseX) * density, static_cast<float>(event.mouseY) * density};
+    SDL_FPoint const anchor{
+        previous_viewport.view.x + (cursor.x - previous_viewport.dst.x) / previous_viewport.scale,
+        previous_viewport.view.y + (cursor.y - previous_viewport.dst.y) / previous_viewport.scale};
+
+    SDL_Rect window_rect{};
+    SDL_GetWindowSizeInPixels(m_window.get(), &window_rect.w, &window_rect.h);
+    float const scale = fit_scale * m_zoom;
+    float const visible_width = std::min(static_cast<float>(window_rect.w) / scale, static_cast<float>(m_image_rect.w));
+    float const visible_height =
+        std::min(static_cast<float>(window_rect.h) / scale, static_cast<float>(m_image_rect.h));
+    m_view_center.x = std::clamp(anchor.x - cursor.x / scale + static_cast<float>(window_rect.w) / (2.0f * scale),
+                                 visible_width / 2.0f, static_cast<float>(m_image_rect.w) - visible_width / 2.0f);
+    m_view_center.y = std::clamp(anchor.y - cursor.y / scale + static_cast<float>(window_rect.h) / (2.0f * scale),
+                                 visible_height / 2.0f, static_cast<float>(m_image_rect.h) - visible_height / 2.0f);
+    invalidate();
+    syncView();
+}
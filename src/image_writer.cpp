@@ -0,0 +1,177 @@
+#include "image_writer.hpp"
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "SDL_image.h"
+#include "image_loader.hpp"
+
+#if IMGV2_HAVE_LIBWEBP
+#include <webp/encode.h>
+#endif
+
+namespace {
+
+std::string lowercaseExtension(std::filesystem::path const& image_path) noexcept {
+    std::string extension = image_path.extension().string();
+    for (auto& c : extension) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return extension;
+}
+
+/// Surface with its pixels laid out as R, G, B, A bytes, the layout expected by the qoi and webp encoders
+SurfacePtr convertToRGBA32(SDL_Surface* surface) noexcept {
+    return SDLit::make_unique(SDL_ConvertSurfaceFormat, surface, SDL_PIXELFORMAT_RGBA32, 0);
+}
+
+bool writeFile(std::filesystem::path const& image_path, std::vector<std::uint8_t> const& bytes) noexcept {
+    std::ofstream image_file{image_path, std::ios::binary | std::ios::trunc};
+    image_file.write(reinterpret_cast<char const*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (not image_file) {
+        SDL_SetError("failed to write %s", image_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/// Encoder of the "Quite OK Image" format, see https://qoiformat.org/qoi-specification.pdf
+bool saveQOI(SDL_Surface* surface, std::filesystem::path const& image_path) noexcept {
+    auto rgba_surface = convertToRGBA32(surface);
+    if (not rgba_surface) {
+        return false;
+    }
+
+    auto const width = static_cast<std::uint32_t>(rgba_surface->w);
+    auto const height = static_cast<std::uint32_t>(rgba_surface->h);
+
+    std::vector<std::uint8_t> bytes{};
+    bytes.reserve(14U + std::size_t{width} * height * 5U + 8U);
+    auto const put32 = [&bytes](std::uint32_t value) {
+        bytes.push_back(static_cast<std::uint8_t>(value >> 24));
+        bytes.push_back(static_cast<std::uint8_t>(value >> 16));
+        bytes.push_back(static_cast<std::uint8_t>(value >> 8));
+        bytes.push_back(static_cast<std::uint8_t>(value));
+    };
+
+    bytes.insert(bytes.end(), {'q', 'o', 'i', 'f'});
+    put32(width);
+    put32(height);
+    bytes.push_back(4);  // RGBA
+    bytes.push_back(0);  // sRGB with linear alpha
+
+    struct Pixel {
+        std::uint8_t r, g, b, a;
+    };
+    std::array<Pixel, 64> index{};
+    Pixel previous{0, 0, 0, 255};
+    unsigned run = 0;
+
+    for (std::uint32_t y = 0; y < height; ++y) {
+        auto const* row = static_cast<std::uint8_t const*>(rgba_surface->pixels) + std::size_t{y} * rgba_surface->pitch;
+        for (std::uint32_t x = 0; x < width; ++x) {
+            Pixel const pixel{row[x * 4U], row[x * 4U + 1U], row[x * 4U + 2U], row[x * 4U + 3U]};
+            bool const same = pixel.r == previous.r && pixel.g == previous.g && pixel.b == previous.b &&
+                              pixel.a == previous.a;
+            if (same) {
+                if (++run == 62U) {
+                    bytes.push_back(static_cast<std::uint8_t>(0xC0 | (run - 1U)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                bytes.push_back(static_cast<std::uint8_t>(0xC0 | (run - 1U)));
+                run = 0;
+            }
+
+            auto const hash = (pixel.r * 3U + pixel.g * 5U + pixel.b * 7U + pixel.a * 11U) % 64U;
+            Pixel const& indexed = index[hash];
+            if (indexed.r == pixel.r && indexed.g == pixel.g && indexed.b == pixel.b && indexed.a == pixel.a) {
+                bytes.push_back(static_cast<std::uint8_t>(hash));
+            } else if (pixel.a == previous.a) {
+                int const dr = static_cast<std::int8_t>(pixel.r - previous.r);
+                int const dg = static_cast<std::int8_t>(pixel.g - previous.g);
+                int const db = static_cast<std::int8_t>(pixel.b - previous.b);
+                int const dr_dg = dr - dg;
+                int const db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    bytes.push_back(static_cast<std::uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    bytes.push_back(static_cast<std::uint8_t>(0x80 | (dg + 32)));
+                    bytes.push_back(static_cast<std::uint8_t>(((dr_dg + 8) << 4) | (db_dg + 8)));
+                } else {
+                    bytes.insert(bytes.end(), {0xFE, pixel.r, pixel.g, pixel.b});
+                }
+            } else {
+                bytes.insert(bytes.end(), {0xFF, pixel.r, pixel.g, pixel.b, pixel.a});
+            }
+
+            index[hash] = pixel;
+            previous = pixel;
+        }
+    }
+
+    if (run > 0) {
+        bytes.push_back(static_cast<std::uint8_t>(0xC0 | (run - 1U)));
+    }
+    bytes.insert(bytes.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+    return writeFile(image_path, bytes);
+}
+
+bool saveWEBP(SDL_Surface* surface, std::filesystem::path const& image_path, int quality) noexcept {
+#if IMGV2_HAVE_LIBWEBP
+    auto rgba_surface = convertToRGBA32(surface);
+    if (not rgba_surface) {
+        return false;
+    }
+
+    std::uint8_t* output = nullptr;
+    std::size_t const output_size =
+        WebPEncodeRGBA(static_cast<std::uint8_t const*>(rgba_surface->pixels), rgba_surface->w, rgba_surface->h,
+                       rgba_surface->pitch, static_cast<float>(quality), &output);
+    if (output_size == 0) {
+        SDL_SetError("failed to encode %s", image_path.c_str());
+        return false;
+    }
+
+    std::vector<std::uint8_t> const bytes(output, output + output_size);
+    WebPFree(output);
+    return writeFile(image_path, bytes);
+#else
+    (void)surface;
+    (void)quality;
+    SDL_SetError("built without webp encoder, cannot write %s", image_path.c_str());
+    return false;
+#endif
+}
+
+}  // namespace
+
+bool saveImage(SDL_Surface* surface, std::filesystem::path const& image_path, int quality) noexcept {
+    if (surface == nullptr) {
+        SDL_SetError("no image surface to save");
+        return false;
+    }
+
+    auto const extension = lowercaseExtension(image_path);
+    if (extension == ".png") {
+        return IMG_SavePNG(surface, image_path.c_str()) == 0;
+    } else if (extension == ".jpg" || extension == ".jpeg") {
+        return IMG_SaveJPG(surface, image_path.c_str(), quality) == 0;
+    } else if (extension == ".bmp") {
+        return SDL_SaveBMP(surface, image_path.c_str()) == 0;
+    } else if (extension == ".qoi") {
+        return saveQOI(surface, image_path);
+    } else if (extension == ".webp") {
+        return saveWEBP(surface, image_path, quality);
+    }
+
+    SDL_SetError("unsupported image format %s", extension.c_str());
+    return false;
+}
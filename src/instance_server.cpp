@@ -0,0 +1,217 @@
+#include "instance_server.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define IMGV2_INSTANCE_SOCKET 1
+#else
+#define IMGV2_INSTANCE_SOCKET 0
+#endif
+
+namespace {
+
+#if IMGV2_INSTANCE_SOCKET
+/// Seconds a connected client has to send its paths before it is dropped
+constexpr time_t kReceiveTimeout = 2;
+
+bool makeAddress(std::filesystem::path const& socket_path, sockaddr_un& address) noexcept {
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.native().size() >= sizeof(address.sun_path)) {
+        SDL_SetError("socket path is too long: %s", socket_path.c_str());
+        return false;
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.native().size());
+    return true;
+}
+
+int connectTo(std::filesystem::path const& socket_path) noexcept {
+    sockaddr_un address{};
+    if (not makeAddress(socket_path, address)) {
+        return -1;
+    }
+
+    int const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool writeAll(int fd, char const* data, std::size_t size) noexcept {
+    while (size > 0) {
+        ssize_t const written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+#endif
+
+}  // namespace
+
+std::filesystem::path InstanceServer::defaultSocketPath() noexcept {
+#if IMGV2_INSTANCE_SOCKET
+    char const* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir != nullptr && *runtime_dir != '\0') {
+        return std::filesystem::path{runtime_dir} / "imgv2.sock";
+    }
+
+    std::error_code error{};
+    auto temp_dir = std::filesystem::temp_directory_path(error);
+    if (error) {
+        temp_dir = "/tmp";
+    }
+    return temp_dir / ("imgv2-" + std::to_string(::getuid()) + ".sock");
+#else
+    return {};
+#endif
+}
+
+bool InstanceServer::forward(std::filesystem::path const& socket_path,
+                             std::vector<std::filesystem::path> const& image_paths) noexcept {
+#if IMGV2_INSTANCE_SOCKET
+    int const fd = connectTo(socket_path);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Paths are null terminated, the running instance has its own working directory so they are made absolute
+    std::string message{};
+    for (auto const& image_path : image_paths) {
+        std::error_code error{};
+        auto absolute_path = std::filesystem::absolute(image_path, error);
+        message += error ? image_path.native() : absolute_path.native();
+        message.push_back('\0');
+    }
+
+    bool const sent = writeAll(fd, message.data(), message.size());
+    ::close(fd);
+    return sent;
+#else
+    (void)socket_path;
+    (void)image_paths;
+    return false;
+#endif
+}
+
+std::unique_ptr<InstanceServer> InstanceServer::listen(std::filesystem::path socket_path) noexcept {
+#if IMGV2_INSTANCE_SOCKET
+    sockaddr_un address{};
+    if (not makeAddress(socket_path, address)) {
+        return {nullptr};
+    }
+
+    // A socket nobody answers on was left behind by an instance that crashed
+    if (int const fd = connectTo(socket_path); fd >= 0) {
+        ::close(fd);
+        SDL_SetError("another instance is listening on %s", socket_path.c_str());
+        return {nullptr};
+    }
+    ::unlink(socket_path.c_str());
+
+    int const listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        SDL_SetError("failed to create socket: %s", std::strerror(errno));
+        return {nullptr};
+    }
+    if (::bind(listen_fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0 ||
+        ::listen(listen_fd, SOMAXCONN) != 0) {
+        SDL_SetError("failed to listen on %s: %s", socket_path.c_str(), std::strerror(errno));
+        ::close(listen_fd);
+        return {nullptr};
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Listening for images on %s", socket_path.c_str());
+    return std::unique_ptr<InstanceServer>{new InstanceServer{std::move(socket_path), listen_fd}};
+#else
+    (void)socket_path;
+    SDL_SetError("single instance mode requires unix domain sockets");
+    return {nullptr};
+#endif
+}
+
+InstanceServer::InstanceServer(std::filesystem::path socket_path, int listen_fd) noexcept
+    : m_socket_path(std::move(socket_path)), m_listen_fd(listen_fd) {
+    m_thread = std::thread{&InstanceServer::run, this};
+}
+
+InstanceServer::~InstanceServer() noexcept {
+#if IMGV2_INSTANCE_SOCKET
+    // accept() is not interrupted by closing the socket on every platform, wake it up with a connection instead
+    m_stopping = true;
+    if (int const fd = connectTo(m_socket_path); fd >= 0) {
+        ::close(fd);
+    }
+    m_thread.join();
+
+    ::close(m_listen_fd);
+    ::unlink(m_socket_path.c_str());
+#endif
+}
+
+void InstanceServer::run() noexcept {
+#if IMGV2_INSTANCE_SOCKET
+    while (not m_stopping) {
+        int const client_fd = ::accept(m_listen_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Stopped listening for images: %s", std::strerror(errno));
+            return;
+        }
+
+        timeval const timeout{kReceiveTimeout, 0};
+        ::setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string message{};
+        char buffer[4096];
+        for (;;) {
+            ssize_t const received = ::read(client_fd, buffer, sizeof(buffer));
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                break;
+            }
+            message.append(buffer, static_cast<std::size_t>(received));
+        }
+        ::close(client_fd);
+
+        // Same event the window system sends for a dropped file, the main loop releases it with SDL_free
+        for (std::size_t begin = 0, end = message.find('\0'); end != std::string::npos;
+             begin = end + 1, end = message.find('\0', begin)) {
+            if (end == begin) {
+                continue;
+            }
+
+            SDL_Event event{};
+            event.drop.type = SDL_DROPFILE;
+            event.drop.timestamp = SDL_GetTicks();
+            event.drop.file = SDL_strdup(message.substr(begin, end - begin).c_str());
+            if (SDL_PushEvent(&event) != 1) {
+                SDL_free(event.drop.file);
+            }
+        }
+    }
+#endif
+}
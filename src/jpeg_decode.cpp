@@ -0,0 +1,79 @@
+#include "jpeg_decode.hpp"
+
+#if IMGV2_HAVE_LIBJPEG
+#include <csetjmp>
+
+namespace {
+
+struct JpegErrorManager {
+    jpeg_error_mgr manager;
+    std::jmp_buf jump;
+};
+
+[[noreturn]] void jumpOut(j_common_ptr info) {
+    std::longjmp(reinterpret_cast<JpegErrorManager*>(info->err)->jump, 1);
+}
+
+void onJpegError(j_common_ptr info) {
+    char message[JMSG_LENGTH_MAX]{};
+    (*info->err->format_message)(info, message);
+    SDL_SetError("failed to decode jpeg: %s", message);
+    jumpOut(info);
+}
+
+void ignoreJpegMessage(j_common_ptr, int) {}
+
+}  // namespace
+
+/// libjpeg reports errors with longjmp, nothing with a destructor may live in this frame
+SDL_Surface* decodeJpegWith(std::uint8_t const* data, std::size_t size, bool quiet,
+                            std::function<bool(JpegDecode& decode)> const& read_pixels) noexcept {
+    JpegDecode decode{};
+    JpegErrorManager error{};
+    decode.info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = onJpegError;
+    if (quiet) {
+        error.manager.emit_message = ignoreJpegMessage;
+    }
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&decode.info);
+        SDL_FreeSurface(decode.surface);
+        return nullptr;
+    }
+
+    jpeg_create_decompress(&decode.info);
+    jpeg_mem_src(&decode.info, data, static_cast<unsigned long>(size));
+    jpeg_read_header(&decode.info, TRUE);
+
+    // CMYK has no conversion to RGB in libjpeg, SDL_image takes care of it
+    decode.info.out_color_space = JCS_RGB;
+    bool const decoded = decode.info.jpeg_color_space != JCS_CMYK && decode.info.jpeg_color_space != JCS_YCCK &&
+                         read_pixels(decode);
+    jpeg_destroy_decompress(&decode.info);
+    if (not decoded) {
+        SDL_FreeSurface(decode.surface);
+        return nullptr;
+    }
+    return decode.surface;
+}
+
+bool createJpegSurface(JpegDecode& decode) noexcept {
+    decode.surface = SDL_CreateRGBSurfaceWithFormat(0, static_cast<int>(decode.info.output_width),
+                                                    static_cast<int>(decode.info.output_height), 24,
+                                                    SDL_PIXELFORMAT_RGB24);
+    return decode.surface != nullptr;
+}
+
+void readJpegRows(JpegDecode& decode, JDIMENSION end_row) {
+    SDL_Surface* const surface = decode.surface;
+    while (decode.info.output_scanline < end_row) {
+        JSAMPROW row = static_cast<JSAMPLE*>(surface->pixels) + decode.info.output_scanline * surface->pitch;
+        jpeg_read_scanlines(&decode.info, &row, 1);
+    }
+}
+
+void failJpegDecode(JpegDecode& decode, char const* message) {
+    SDL_SetError("%s", message);
+    jumpOut(reinterpret_cast<j_common_ptr>(&decode.info));
+}
+#endif
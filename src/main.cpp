@@ -1,36 +1,234 @@
 #include "main.hpp"
 
 #include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
 #include <unordered_map>
 
+#include "animation_player.hpp"
+#include "batch_export.hpp"
+#include "compare_group.hpp"
+#include "disk_cache.hpp"
+#include "file_watcher.hpp"
+#include "frame_stats.hpp"
+#include "image_cache.hpp"
+#include "image_inspector.hpp"
 #include "image_viewer.hpp"
+#include "instance_server.hpp"
+#include "mapped_file.hpp"
 #include "native_window.h"
+#include "progressive_decode.hpp"
+#include "texture_budget.hpp"
+#include "thumbnail_grid.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
 
 static bool preamble() noexcept;
 static int eventMonitor(void* context, SDL_Event* event) noexcept;
 
 using ImageViewerMap = std::unordered_map<std::uint32_t, std::unique_ptr<ImageViewer>>;
 using ImagePaths = std::vector<std::filesystem::path>;
-static void openImages(ImageViewerMap& image_viewer_map, ImagePaths const& image_paths) noexcept;
+
+/// Behaviors selected from the command line
+struct Options {
+    bool async_loading{false};
+    bool single_instance{false};
+    bool fit_decode{false};
+    bool watch{false};
+    bool grid{false};
+    bool compare{false};
+    bool tabs{false};
+    bool export_images{false};
+    ExportOptions export_options{};
+    bool disk_cache{false};
+    std::size_t disk_cache_size{2048U};
+    std::size_t stats_interval{};
+    std::filesystem::path stats_path{};
+};
+
+/// Periodic dump of the runtime stats, each one covers what was counted since the previous one
+struct StatsDump {
+    std::chrono::steady_clock::duration interval{};
+    std::chrono::steady_clock::time_point last_dump{};
+    FrameStats::Totals totals{};
+    std::unordered_map<std::uint32_t, WindowFrameStats> window_stats{};
+    std::ofstream file{};
+};
+
+static void openImages(ImageViewerMap& image_viewer_map, ImagePaths const& image_paths,
+                       Options const& options) noexcept;
+static ImagePaths expandDirectories(ImagePaths const& image_paths) noexcept;
+static void toggleCompare(ImageViewerMap& image_viewer_map, ImageViewer* leader) noexcept;
+static bool waitEvent(ImageViewerMap const& image_viewer_map, ThumbnailGrid const* thumbnail_grid,
+                      std::optional<std::chrono::steady_clock::time_point> next_update_time, SDL_Event& event) noexcept;
+static void dumpStats(ImageViewerMap const& image_viewer_map, StatsDump& stats_dump) noexcept;
+static bool parseOptionValue(std::string_view arg, std::string_view option, std::size_t& value) noexcept;
+static bool parseSizeValue(std::string_view arg, std::string_view option, SDL_Point& size) noexcept;
 
 int main(int argc, char** argv) {
     auto const initialization_startup_timestamp = std::chrono::steady_clock().now();
+    Options options{};
+    ImagePaths image_paths{};
+    if (char const* trace_path = std::getenv("IMGV2_TRACE"); trace_path != nullptr && *trace_path != '\0') {
+        Trace::enable(trace_path);
+    }
     for (int i = 1; i < argc; ++i) {
         auto arg_view = std::string_view{argv[i]};
-        if (arg_view.starts_with("-")) {
+        std::size_t option_value{};
+        SDL_Point size_value{};
+        if (arg_view == "--async") {
+            options.async_loading = true;
+        } else if (arg_view == "--fit-decode") {
+            options.fit_decode = true;
+        } else if (arg_view == "--watch") {
+            options.watch = true;
+        } else if (arg_view == "--grid") {
+            options.grid = true;
+        } else if (arg_view == "--compare") {
+            options.compare = true;
+        } else if (arg_view == "--tabs") {
+            options.tabs = true;
+        } else if (arg_view.starts_with("--export=")) {
+            options.export_images = true;
+            options.export_options.output_directory = arg_view.substr(std::string_view{"--export="}.size());
+        } else if (arg_view.starts_with("--export-format=")) {
+            options.export_options.format = arg_view.substr(std::string_view{"--export-format="}.size());
+        } else if (parseOptionValue(arg_view, "--quality=", option_value) && option_value <= 100U) {
+            options.export_options.quality = static_cast<int>(option_value);
+        } else if (parseSizeValue(arg_view, "--fit=", size_value)) {
+            options.export_options.fit_size = size_value;
+        } else if (parseOptionValue(arg_view, "--rotate=", option_value) && option_value % 90U == 0U) {
+            options.export_options.quarter_turns = static_cast<int>((option_value / 90U) % 4U);
+        } else if (arg_view == "--flip-horizontal" || arg_view == "--flip-vertical") {
+            auto const flip = arg_view == "--flip-horizontal" ? SDL_FLIP_HORIZONTAL : SDL_FLIP_VERTICAL;
+            options.export_options.flip = static_cast<SDL_RendererFlip>(options.export_options.flip ^ flip);
+        } else if (arg_view == "--single-instance") {
+            options.single_instance = true;
+        } else if (parseOptionValue(arg_view, "--cache-size=", option_value)) {
+            ImageCache::shared().setBudget(option_value * 1024U * 1024U);
+        } else if (parseOptionValue(arg_view, "--prefetch=", option_value)) {
+            ImageCache::shared().setPrefetchRadius(option_value);
+        } else if (parseOptionValue(arg_view, "--texture-budget=", option_value)) {
+            TextureBudget::shared().setBudget(option_value * 1024U * 1024U);
+        } else if (arg_view.starts_with("--trace=")) {
+            Trace::enable(std::filesystem::path{arg_view.substr(std::string_view{"--trace="}.size())});
+        } else if (arg_view == "--disk-cache") {
+            options.disk_cache = true;
+        } else if (parseOptionValue(arg_view, "--disk-cache-size=", option_value)) {
+            options.disk_cache = true;
+            options.disk_cache_size = option_value;
+        } else if (parseOptionValue(arg_view, "--stats=", option_value) && option_value > 0U) {
+            options.stats_interval = option_value;
+        } else if (arg_view.starts_with("--stats-file=")) {
+            options.stats_path = arg_view.substr(std::string_view{"--stats-file="}.size());
+        } else if (arg_view.starts_with("-")) {
             std::cerr << "ImageViewer V2\n\n";
             std::cerr << "imgv2 is a simple and minimalist cross platform "
                          "image viewer.\n\n";
             std::cerr << "USAGE: \n";
-            std::cerr << "    " << argv[0] << " [IMAGE ...]\n";
+            std::cerr << "    " << argv[0] << " [OPTIONS] [IMAGE ...]\n";
             std::cerr << "    " << argv[0] << " -h\n";
-            std::cerr << "    " << argv[0] << " --help\n";
+            std::cerr << "    " << argv[0] << " --help\n\n";
+            std::cerr << "OPTIONS: \n";
+            std::cerr << "    --async            show windows right away and decode the images in background\n";
+            std::cerr << "    --cache-size=MB    memory budget for decoded images kept for navigation (512)\n";
+            std::cerr << "    --prefetch=N       images decoded ahead on each side of the current one (2)\n";
+            std::cerr << "    --texture-budget=MB\n";
+            std::cerr << "                       memory for the textures of all the windows together (1024)\n";
+            std::cerr << "    --fit-decode       decode large images at display size, in full once zoomed in\n";
+            std::cerr << "    --grid             browse the images and directories as thumbnails in a single window,\n";
+            std::cerr << "                       enter or a double click opens the selected one\n";
+            std::cerr << "    --tabs             open the images as tabs of a single window, each one decoded\n";
+            std::cerr << "                       once its tab is shown\n";
+            std::cerr << "    --compare          link the windows, flips, zoom and pan of one apply to all of them\n";
+            std::cerr << "    --watch            reload the images in place when their files are rewritten (Linux)\n";
+            std::cerr << "    --single-instance  open the images in the running instance, start one if there is none\n";
+            std::cerr << "    --disk-cache       keep decoded images on disk to reopen them without decoding\n";
+            std::cerr << "    --disk-cache-size=MB\n";
+            std::cerr << "                       disk space for decoded images, implies --disk-cache (2048)\n";
+            std::cerr << "    --export=DIR       write the images transformed to DIR without opening any window, the\n";
+            std::cerr << "                       directories given are exported whole, with the options below\n";
+            std::cerr << "    --export-format=EXT\n";
+            std::cerr << "                       png, qoi, jpg, bmp or webp (png)\n";
+            std::cerr << "    --quality=N        quality of the lossy formats, from 0 to 100 (90)\n";
+            std::cerr << "    --fit=WxH          shrink the images to fit in WxH, keeping their aspect ratio\n";
+            std::cerr << "    --flip-horizontal, --flip-vertical\n";
+            std::cerr << "                       mirror the images\n";
+            std::cerr << "    --rotate=DEGREES   rotate clockwise by 90, 180 or 270 after mirroring\n";
+            std::cerr << "    --trace=FILE       write the timings of the startup stages as Chrome trace-event JSON,\n";
+            std::cerr << "                       also enabled by the IMGV2_TRACE environment variable\n";
+            std::cerr << "    --stats=SECONDS    write the repaint timings and texture bytes of each window, the\n";
+            std::cerr << "                       event latency and the loads every SECONDS to stderr\n";
+            std::cerr << "    --stats-file=FILE  append the stats to FILE instead, implies --stats=10\n\n";
+            std::cerr << "KEYS: \n";
+            std::cerr << "    Left/Right         previous/next image in the same directory\n";
+            std::cerr << "    Home/End           first/last image in the same directory\n";
+            std::cerr << "    Tab/Shift+Tab      next/previous tab, a click on the tab bar shows the tab under it\n";
+            std::cerr << "    Ctrl+W             close the tab, or the window when it has no other tab\n";
+            std::cerr << "    I                  show the histograms and the value of the pixel under the cursor\n";
+            std::cerr << "    F                  show the repaint timings and the texture bytes of the window\n";
+            std::cerr << "    L                  link all the windows to the focused one, or unlink them\n";
+            std::cerr << "    D                  show the difference with the first image of the linked windows\n";
+            std::cerr << "    [ ] and - =        lower/raise the threshold and the gain of the difference\n";
 
             return (arg_view == "--help" || arg_view == "-h") ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else {
+            image_paths.emplace_back(argv[i]);
+        }
+    }
+
+    // Batch exports never touch the display, so they run on servers without one
+    if (options.export_images) {
+        SDLit::init(0, IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_WEBP);
+        auto const export_paths = expandDirectories(image_paths);
+        if (export_paths.empty()) {
+            std::cerr << "No images to export\n";
+            return EXIT_FAILURE;
+        }
+
+        std::size_t const failure_count = exportImages(export_paths, options.export_options);
+        if (not Trace::write()) {
+            std::cerr << "Failed to write trace: " << SDL_GetError() << '\n';
+        }
+        return failure_count == 0U ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Handing the paths over is only worth it before paying for the initialization of SDL and the dialogs
+    auto const socket_path = InstanceServer::defaultSocketPath();
+    if (options.single_instance && not image_paths.empty() && InstanceServer::forward(socket_path, image_paths)) {
+        return EXIT_SUCCESS;
+    }
+
+    {
+        TRACE_SCOPE("preamble", nullptr);
+        RET_FAIL_IF_FALSE(preamble());
+    }
+
+    if (options.fit_decode) {
+        // Large enough for a window maximized on any of the displays
+        SDL_Point decode_size_limit{};
+        for (int display_index = 0; display_index < SDL_GetNumVideoDisplays(); ++display_index) {
+            SDL_DisplayMode display_mode{};
+            if (SDL_GetDesktopDisplayMode(display_index, &display_mode) == 0) {
+                decode_size_limit.x = std::max(decode_size_limit.x, display_mode.w);
+                decode_size_limit.y = std::max(decode_size_limit.y, display_mode.h);
+            }
+        }
+        setDecodeSizeLimit(decode_size_limit);
+    }
+
+    if (options.disk_cache) {
+        std::unique_ptr<char, decltype(&SDL_free)> pref_path{SDL_GetPrefPath("Miliox", "imgv2"), SDL_free};
+        if (not pref_path || not DiskCache::shared().enable(std::filesystem::path{pref_path.get()} / "cache",
+                                                            options.disk_cache_size * 1024U * 1024U)) {
+            std::cerr << "Disk cache is disabled: " << SDL_GetError() << '\n';
         }
     }
-    RET_FAIL_IF_FALSE(preamble());
 
     std::uint32_t const menu_user_event_id{SDL_RegisterEvents(1)};
     if (menu_user_event_id == 0xFFFFFFFF) {
@@ -39,48 +237,144 @@ int main(int argc, char** argv) {
     }
     NativeWindow_customizeApplicationMenu(menu_user_event_id);
 
+    std::uint32_t const loaded_user_event_id{ImageViewer::loadedEventType()};
+    if (loaded_user_event_id == 0xFFFFFFFF) {
+        std::cerr << "There is no space for user events in sdl";
+        return EXIT_FAILURE;
+    }
+
+    // Only wake the event loop up, the viewers and the grid pick the decoded frames, thumbnails, histograms and
+    // differences when they update
+    if (AnimationPlayer::frameDecodedEventType() == 0xFFFFFFFF || ThumbnailGrid::thumbnailEventType() == 0xFFFFFFFF ||
+        ImageInspector::histogramEventType() == 0xFFFFFFFF || ImageViewer::differenceEventType() == 0xFFFFFFFF) {
+        std::cerr << "There is no space for user events in sdl";
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<FileWatcher> file_watcher{};
+    if (options.watch) {
+        std::uint32_t const file_changed_event_id{SDL_RegisterEvents(1)};
+        if (file_changed_event_id != 0xFFFFFFFF) {
+            file_watcher = FileWatcher::create(file_changed_event_id);
+        }
+        if (not file_watcher) {
+            std::cerr << "Watch mode is disabled: " << SDL_GetError() << '\n';
+        }
+
+        // Watched files are rewritten while they are decoded, a mapping would turn a truncated file into a SIGBUS
+        // instead of a failed decode that keeps the previous version
+        MappedFile::setMappingAllowed(not file_watcher);
+    }
+
+    std::unique_ptr<InstanceServer> instance_server{};
+    if (options.single_instance) {
+        instance_server = InstanceServer::listen(socket_path);
+        if (not instance_server) {
+            std::cerr << "Single instance mode is disabled: " << SDL_GetError() << '\n';
+        }
+    }
+
     ImageViewerMap image_viewer_map{};
+    std::unique_ptr<ThumbnailGrid> thumbnail_grid{};
     {
-        ImagePaths image_paths{};
-        for (int i = 1; i < argc; ++i) {
-            image_paths.emplace_back(argv[i]);
-        }
         if (image_paths.empty()) {
             image_paths = pickImageDialog();
         }
 
-        openImages(image_viewer_map, image_paths);
-        RET_FAIL_IF_EMPTY(image_viewer_map);
+        if (options.grid) {
+            thumbnail_grid = ThumbnailGrid::open(expandDirectories(image_paths));
+            RET_FAIL_IF_NULL(thumbnail_grid);
+        } else {
+            openImages(image_viewer_map, image_paths, options);
+            RET_FAIL_IF_EMPTY(image_viewer_map);
+        }
+
+        // The window of the first image leads, the others are compared with it
+        if (options.compare && not image_viewer_map.empty()) {
+            auto it = std::find_if(image_viewer_map.begin(), image_viewer_map.end(), [&image_paths](auto const& it) {
+                return not image_paths.empty() && it.second->imagePath() == image_paths.front();
+            });
+            if (it == image_viewer_map.end()) {
+                it = image_viewer_map.begin();
+            }
+            toggleCompare(image_viewer_map, it->second.get());
+        }
     }
     auto const initialization_completed_timestamp = std::chrono::steady_clock().now();
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "initialization took %lf seconds",
+    Trace::record("initialization", nullptr, initialization_startup_timestamp, initialization_completed_timestamp);
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "initialization took %lf seconds (%zu images, %zu decode threads)",
                 std::chrono::duration_cast<std::chrono::duration<double>>(initialization_completed_timestamp -
                                                                           initialization_startup_timestamp)
-                    .count());
+                    .count(),
+                image_viewer_map.size(), WorkerPool::shared().size());
+
+    StatsDump stats_dump{};
+    if (options.stats_interval > 0U || not options.stats_path.empty()) {
+        stats_dump.interval = std::chrono::seconds{options.stats_interval > 0U ? options.stats_interval : 10U};
+        stats_dump.last_dump = std::chrono::steady_clock::now();
+        stats_dump.totals = FrameStats::totals();
+        if (not options.stats_path.empty()) {
+            stats_dump.file.open(options.stats_path, std::ios::app);
+            if (not stats_dump.file) {
+                std::cerr << "Failed to open " << options.stats_path << ", the stats go to stderr\n";
+            }
+        }
+    }
 
     // Repaint inside the eventMonitor because SDL_PollEvent only emits SDL_WINDOWEVENT_SIZE_CHANGED at the end of
     // resizing operation. This allows the image to be responsive during the resizing.
     SDL_AddEventWatch(eventMonitor, &image_viewer_map);
 
+    // The grid has a window of its own, its events are handed to it before looking for a viewer
+    auto const is_grid_window = [&thumbnail_grid](std::uint32_t window_id) {
+        return thumbnail_grid && window_id == SDL_GetWindowID(thumbnail_grid->window());
+    };
+
     SDL_Event event{};
-    while (not image_viewer_map.empty()) {
-        while (SDL_PollEvent(&event)) {
+    while (not image_viewer_map.empty() || thumbnail_grid) {
+        // Sleep until an event arrives, a pending repaint or the stats are due, then drain the queue before repainting
+        auto const next_dump_time = stats_dump.interval.count() > 0
+                                        ? std::optional{stats_dump.last_dump + stats_dump.interval}
+                                        : std::nullopt;
+        for (bool has_event = waitEvent(image_viewer_map, thumbnail_grid.get(), next_dump_time, event); has_event;
+             has_event = SDL_PollEvent(&event)) {
+            // The timestamps of SDL are in milliseconds, enough to tell a responsive loop from a stalled one
+            FrameStats::count(FrameStats::kEvents);
+            FrameStats::time(FrameStats::kEventLatency,
+                             std::chrono::milliseconds{SDL_GetTicks() - event.common.timestamp});
+
             switch (event.type) {
                 case SDL_QUIT: {
                     image_viewer_map.clear();
+                    thumbnail_grid.reset();
                     break;
                 }
                 case SDL_WINDOWEVENT: {
-                    if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                    if (is_grid_window(event.window.windowID)) {
+                        if (event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+                            event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                            thumbnail_grid->invalidate();
+                        } else if (event.window.event == SDL_WINDOWEVENT_CLOSE) {
+                            thumbnail_grid.reset();
+                        }
+                    } else if (event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+                               event.window.event == SDL_WINDOWEVENT_SHOWN ||
+                               event.window.event == SDL_WINDOWEVENT_RESTORED) {
                         auto it = image_viewer_map.find(event.window.windowID);
                         if (it != image_viewer_map.end()) {
-                            it->second->repaint();
+                            TextureBudget::shared().expose(it->second.get());
+                            it->second->invalidate();
                         }
                     } else if (event.window.event == SDL_WINDOWEVENT_MOVED) {
                         auto it = image_viewer_map.find(event.window.windowID);
                         if (it != image_viewer_map.end()) {
                             it->second->customizeTitlebar();
                         }
+                    } else if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
+                        auto it = image_viewer_map.find(event.window.windowID);
+                        if (it != image_viewer_map.end()) {
+                            TextureBudget::shared().touch(it->second.get());
+                        }
                     } else if (event.window.event == SDL_WINDOWEVENT_CLOSE) {
                         auto it = image_viewer_map.find(event.window.windowID);
                         if (it != image_viewer_map.end()) {
@@ -90,6 +384,15 @@ int main(int argc, char** argv) {
                     break;
                 }
                 case SDL_KEYDOWN: {
+                    if (is_grid_window(event.key.windowID)) {
+                        if (event.key.keysym.sym == SDLK_ESCAPE) {
+                            thumbnail_grid.reset();
+                        } else if (auto image_path = thumbnail_grid->processKeyboardEvent(event.key)) {
+                            openImages(image_viewer_map, ImagePaths{*image_path}, options);
+                        }
+                        break;
+                    }
+
                     if (event.key.keysym.sym == SDLK_ESCAPE) {
                         auto it = image_viewer_map.find(event.key.windowID);
                         if (it != image_viewer_map.end()) {
@@ -97,10 +400,32 @@ int main(int argc, char** argv) {
                         }
                         break;
                     }
+
+                    if (event.key.keysym.sym == SDLK_w && (event.key.keysym.mod & KMOD_CTRL)) {
+                        auto it = image_viewer_map.find(event.key.windowID);
+                        if (it != image_viewer_map.end() && not it->second->closeTab()) {
+                            image_viewer_map.erase(it);
+                        }
+                        break;
+                    }
+
+                    auto it = image_viewer_map.find(event.key.windowID);
+                    if (it != image_viewer_map.end() && event.key.keysym.sym == SDLK_l) {
+                        toggleCompare(image_viewer_map, it->second.get());
+                    } else if (it != image_viewer_map.end()) {
+                        it->second->processKeyboardEvent(event.key);
+                    }
                     break;
                 }
                 case SDL_MOUSEBUTTONDOWN:
                 case SDL_MOUSEBUTTONUP: {
+                    if (is_grid_window(event.button.windowID)) {
+                        if (auto image_path = thumbnail_grid->processMouseButtonEvent(event.button)) {
+                            openImages(image_viewer_map, ImagePaths{*image_path}, options);
+                        }
+                        break;
+                    }
+
                     auto it = image_viewer_map.find(event.button.windowID);
                     if (it != image_viewer_map.end()) {
                         it->second->processMouseButtonEvent(event.button);
@@ -108,6 +433,11 @@ int main(int argc, char** argv) {
                     break;
                 }
                 case SDL_MOUSEWHEEL: {
+                    if (is_grid_window(event.wheel.windowID)) {
+                        thumbnail_grid->processMouseWheelEvent(event.wheel);
+                        break;
+                    }
+
                     auto it = image_viewer_map.find(event.wheel.windowID);
                     if (it != image_viewer_map.end()) {
                         it->second->processMouseWheelEvent(event.wheel);
@@ -115,12 +445,26 @@ int main(int argc, char** argv) {
                     break;
                 }
                 case SDL_DROPFILE: {
-                    openImages(image_viewer_map, ImagePaths{{event.drop.file}});
+                    openImages(image_viewer_map, ImagePaths{{event.drop.file}}, options);
+                    SDL_free(event.drop.file);
                     break;
                 }
                 default: {
-                    if (event.type == menu_user_event_id && event.user.code == MENU_OPEN_FILE_ACTION) {
-                        openImages(image_viewer_map, pickImageDialog());
+                    if (event.type == loaded_user_event_id) {
+                        auto it = image_viewer_map.find(event.user.windowID);
+                        if (it != image_viewer_map.end() && not it->second->processLoadedEvent(event.user)) {
+                            std::cerr << "Failed to load image: " << SDL_GetError() << '\n';
+                            image_viewer_map.erase(it);
+                        }
+                    } else if (file_watcher && event.type == file_watcher->eventType()) {
+                        for (auto const& change : file_watcher->takeChanges()) {
+                            auto it = image_viewer_map.find(change.window_id);
+                            if (it != image_viewer_map.end()) {
+                                it->second->reload(change.changed_at);
+                            }
+                        }
+                    } else if (event.type == menu_user_event_id && event.user.code == MENU_OPEN_FILE_ACTION) {
+                        openImages(image_viewer_map, pickImageDialog(), options);
                     } else if (event.type == menu_user_event_id &&
                                (event.user.code == MENU_EDIT_FLIP_HORIZONTAL_ACTION ||
                                 event.user.code == MENU_EDIT_FLIP_VERTICAL_ACTION)) {
@@ -147,22 +491,170 @@ int main(int argc, char** argv) {
                 }
             }
         }
-        SDL_Delay(1'000U / 60U);
+
+        // Coalesced repaints, each window presents at most once per display refresh
+        for (auto& [window_id, image_viewer] : image_viewer_map) {
+            image_viewer->update();
+        }
+        if (thumbnail_grid) {
+            thumbnail_grid->update();
+        }
+
+        // Windows out of focus give their textures back when together they exceed the budget
+        TextureBudget::shared().enforce();
+
+        if (next_dump_time && std::chrono::steady_clock::now() >= *next_dump_time) {
+            dumpStats(image_viewer_map, stats_dump);
+        }
+
+        // Follow the windows as they are opened, closed or moved on to another image
+        if (file_watcher) {
+            std::vector<std::pair<std::uint32_t, std::filesystem::path>> watched_files{};
+            for (auto const& [window_id, image_viewer] : image_viewer_map) {
+                watched_files.emplace_back(window_id, image_viewer->imagePath());
+            }
+            file_watcher->setWatchedFiles(watched_files);
+        }
     }
 
     SDL_DelEventWatch(eventMonitor, &image_viewer_map);
 
+    // The last period is cut short by the exit, its windows are already closed
+    if (stats_dump.interval.count() > 0) {
+        dumpStats(image_viewer_map, stats_dump);
+    }
+
+    if (not Trace::write()) {
+        std::cerr << "Failed to write trace: " << SDL_GetError() << '\n';
+    }
     return 0;
 }
 
+bool parseOptionValue(std::string_view arg, std::string_view option, std::size_t& value) noexcept {
+    if (not arg.starts_with(option)) {
+        return false;
+    }
+
+    arg.remove_prefix(option.size());
+    auto const result = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    return result.ec == std::errc{} && result.ptr == arg.data() + arg.size();
+}
+
+ImagePaths expandDirectories(ImagePaths const& image_paths) noexcept {
+    // Directories stand for the images they hold, listing them is the only disk access before the work starts
+    ImagePaths expanded_paths{};
+    for (auto const& image_path : image_paths) {
+        std::error_code error{};
+        if (std::filesystem::is_directory(image_path, error)) {
+            auto directory_images = listDirectoryImages(image_path);
+            expanded_paths.insert(expanded_paths.end(), std::make_move_iterator(directory_images.begin()),
+                                  std::make_move_iterator(directory_images.end()));
+        } else {
+            expanded_paths.push_back(image_path);
+        }
+    }
+    return expanded_paths;
+}
+
+bool parseSizeValue(std::string_view arg, std::string_view option, SDL_Point& size) noexcept {
+    if (not arg.starts_with(option)) {
+        return false;
+    }
+
+    arg.remove_prefix(option.size());
+    auto const separator = arg.find('x');
+    std::size_t width{};
+    std::size_t height{};
+    if (separator == std::string_view::npos || not parseOptionValue(arg.substr(0, separator), "", width) ||
+        not parseOptionValue(arg.substr(separator + 1U), "", height) || width == 0U || height == 0U ||
+        width > 65536U || height > 65536U) {
+        return false;
+    }
+    size = SDL_Point{static_cast<int>(width), static_cast<int>(height)};
+    return true;
+}
+
+bool waitEvent(ImageViewerMap const& image_viewer_map, ThumbnailGrid const* thumbnail_grid,
+               std::optional<std::chrono::steady_clock::time_point> next_update_time, SDL_Event& event) noexcept {
+    if (auto const grid_update_time = thumbnail_grid != nullptr ? thumbnail_grid->nextUpdateTime() : std::nullopt) {
+        if (not next_update_time || *grid_update_time < *next_update_time) {
+            next_update_time = grid_update_time;
+        }
+    }
+    for (auto const& [window_id, image_viewer] : image_viewer_map) {
+        auto const viewer_update_time = image_viewer->nextUpdateTime();
+        if (viewer_update_time && (not next_update_time || *viewer_update_time < *next_update_time)) {
+            next_update_time = viewer_update_time;
+        }
+    }
+
+    // Nothing to repaint, block until something happens
+    if (not next_update_time) {
+        return SDL_WaitEvent(&event) == 1;
+    }
+
+    auto const timeout =
+        std::chrono::ceil<std::chrono::milliseconds>(*next_update_time - std::chrono::steady_clock::now());
+    if (timeout.count() <= 0) {
+        return SDL_PollEvent(&event) == 1;
+    }
+    return SDL_WaitEventTimeout(&event, static_cast<int>(timeout.count())) == 1;
+}
+
+void dumpStats(ImageViewerMap const& image_viewer_map, StatsDump& stats_dump) noexcept {
+    auto const now = std::chrono::steady_clock::now();
+    FrameStats::Totals totals = FrameStats::totals();
+    FrameStats::Totals period_totals = totals;
+    period_totals -= stats_dump.totals;
+    double const seconds = std::chrono::duration<double>(now - stats_dump.last_dump).count();
+    stats_dump.totals = std::move(totals);
+    stats_dump.last_dump = now;
+
+    std::ostream& out = stats_dump.file.is_open() ? static_cast<std::ostream&>(stats_dump.file) : std::cerr;
+    std::size_t texture_bytes{};
+    for (auto const& [window_id, image_viewer] : image_viewer_map) {
+        texture_bytes += image_viewer->textureBytes();
+    }
+    out << "stats over " << seconds << " s: " << period_totals.counters[FrameStats::kEvents] << " events, latency "
+        << period_totals.timings[FrameStats::kEventLatency].summary() << "; "
+        << period_totals.counters[FrameStats::kResizeRepaints] << " resize repaints; "
+        << period_totals.counters[FrameStats::kLoads] << " loads, "
+        << period_totals.timings[FrameStats::kLoadTime].summary() << "; " << texture_bytes / 1024U
+        << " KB of textures in " << image_viewer_map.size() << " windows\n";
+
+    // Windows opened during the period count from zero, those closed are forgotten
+    std::unordered_map<std::uint32_t, WindowFrameStats> window_stats{};
+    for (auto const& [window_id, image_viewer] : image_viewer_map) {
+        WindowFrameStats period_stats = image_viewer->frameStats();
+        if (auto it = stats_dump.window_stats.find(window_id); it != stats_dump.window_stats.end()) {
+            period_stats -= it->second;
+        }
+        window_stats.emplace(window_id, image_viewer->frameStats());
+
+        out << "  window " << window_id << " " << image_viewer->imagePath().filename().string() << ": "
+            << period_stats.repaints << " repaints, repaint " << period_stats.repaint.summary() << ", render "
+            << period_stats.render.summary() << ", present " << period_stats.present.summary() << ", "
+            << image_viewer->textureBytes() / 1024U << " KB of textures\n";
+    }
+    stats_dump.window_stats = std::move(window_stats);
+    out.flush();
+}
+
 int eventMonitor(void* context, SDL_Event* event) noexcept {
-    // Refresh while resizing window
+    // Refresh while resizing window, SDL_PollEvent only sees the end of the resize on some platforms
     if (event->type == SDL_WINDOWEVENT && event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
         if (context != nullptr) {
             ImageViewerMap* image_viewer_map = static_cast<ImageViewerMap*>(context);
             auto it = image_viewer_map->find(event->window.windowID);
             if (it != image_viewer_map->end()) {
-                it->second->repaint();
+                it->second->invalidate();
+            }
+
+            // The event loop may be stuck in the resize, animations of the other windows keep playing from here
+            for (auto& [window_id, image_viewer] : *image_viewer_map) {
+                if (image_viewer->update()) {
+                    FrameStats::count(FrameStats::kResizeRepaints);
+                }
             }
         }
     } else if (event->type == SDL_MOUSEMOTION) {
@@ -177,14 +669,123 @@ int eventMonitor(void* context, SDL_Event* event) noexcept {
     return 1;
 }
 
-void openImages(ImageViewerMap& image_viewer_map, ImagePaths const& image_paths) noexcept {
-    for (auto const& image_path : image_paths) {
-        auto image_viewer = ImageViewer::open(image_path);
+void toggleCompare(ImageViewerMap& image_viewer_map, ImageViewer* leader) noexcept {
+    if (leader->compareGroup()) {
+        for (auto& [window_id, image_viewer] : image_viewer_map) {
+            image_viewer->link(nullptr);
+        }
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Unlinked the windows");
+        return;
+    }
+
+    // The leader joins first, it is the reference image of all the others
+    auto compare_group = std::make_shared<CompareGroup>();
+    leader->link(compare_group);
+    for (auto& [window_id, image_viewer] : image_viewer_map) {
+        if (image_viewer.get() != leader) {
+            image_viewer->link(compare_group);
+        }
+    }
+    compare_group->followView(leader);
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Linked %zu windows to %s", compare_group->imageViewers().size(),
+                leader->imagePath().c_str());
+}
+
+void openImages(ImageViewerMap& image_viewer_map, ImagePaths const& image_paths, Options const& options) noexcept {
+    // A single window and renderer for all the images, only the image of the tab shown is decoded and uploaded
+    if (options.tabs) {
+        ImagePaths const tab_paths = expandDirectories(image_paths);
+        if (not image_viewer_map.empty()) {
+            auto& image_viewer = image_viewer_map.begin()->second;
+            std::size_t const first_tab = std::max<std::size_t>(image_viewer->tabCount(), 1U);
+            image_viewer->addTabs(tab_paths);
+            image_viewer->showTab(first_tab);
+            image_viewer->focus();
+            return;
+        }
+
+        // The first image that opens becomes the first tab, the ones before it are left out like in windowed mode
+        std::unique_ptr<ImageViewer> image_viewer{};
+        auto tab_path = tab_paths.begin();
+        for (; tab_path != tab_paths.end() && not image_viewer; ++tab_path) {
+            image_viewer = options.async_loading ? ImageViewer::openAsync(*tab_path) : ImageViewer::open(*tab_path);
+            if (not image_viewer) {
+                std::cerr << "Failed to open '" << *tab_path << "': " << SDL_GetError() << '\n';
+            }
+        }
+        if (image_viewer) {
+            image_viewer->addTabs(ImagePaths{tab_path, tab_paths.end()});
+            image_viewer_map[SDL_GetWindowID(image_viewer->window())] = std::move(image_viewer);
+        }
+        return;
+    }
+
+    auto const open_async = [&image_viewer_map](std::filesystem::path const& image_path) {
+        auto image_viewer = ImageViewer::openAsync(image_path);
         if (image_viewer) {
             image_viewer_map[SDL_GetWindowID(image_viewer->window())] = std::move(image_viewer);
         } else {
             std::cerr << "Failed to open '" << image_path << "': " << SDL_GetError() << '\n';
         }
+    };
+
+    if (options.async_loading) {
+        for (auto const& image_path : image_paths) {
+            open_async(image_path);
+        }
+        return;
+    }
+
+    struct DecodedImage {
+        std::filesystem::path const& path;
+        SurfacePtr surface;
+        std::string error;
+    };
+
+    std::mutex decoded_mutex{};
+    std::condition_variable decoded_condition{};
+    std::deque<DecodedImage> decoded_images{};
+
+    // Decoding is the expensive part of opening an image, spread it over the worker pool while the main thread
+    // takes care of windows, renderers and textures which must be created on the thread that owns the event loop.
+    // Large images with a progressive decoder get their window right away instead, and fill it in as they decode.
+    std::size_t decoding_images = 0;
+    for (auto const& image_path : image_paths) {
+        if (decodesProgressively(image_path)) {
+            open_async(image_path);
+            continue;
+        }
+
+        ++decoding_images;
+        WorkerPool::shared().submit([&image_path, &decoded_mutex, &decoded_condition, &decoded_images] {
+            auto image_surface = loadImage(image_path);
+            std::string error = image_surface ? std::string{} : std::string{SDL_GetError()};
+            {
+                std::lock_guard lock{decoded_mutex};
+                decoded_images.push_back({image_path, std::move(image_surface), std::move(error)});
+            }
+            decoded_condition.notify_one();
+        });
+    }
+
+    for (std::size_t pending_images = decoding_images; pending_images > 0; --pending_images) {
+        std::unique_lock lock{decoded_mutex};
+        decoded_condition.wait(lock, [&decoded_images] { return not decoded_images.empty(); });
+        DecodedImage decoded_image = std::move(decoded_images.front());
+        decoded_images.pop_front();
+        lock.unlock();
+
+        if (not decoded_image.surface) {
+            std::cerr << "Failed to open '" << decoded_image.path << "': " << decoded_image.error << '\n';
+            continue;
+        }
+
+        auto image_viewer = ImageViewer::open(decoded_image.path, std::move(decoded_image.surface));
+        if (image_viewer) {
+            image_viewer_map[SDL_GetWindowID(image_viewer->window())] = std::move(image_viewer);
+        } else {
+            std::cerr << "Failed to open '" << decoded_image.path << "': " << SDL_GetError() << '\n';
+        }
     }
 }
 
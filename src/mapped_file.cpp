@@ -0,0 +1,118 @@
+#include "mapped_file.hpp"
+
+#include <atomic>
+#include <utility>
+
+#include "SDLit.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IMGV2_MAPPED_FILE_MMAP 1
+#else
+#define IMGV2_MAPPED_FILE_MMAP 0
+#endif
+
+namespace {
+
+/// SDL_RWFromConstMem takes an int size
+constexpr std::size_t kMaxSize = static_cast<std::size_t>(SDL_MAX_SINT32);
+
+std::atomic_bool g_mapping_allowed{true};
+
+/// Read the stream until its end, for files whose size is not known upfront
+bool readAll(std::filesystem::path const& file_path, std::vector<std::uint8_t>& bytes) noexcept {
+    auto rw = SDLit::make_unique(SDL_RWFromFile, file_path.c_str(), "rb");
+    if (not rw) {
+        return false;
+    }
+
+    std::size_t read_size = 0;
+    for (;;) {
+        if (bytes.size() - read_size < 64U * 1024U) {
+            bytes.resize(bytes.size() + 1024U * 1024U);
+        }
+
+        std::size_t const chunk_size = SDL_RWread(rw.get(), bytes.data() + read_size, 1, bytes.size() - read_size);
+        if (chunk_size == 0) {
+            break;
+        }
+        read_size += chunk_size;
+        if (read_size > kMaxSize) {
+            SDL_SetError("%s is too large to be read in memory", file_path.c_str());
+            return false;
+        }
+    }
+
+    bytes.resize(read_size);
+    return true;
+}
+
+}  // namespace
+
+std::unique_ptr<MappedFile> MappedFile::open(std::filesystem::path const& file_path) noexcept {
+#if IMGV2_MAPPED_FILE_MMAP
+    if (g_mapping_allowed.load(std::memory_order_relaxed)) {
+        int const fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            SDL_SetError("failed to open %s", file_path.c_str());
+            return {nullptr};
+        }
+
+        // Only regular files have a stable size to map, everything else is read until the end
+        struct stat file_stat {};
+        if (::fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+            auto const mapping_size = static_cast<std::size_t>(file_stat.st_size);
+            if (mapping_size > kMaxSize) {
+                ::close(fd);
+                SDL_SetError("%s is too large to be mapped", file_path.c_str());
+                return {nullptr};
+            }
+
+            void* mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapping != MAP_FAILED) {
+                // Decoders walk the file front to back, read ahead aggressively and start right away
+                ::madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+                ::madvise(mapping, mapping_size, MADV_WILLNEED);
+                return std::unique_ptr<MappedFile>{new MappedFile{mapping, mapping_size, {}}};
+            }
+        } else {
+            ::close(fd);
+        }
+    }
+#endif
+
+    std::vector<std::uint8_t> bytes{};
+    if (not readAll(file_path, bytes)) {
+        return {nullptr};
+    }
+    return std::unique_ptr<MappedFile>{new MappedFile{nullptr, 0U, std::move(bytes)}};
+}
+
+void MappedFile::setMappingAllowed(bool allowed) noexcept {
+    g_mapping_allowed.store(allowed, std::memory_order_relaxed);
+}
+
+MappedFile::MappedFile(void* mapping, std::size_t mapping_size, std::vector<std::uint8_t> bytes) noexcept
+    : m_mapping(mapping), m_mapping_size(mapping_size), m_bytes(std::move(bytes)) {}
+
+MappedFile::~MappedFile() noexcept {
+#if IMGV2_MAPPED_FILE_MMAP
+    if (m_mapping != nullptr) {
+        ::munmap(m_mapping, m_mapping_size);
+    }
+#endif
+}
+
+std::uint8_t const* MappedFile::data() const noexcept {
+    return m_mapping != nullptr ? static_cast<std::uint8_t const*>(m_mapping) : m_bytes.data();
+}
+
+std::size_t MappedFile::size() const noexcept { return m_mapping != nullptr ? m_mapping_size : m_bytes.size(); }
+
+bool MappedFile::mapped() const noexcept { return m_mapping != nullptr; }
+
+SDL_RWops* MappedFile::rwops() const noexcept { return SDL_RWFromConstMem(data(), static_cast<int>(size())); }
@@ -0,0 +1,98 @@
+#include "mipmap.hpp"
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMGV2_MIPMAP_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMGV2_MIPMAP_NEON 1
+#endif
+
+namespace {
+
+/// Average 2x2 blocks of the top and bottom rows into width output pixels, returns how many were done
+int downsampleRowVectorized(std::uint8_t const* top, std::uint8_t const* bottom, std::uint8_t* output,
+                            int const width) noexcept {
+    int x = 0;
+#if IMGV2_MIPMAP_SSE2
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const rounding = _mm_set1_epi16(2);
+    for (; x + 4 <= width; x += 4) {
+        // 8 source pixels per row become 4 output pixels
+        __m128i const top_left = _mm_loadu_si128(reinterpret_cast<__m128i const*>(top + x * 8));
+        __m128i const top_right = _mm_loadu_si128(reinterpret_cast<__m128i const*>(top + x * 8 + 16));
+        __m128i const bottom_left = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bottom + x * 8));
+        __m128i const bottom_right = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bottom + x * 8 + 16));
+
+        // Vertical sums in 16 bits, two source pixels per register
+        __m128i const sum0 = _mm_add_epi16(_mm_unpacklo_epi8(top_left, zero), _mm_unpacklo_epi8(bottom_left, zero));
+        __m128i const sum1 = _mm_add_epi16(_mm_unpackhi_epi8(top_left, zero), _mm_unpackhi_epi8(bottom_left, zero));
+        __m128i const sum2 = _mm_add_epi16(_mm_unpacklo_epi8(top_right, zero), _mm_unpacklo_epi8(bottom_right, zero));
+        __m128i const sum3 = _mm_add_epi16(_mm_unpackhi_epi8(top_right, zero), _mm_unpackhi_epi8(bottom_right, zero));
+
+        // Horizontal sums, the low half of each register ends up with one output pixel
+        __m128i const pixel0 = _mm_add_epi16(sum0, _mm_srli_si128(sum0, 8));
+        __m128i const pixel1 = _mm_add_epi16(sum1, _mm_srli_si128(sum1, 8));
+        __m128i const pixel2 = _mm_add_epi16(sum2, _mm_srli_si128(sum2, 8));
+        __m128i const pixel3 = _mm_add_epi16(sum3, _mm_srli_si128(sum3, 8));
+
+        __m128i const pixels01 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(pixel0, pixel1), rounding), 2);
+        __m128i const pixels23 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(pixel2, pixel3), rounding), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x * 4), _mm_packus_epi16(pixels01, pixels23));
+    }
+#elif IMGV2_MIPMAP_NEON
+    for (; x + 8 <= width; x += 8) {
+        // 16 source pixels per row, deinterleaved by channel, become 8 output pixels
+        uint8x16x4_t const top_pixels = vld4q_u8(top + x * 8);
+        uint8x16x4_t const bottom_pixels = vld4q_u8(bottom + x * 8);
+        uint8x8x4_t output_pixels{};
+        for (int channel = 0; channel < 4; ++channel) {
+            uint16x8_t const sum =
+                vaddq_u16(vpaddlq_u8(top_pixels.val[channel]), vpaddlq_u8(bottom_pixels.val[channel]));
+            output_pixels.val[channel] = vrshrn_n_u16(sum, 2);
+        }
+        vst4_u8(output + x * 4, output_pixels);
+    }
+#endif
+    return x;
+}
+
+}  // namespace
+
+SurfacePtr downsampleSurface(SDL_Surface const* surface) noexcept {
+    if (surface == nullptr || surface->format->BytesPerPixel != 4) {
+        SDL_SetError("only 32 bits per pixel surfaces can be downsampled");
+        return {nullptr};
+    }
+
+    int const width = surface->w > 1 ? surface->w / 2 : 1;
+    int const height = surface->h > 1 ? surface->h / 2 : 1;
+    auto downsampled = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, width, height, 32,
+                                          surface->format->format);
+    if (not downsampled) {
+        return {nullptr};
+    }
+
+    auto const* source_pixels = static_cast<std::uint8_t const*>(surface->pixels);
+    auto* output_pixels = static_cast<std::uint8_t*>(downsampled->pixels);
+    for (int y = 0; y < height; ++y) {
+        // Single pixel rows and columns are averaged with themselves
+        std::uint8_t const* top = source_pixels + (2 * y) * surface->pitch;
+        std::uint8_t const* bottom = surface->h > 1 ? top + surface->pitch : top;
+        std::uint8_t* output = output_pixels + y * downsampled->pitch;
+
+        int x = surface->w > 1 ? downsampleRowVectorized(top, bottom, output, width) : 0;
+        for (; x < width; ++x) {
+            int const right = surface->w > 1 ? 4 : 0;
+            for (int channel = 0; channel < 4; ++channel) {
+                int const sum = top[x * 8 + channel] + top[x * 8 + right + channel] + bottom[x * 8 + channel] +
+                                bottom[x * 8 + right + channel];
+                output[x * 4 + channel] = static_cast<std::uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+
+    return downsampled;
+}
@@ -0,0 +1,13 @@
+#include "native_window.h"
+
+// Platforms without native customizations keep the stock SDL windows and menus
+
+void NativeWindow_customizeTitleBar(struct SDL_SysWMinfo*) {}
+
+void NativeWindow_customizeApplicationMenu(uint32_t const) {}
+
+void NativeWindow_customizeWindowMenu(struct SDL_SysWMinfo*, uint32_t const) {}
+
+void* NativeWindow_getHandle(struct SDL_SysWMinfo*) { return nullptr; }
+
+void NativeWindow_maximize(struct SDL_SysWMinfo*) {}
@@ -0,0 +1,63 @@
+#include "overlay_text.hpp"
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr int kGlyphWidth = 3;
+constexpr int kGlyphHeight = 5;
+
+/// Characters of the font and their glyphs, rows from top to bottom with the leftmost pixel first
+constexpr std::string_view kGlyphCharacters{"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.-+/:%"};
+constexpr std::array<std::uint16_t, kGlyphCharacters.size()> kGlyphs{
+    0b111'101'101'101'111, 0b010'110'010'010'111, 0b111'001'111'100'111, 0b111'001'111'001'111,  // 0-3
+    0b101'101'111'001'001, 0b111'100'111'001'111, 0b111'100'111'101'111, 0b111'001'001'001'001,  // 4-7
+    0b111'101'111'101'111, 0b111'101'111'001'111, 0b010'101'111'101'101, 0b110'101'110'101'110,  // 8-B
+    0b011'100'100'100'011, 0b110'101'101'101'110, 0b111'100'110'100'111, 0b111'100'110'100'100,  // C-F
+    0b011'100'101'101'011, 0b101'101'111'101'101, 0b111'010'010'010'111, 0b001'001'001'101'010,  // G-J
+    0b101'101'110'101'101, 0b100'100'100'100'111, 0b101'111'111'101'101, 0b110'101'101'101'101,  // K-N
+    0b010'101'101'101'010, 0b110'101'110'100'100, 0b010'101'101'110'011, 0b110'101'110'101'101,  // O-R
+    0b011'100'010'001'110, 0b111'010'010'010'010, 0b101'101'101'101'111, 0b101'101'101'101'010,  // S-V
+    0b101'101'111'111'101, 0b101'101'010'101'101, 0b101'101'010'010'010, 0b111'001'010'100'111,  // W-Z
+    0b000'000'000'000'010, 0b000'000'111'000'000, 0b000'010'111'010'000, 0b001'001'010'100'100,  // . - + /
+    0b000'010'000'010'000, 0b101'001'010'100'101,                                                // : %
+};
+
+/// Blank for spaces and characters without a glyph
+std::uint16_t glyph(char c) noexcept {
+    auto const index = kGlyphCharacters.find(static_cast<char>(std::toupper(static_cast<unsigned char>(c))));
+    return index == std::string_view::npos ? std::uint16_t{0U} : kGlyphs[index];
+}
+
+}  // namespace
+
+SDL_FPoint textSize(std::string_view text, float pixel_size) noexcept {
+    if (text.empty()) {
+        return {0.0f, 0.0f};
+    }
+    // Glyphs are one pixel apart
+    return {static_cast<float>(text.size() * (kGlyphWidth + 1) - 1) * pixel_size,
+            static_cast<float>(kGlyphHeight) * pixel_size};
+}
+
+bool renderText(SDL_Renderer* renderer, std::string_view text, SDL_FPoint origin, float pixel_size) noexcept {
+    // Lit font pixels are drawn as squares, all in one call
+    std::vector<SDL_FRect> rects{};
+    for (std::size_t i = 0U; i < text.size(); ++i) {
+        std::uint16_t const bits = glyph(text[i]);
+        float const glyph_x = origin.x + static_cast<float>(i * (kGlyphWidth + 1)) * pixel_size;
+        for (int row = 0; row < kGlyphHeight; ++row) {
+            for (int column = 0; column < kGlyphWidth; ++column) {
+                int const bit = (kGlyphHeight - 1 - row) * kGlyphWidth + (kGlyphWidth - 1 - column);
+                if (bits & (1U << bit)) {
+                    rects.push_back({glyph_x + static_cast<float>(column) * pixel_size,
+                                     origin.y + static_cast<float>(row) * pixel_size, pixel_size, pixel_size});
+                }
+            }
+        }
+    }
+    return rects.empty() || SDL_RenderFillRectsF(renderer, rects.data(), static_cast<int>(rects.size())) == 0;
+}
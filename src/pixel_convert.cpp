@@ -0,0 +1,194 @@
+#include "pixel_convert.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMGV2_CONVERT_SSE2 1
+// SSSE3 is not part of the x86-64 baseline, GCC and Clang build its kernel anyway and pick it at runtime
+#if defined(__SSSE3__) || defined(__GNUC__)
+#include <tmmintrin.h>
+#define IMGV2_CONVERT_SSSE3 1
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMGV2_CONVERT_NEON 1
+#endif
+
+namespace {
+
+/// Swap the first and third bytes of every 32 bits pixel, RGBA32 <-> BGRA32, returns how many were done
+int swapRedBlueVectorized(std::uint8_t const* source, std::uint8_t* output, int const width) noexcept {
+    int x = 0;
+#if IMGV2_CONVERT_SSE2
+    __m128i const red_blue_mask = _mm_set1_epi32(0x00FF00FF);
+    for (; x + 4 <= width; x += 4) {
+        __m128i const pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + x * 4));
+        __m128i const green_alpha = _mm_andnot_si128(red_blue_mask, pixels);
+        __m128i const red_blue = _mm_and_si128(red_blue_mask, pixels);
+
+        // Rotating by 16 bits exchanges the two masked bytes of each pixel
+        __m128i const blue_red = _mm_or_si128(_mm_slli_epi32(red_blue, 16), _mm_srli_epi32(red_blue, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x * 4), _mm_or_si128(green_alpha, blue_red));
+    }
+#elif IMGV2_CONVERT_NEON
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t pixels = vld4q_u8(source + x * 4);
+        uint8x16_t const first = pixels.val[0];
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = first;
+        vst4q_u8(output + x * 4, pixels);
+    }
+#else
+    (void)source;
+    (void)output;
+    (void)width;
+#endif
+    return x;
+}
+
+#if IMGV2_CONVERT_SSSE3
+#if defined(__SSSE3__)
+#define IMGV2_SSSE3_TARGET
+#else
+#define IMGV2_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+
+bool hasSSSE3() noexcept {
+#if defined(__SSSE3__)
+    return true;
+#else
+    static bool const supported = __builtin_cpu_supports("ssse3");
+    return supported;
+#endif
+}
+
+IMGV2_SSSE3_TARGET int expandRGB24SSSE3(std::uint8_t const* source, std::uint8_t* output, int const width,
+                                        bool const swap_red_blue) noexcept {
+    int x = 0;
+    __m128i const shuffle = swap_red_blue ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                                          : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i const alpha = _mm_set1_epi32(static_cast<int>(0xFF000000U));
+    // Loads 16 bytes for 4 pixels (12 bytes), the last pixels are left to the scalar loop to stay in bounds
+    for (; x + 6 <= width; x += 4) {
+        __m128i const pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + x * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x * 4),
+                         _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+    }
+    return x;
+}
+#endif
+
+/// Expand 3 bytes pixels to 4 bytes with an opaque alpha, swapping the color order when swap_red_blue is set
+int expandRGB24Vectorized(std::uint8_t const* source, std::uint8_t* output, int const width,
+                          bool const swap_red_blue) noexcept {
+    int x = 0;
+#if IMGV2_CONVERT_SSSE3
+    if (hasSSSE3()) {
+        x = expandRGB24SSSE3(source, output, width, swap_red_blue);
+    }
+#elif IMGV2_CONVERT_NEON
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x3_t const pixels = vld3q_u8(source + x * 3);
+        uint8x16x4_t expanded{};
+        expanded.val[0] = swap_red_blue ? pixels.val[2] : pixels.val[0];
+        expanded.val[1] = pixels.val[1];
+        expanded.val[2] = swap_red_blue ? pixels.val[0] : pixels.val[2];
+        expanded.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(output + x * 4, expanded);
+    }
+#else
+    (void)source;
+    (void)output;
+    (void)width;
+    (void)swap_red_blue;
+#endif
+    return x;
+}
+
+}  // namespace
+
+bool convertPixels(SDL_Surface const* surface, SDL_Rect const& rect, Uint32 format, void* pixels, int pitch) noexcept {
+    if (surface == nullptr || pixels == nullptr) {
+        SDL_SetError("no pixels to convert");
+        return false;
+    }
+
+    Uint32 const source_format = surface->format->format;
+    int const source_bytes = surface->format->BytesPerPixel;
+    auto const* source = static_cast<std::uint8_t const*>(surface->pixels) + rect.y * surface->pitch +
+                         rect.x * source_bytes;
+    auto* output = static_cast<std::uint8_t*>(pixels);
+
+    if (source_format == format) {
+        auto const row_size = static_cast<std::size_t>(rect.w) * static_cast<std::size_t>(source_bytes);
+        for (int y = 0; y < rect.h; ++y) {
+            std::memcpy(output + y * pitch, source + y * surface->pitch, row_size);
+        }
+        return true;
+    }
+
+    // Byte order of the common decoder outputs, RGBA32 and BGRA32 alias the packed formats of this platform
+    bool const to_rgba = format == SDL_PIXELFORMAT_RGBA32;
+    bool const to_bgra = format == SDL_PIXELFORMAT_BGRA32;
+    bool const from_rgba = source_format == SDL_PIXELFORMAT_RGBA32;
+    bool const from_bgra = source_format == SDL_PIXELFORMAT_BGRA32;
+
+    if ((from_rgba && to_bgra) || (from_bgra && to_rgba)) {
+        for (int y = 0; y < rect.h; ++y) {
+            std::uint8_t const* source_row = source + y * surface->pitch;
+            std::uint8_t* output_row = output + y * pitch;
+            for (int x = swapRedBlueVectorized(source_row, output_row, rect.w); x < rect.w; ++x) {
+                output_row[x * 4 + 0] = source_row[x * 4 + 2];
+                output_row[x * 4 + 1] = source_row[x * 4 + 1];
+                output_row[x * 4 + 2] = source_row[x * 4 + 0];
+                output_row[x * 4 + 3] = source_row[x * 4 + 3];
+            }
+        }
+        return true;
+    }
+
+    if (source_format == SDL_PIXELFORMAT_RGB24 && (to_rgba || to_bgra)) {
+        for (int y = 0; y < rect.h; ++y) {
+            std::uint8_t const* source_row = source + y * surface->pitch;
+            std::uint8_t* output_row = output + y * pitch;
+            for (int x = expandRGB24Vectorized(source_row, output_row, rect.w, to_bgra); x < rect.w; ++x) {
+                output_row[x * 4 + 0] = source_row[x * 3 + (to_bgra ? 2 : 0)];
+                output_row[x * 4 + 1] = source_row[x * 3 + 1];
+                output_row[x * 4 + 2] = source_row[x * 3 + (to_bgra ? 0 : 2)];
+                output_row[x * 4 + 3] = 0xFF;
+            }
+        }
+        return true;
+    }
+
+    return SDL_ConvertPixels(rect.w, rect.h, source_format, source, surface->pitch, format, pixels, pitch) == 0;
+}
+
+std::optional<ByteChannels> byteChannels(Uint32 format) noexcept {
+    int bits_per_pixel{};
+    Uint32 masks[4]{};
+    if (SDL_BYTESPERPIXEL(format) != 4 || SDL_ISPIXELFORMAT_INDEXED(format) ||
+        not SDL_PixelFormatEnumToMasks(format, &bits_per_pixel, &masks[0], &masks[1], &masks[2], &masks[3])) {
+        return std::nullopt;
+    }
+
+    // Masks are of the pixel as a 32 bits word, its bytes are in memory in the order of the platform
+    int offsets[3]{};
+    for (int channel = 0; channel < 3; ++channel) {
+        int shift = 0;
+        while (shift < 32 && masks[channel] != (0xFFU << shift)) {
+            shift += 8;
+        }
+        if (shift == 32) {
+            return std::nullopt;
+        }
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        offsets[channel] = 3 - shift / 8;
+#else
+        offsets[channel] = shift / 8;
+#endif
+    }
+    return ByteChannels{offsets[0], offsets[1], offsets[2], 6 - offsets[0] - offsets[1] - offsets[2]};
+}
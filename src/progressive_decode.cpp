@@ -0,0 +1,340 @@
+#include "progressive_decode.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <csetjmp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "byte_order.hpp"
+#include "jpeg_decode.hpp"
+
+#if IMGV2_HAVE_LIBPNG
+#include <png.h>
+#endif
+
+namespace {
+
+/// Previews fit in this size, coarse but quick to sample and upload, images that fit in it are decoded at once
+constexpr SDL_Point kPreviewSize{1024, 1024};
+
+/// Least time between two previews, each one costs a sample of the image and a texture upload
+constexpr std::chrono::milliseconds kPreviewInterval{100};
+
+/// Rows decoded between two checks for cancellation and due previews
+constexpr int kBandRows = 16;
+
+bool isCancelled(std::atomic_bool const* cancelled) noexcept {
+    return cancelled != nullptr && cancelled->load(std::memory_order_relaxed);
+}
+
+/// Point sample the decoded pixels of an RGB24 or RGBA32 surface into a preview of the image and hand it over
+/// @note rows from decoded_rows on are left transparent, and only the pixels on a lattice of step.x by step.y are
+/// sampled, the ones decoded by the passes of an interlaced image so far
+void handPreview(SDL_Surface const* surface, SDL_Point image_size, int decoded_rows, SDL_Point step,
+                 PreviewCallback const& preview) noexcept {
+    double const scale = std::min({1.0, static_cast<double>(kPreviewSize.x) / surface->w,
+                                   static_cast<double>(kPreviewSize.y) / surface->h});
+    int const width = std::max(1, static_cast<int>(surface->w * scale));
+    int const height = std::max(1, static_cast<int>(surface->h * scale));
+    SurfacePtr preview_surface =
+        SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (not preview_surface) {
+        return;
+    }
+
+    int const bytes_per_pixel = surface->format->BytesPerPixel;
+    std::vector<int> column_offsets(static_cast<std::size_t>(width));
+    for (int x = 0; x < width; ++x) {
+        int const column = std::min(static_cast<int>((x + 0.5) * surface->w / width), surface->w - 1);
+        column_offsets[static_cast<std::size_t>(x)] = column / step.x * step.x * bytes_per_pixel;
+    }
+
+    for (int y = 0; y < height; ++y) {
+        auto* preview_row = reinterpret_cast<Uint32*>(static_cast<std::uint8_t*>(preview_surface->pixels) +
+                                                      static_cast<std::ptrdiff_t>(y) * preview_surface->pitch);
+        int const row = std::min(static_cast<int>((y + 0.5) * surface->h / height), surface->h - 1) / step.y * step.y;
+        if (row >= decoded_rows) {
+            std::fill_n(preview_row, width, Uint32{0});
+            continue;
+        }
+
+        auto const* surface_row =
+            static_cast<std::uint8_t const*>(surface->pixels) + static_cast<std::ptrdiff_t>(row) * surface->pitch;
+        for (int x = 0; x < width; ++x) {
+            std::uint8_t const* pixel = surface_row + column_offsets[static_cast<std::size_t>(x)];
+            Uint32 const alpha = bytes_per_pixel == 4 ? pixel[3] : 0xFFU;
+            preview_row[x] = (alpha << 24) | (Uint32{pixel[0]} << 16) | (Uint32{pixel[1]} << 8) | Uint32{pixel[2]};
+        }
+    }
+    preview(makeReducedSurface(std::move(preview_surface), image_size));
+}
+
+#if IMGV2_HAVE_LIBJPEG
+/// Decode the scans read so far of a progressive JPEG at 1/8 of its size, the coefficients of the missing ones are
+/// left at zero by libjpeg so the image comes out blurry rather than incomplete
+SDL_Surface* decodeJpegPrefix(std::uint8_t const* data, std::size_t size) {
+    // The input ends early on purpose, its warning would be printed for every preview
+    return decodeJpegWith(data, size, true, [](JpegDecode& decode) {
+        jpeg_decompress_struct& info = decode.info;
+        info.scale_num = 1;
+        info.scale_denom = 8;
+        info.dct_method = JDCT_IFAST;
+        info.do_fancy_upsampling = FALSE;
+        jpeg_start_decompress(&info);
+        if (not createJpegSurface(decode)) {
+            return false;
+        }
+        readJpegRows(decode, info.output_height);
+        return true;
+    });
+}
+
+void handJpegPreview(std::uint8_t const* data, std::size_t size, SDL_Point image_size,
+                     PreviewCallback const& preview) noexcept {
+    if (SDL_Surface* prefix_surface = decodeJpegPrefix(data, size)) {
+        SurfacePtr const prefix{prefix_surface, SDL_FreeSurface};
+        handPreview(prefix.get(), image_size, prefix->h, {1, 1}, preview);
+    }
+}
+
+/// libjpeg reports errors with longjmp out of the lambda, nothing with a destructor may live in it
+SDL_Surface* decodeJpeg(std::uint8_t const* data, std::size_t size, std::atomic_bool const* cancelled,
+                        PreviewCallback const& preview) {
+    return decodeJpegWith(data, size, false, [data, size, cancelled, &preview](JpegDecode& decode) {
+        jpeg_decompress_struct& info = decode.info;
+        SDL_Point const image_size{static_cast<int>(info.image_width), static_cast<int>(info.image_height)};
+        if (image_size.x <= kPreviewSize.x && image_size.y <= kPreviewSize.y) {
+            return false;
+        }
+
+        // Progressive images are buffered scan by scan and converted once, previews decode the scans apart
+        info.buffered_image = jpeg_has_multiple_scans(&info);
+        jpeg_start_decompress(&info);
+        if (not createJpegSurface(decode)) {
+            return false;
+        }
+
+        std::chrono::steady_clock::time_point next_preview{};
+        if (info.buffered_image) {
+            for (int status = JPEG_SUSPENDED; status != JPEG_REACHED_EOI;) {
+                if (isCancelled(cancelled)) {
+                    failJpegDecode(decode, "image load was cancelled");
+                }
+
+                status = jpeg_consume_input(&info);
+                if (status == JPEG_SCAN_COMPLETED && std::chrono::steady_clock::now() >= next_preview) {
+                    // The marker ending the scan is already read, the prefix stops before it or cuts its segment
+                    std::size_t const marker_size = info.unread_marker != 0 ? 2 : 0;
+                    handJpegPreview(data, size - info.src->bytes_in_buffer - marker_size, image_size, preview);
+                    next_preview = std::chrono::steady_clock::now() + kPreviewInterval;
+                }
+            }
+            jpeg_start_output(&info, info.input_scan_number);
+        }
+
+        while (info.output_scanline < info.output_height) {
+            if (isCancelled(cancelled)) {
+                failJpegDecode(decode, "image load was cancelled");
+            }
+            readJpegRows(decode, std::min(info.output_scanline + kBandRows, info.output_height));
+
+            // The last pass of a progressive image only sharpens what its previews already show
+            if (not info.buffered_image && std::chrono::steady_clock::now() >= next_preview) {
+                handPreview(decode.surface, image_size, static_cast<int>(info.output_scanline), {1, 1}, preview);
+                next_preview = std::chrono::steady_clock::now() + kPreviewInterval;
+            }
+        }
+
+        if (info.buffered_image) {
+            jpeg_finish_output(&info);
+        }
+        jpeg_finish_decompress(&info);
+        return true;
+    });
+}
+#endif
+
+#if IMGV2_HAVE_LIBPNG
+/// Once an Adam7 pass is complete, the image is known on the lattice of that pass
+constexpr std::array<SDL_Point, 7> kAdam7Lattices{{{8, 8}, {4, 8}, {4, 4}, {2, 4}, {2, 2}, {1, 2}, {1, 1}}};
+
+/// Bytes fed to libpng between two checks for cancellation and due previews
+constexpr std::size_t kPngChunkBytes = 16U * 1024U;
+
+/// State of the decode shared with the libpng callbacks
+struct PngProgress {
+    SDL_Surface* surface{};
+    int pass{};
+    int decoded_rows{};
+    bool complete{false};
+};
+
+void onPngError(png_structp png, png_const_charp message) {
+    SDL_SetError("failed to decode png: %s", message);
+    png_longjmp(png, 1);
+}
+
+void onPngWarning(png_structp, png_const_charp) {}
+
+void onPngInfo(png_structp png, png_infop info) {
+    // The same pixels as SDL_image, 8 bits RGB with an alpha channel only when the image has transparency
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_gray_to_rgb(png);
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    bool const has_alpha = png_get_channels(png, info) == 4;
+    auto* progress = static_cast<PngProgress*>(png_get_progressive_ptr(png));
+    progress->surface = SDL_CreateRGBSurfaceWithFormat(
+        0, static_cast<int>(png_get_image_width(png, info)), static_cast<int>(png_get_image_height(png, info)),
+        has_alpha ? 32 : 24, has_alpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGB24);
+    if (progress->surface == nullptr) {
+        png_error(png, "out of memory");
+    }
+}
+
+void onPngRow(png_structp png, png_bytep new_row, png_uint_32 row_number, int pass) {
+    // Rows of interlaced images come once per pass, only with the pixels of that pass to combine into the row
+    auto* progress = static_cast<PngProgress*>(png_get_progressive_ptr(png));
+    if (new_row != nullptr) {
+        png_progressive_combine_row(
+            png,
+            static_cast<png_bytep>(progress->surface->pixels) + static_cast<std::ptrdiff_t>(row_number) *
+                                                                    progress->surface->pitch,
+            new_row);
+    }
+    progress->pass = pass;
+    progress->decoded_rows = static_cast<int>(row_number) + 1;
+}
+
+void onPngEnd(png_structp png, png_infop) { static_cast<PngProgress*>(png_get_progressive_ptr(png))->complete = true; }
+
+/// libpng reports errors with longjmp, nothing with a destructor may live in this frame
+SDL_Surface* decodePng(std::uint8_t const* data, std::size_t size, std::atomic_bool const* cancelled,
+                       PreviewCallback const& preview) {
+    // The header tells whether the image is worth it before setting libpng up
+    if (size < 33U || std::string_view{reinterpret_cast<char const*>(data), 8} != "\x89PNG\r\n\x1a\n") {
+        return nullptr;
+    }
+    SDL_Point const image_size{static_cast<int>(readBE32(data + 16)), static_cast<int>(readBE32(data + 20))};
+    bool const interlaced = data[28] != 0U;
+    if (image_size.x <= kPreviewSize.x && image_size.y <= kPreviewSize.y) {
+        return nullptr;
+    }
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, onPngError, onPngWarning);
+    if (png == nullptr) {
+        SDL_SetError("failed to create the png decoder");
+        return nullptr;
+    }
+    png_infop info = png_create_info_struct(png);
+    PngProgress progress{};
+    if (info == nullptr || setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        SDL_FreeSurface(progress.surface);
+        return nullptr;
+    }
+    png_set_progressive_read_fn(png, &progress, onPngInfo, onPngRow, onPngEnd);
+
+    std::chrono::steady_clock::time_point next_preview{};
+    int previewed_passes = 0;
+    for (std::size_t offset = 0U; offset < size && not progress.complete; offset += kPngChunkBytes) {
+        if (isCancelled(cancelled)) {
+            SDL_SetError("image load was cancelled");
+            png_longjmp(png, 1);
+        }
+
+        png_process_data(png, info, const_cast<png_bytep>(data + offset), std::min(kPngChunkBytes, size - offset));
+        if (progress.surface == nullptr || progress.complete ||
+            std::chrono::steady_clock::now() < next_preview) {
+            continue;
+        }
+
+        // Passes are shown once complete, the first one is a 1/64 sample of the whole image
+        if (not interlaced) {
+            handPreview(progress.surface, image_size, progress.decoded_rows, {1, 1}, preview);
+        } else if (progress.pass > previewed_passes) {
+            handPreview(progress.surface, image_size, image_size.y,
+                        kAdam7Lattices[static_cast<std::size_t>(progress.pass - 1)], preview);
+            previewed_passes = progress.pass;
+        } else {
+            continue;
+        }
+        next_preview = std::chrono::steady_clock::now() + kPreviewInterval;
+    }
+
+    if (not progress.complete) {
+        png_error(png, "truncated image");
+    }
+    png_destroy_read_struct(&png, &info, nullptr);
+    return progress.surface;
+}
+#endif
+
+/// Formats with a progressive decoder in this build
+enum class ProgressiveFormat { none, jpeg, png };
+
+ProgressiveFormat progressiveFormat(std::string_view extension) noexcept {
+    std::string lowercase_extension{extension};
+    for (auto& c : lowercase_extension) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+#if IMGV2_HAVE_LIBJPEG
+    if (lowercase_extension == ".jpg" || lowercase_extension == ".jpeg" || lowercase_extension == ".jpe" ||
+        lowercase_extension == ".jif" || lowercase_extension == ".jfif") {
+        return ProgressiveFormat::jpeg;
+    }
+#endif
+#if IMGV2_HAVE_LIBPNG
+    if (lowercase_extension == ".png") {
+        return ProgressiveFormat::png;
+    }
+#endif
+    return ProgressiveFormat::none;
+}
+
+}  // namespace
+
+bool decodesProgressively(std::filesystem::path const& image_path) noexcept {
+    if (progressiveFormat(image_path.extension().string()) == ProgressiveFormat::none) {
+        return false;
+    }
+    auto const image_size = probeImageSize(image_path);
+    return image_size && (image_size->x > kPreviewSize.x || image_size->y > kPreviewSize.y);
+}
+
+SurfacePtr decodeProgressive(MappedFile const& image_file, std::string_view extension,
+                             std::atomic_bool const* cancelled, PreviewCallback const& preview) noexcept {
+    SDL_Surface* surface = nullptr;
+    switch (progressiveFormat(extension)) {
+#if IMGV2_HAVE_LIBJPEG
+        case ProgressiveFormat::jpeg: {
+            surface = decodeJpeg(image_file.data(), image_file.size(), cancelled, preview);
+            break;
+        }
+#endif
+#if IMGV2_HAVE_LIBPNG
+        case ProgressiveFormat::png: {
+            surface = decodePng(image_file.data(), image_file.size(), cancelled, preview);
+            break;
+        }
+#endif
+        default: {
+            break;
+        }
+    }
+    (void)image_file;
+    (void)cancelled;
+    (void)preview;
+
+    if (surface == nullptr) {
+        return {nullptr};
+    }
+    return SurfacePtr{surface, SDL_FreeSurface};
+}
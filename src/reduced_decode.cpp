@@ -0,0 +1,157 @@
+#include "reduced_decode.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "jpeg_decode.hpp"
+#include "mipmap.hpp"
+
+#if IMGV2_HAVE_LIBWEBP
+#include <webp/decode.h>
+#endif
+
+namespace {
+
+/// Scale that fits the image inside size_limit, 1 when it already fits
+double fitScale(int width, int height, SDL_Point size_limit) noexcept {
+    if (width <= 0 || height <= 0 || size_limit.x <= 0 || size_limit.y <= 0) {
+        return 1.0;
+    }
+    return std::min({1.0, static_cast<double>(size_limit.x) / width, static_cast<double>(size_limit.y) / height});
+}
+
+/// Largest power of two, up to max_denominator, the image can be divided by and still cover its fitted size
+int reductionDenominator(int width, int height, SDL_Point size_limit, int max_denominator) noexcept {
+    double const scale = fitScale(width, height, size_limit);
+    int denominator = 1;
+    while (denominator < max_denominator && scale * denominator * 2 <= 1.0) {
+        denominator *= 2;
+    }
+    return denominator;
+}
+
+#if IMGV2_HAVE_LIBJPEG
+SDL_Surface* decodeJpeg(std::uint8_t const* data, std::size_t size, SDL_Point size_limit, SDL_Point& image_size) {
+    return decodeJpegWith(data, size, false, [size_limit, &image_size](JpegDecode& decode) {
+        jpeg_decompress_struct& info = decode.info;
+        int const denominator = reductionDenominator(static_cast<int>(info.image_width),
+                                                     static_cast<int>(info.image_height), size_limit, 8);
+        if (denominator == 1) {
+            return false;
+        }
+
+        info.scale_num = 1;
+        info.scale_denom = static_cast<unsigned int>(denominator);
+        jpeg_start_decompress(&info);
+        if (not createJpegSurface(decode)) {
+            return false;
+        }
+        readJpegRows(decode, info.output_height);
+
+        image_size = SDL_Point{static_cast<int>(info.image_width), static_cast<int>(info.image_height)};
+        jpeg_finish_decompress(&info);
+        return true;
+    });
+}
+#endif
+
+#if IMGV2_HAVE_LIBWEBP
+SDL_Surface* decodeWebp(std::uint8_t const* data, std::size_t size, SDL_Point size_limit, SDL_Point& image_size) {
+    WebPDecoderConfig config{};
+    if (not WebPInitDecoderConfig(&config) || WebPGetFeatures(data, size, &config.input) != VP8_STATUS_OK) {
+        return nullptr;
+    }
+
+    // Animations are decoded frame by frame elsewhere
+    double const scale = fitScale(config.input.width, config.input.height, size_limit);
+    if (config.input.has_animation || scale >= 1.0) {
+        return nullptr;
+    }
+
+    // Any size is supported, the fitted one is as small as it gets
+    int const width = std::max(1, static_cast<int>(std::ceil(config.input.width * scale)));
+    int const height = std::max(1, static_cast<int>(std::ceil(config.input.height * scale)));
+    bool const has_alpha = config.input.has_alpha != 0;
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, has_alpha ? 32 : 24,
+                                                          has_alpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGB24);
+    if (surface == nullptr) {
+        return nullptr;
+    }
+
+    config.options.use_scaling = 1;
+    config.options.scaled_width = width;
+    config.options.scaled_height = height;
+    config.output.colorspace = has_alpha ? MODE_RGBA : MODE_RGB;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = static_cast<std::uint8_t*>(surface->pixels);
+    config.output.u.RGBA.stride = surface->pitch;
+    config.output.u.RGBA.size = static_cast<std::size_t>(surface->pitch) * static_cast<std::size_t>(height);
+    if (WebPDecode(data, size, &config) != VP8_STATUS_OK) {
+        SDL_SetError("failed to decode webp");
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+
+    image_size = SDL_Point{config.input.width, config.input.height};
+    return surface;
+}
+#endif
+
+}  // namespace
+
+SurfacePtr decodeReduced(MappedFile const& image_file, std::string_view extension, SDL_Point size_limit) noexcept {
+    std::string lowercase_extension{extension};
+    for (auto& c : lowercase_extension) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    SDL_Point image_size{};
+    SDL_Surface* surface = nullptr;
+#if IMGV2_HAVE_LIBJPEG
+    if (lowercase_extension == ".jpg" || lowercase_extension == ".jpeg" || lowercase_extension == ".jpe" ||
+        lowercase_extension == ".jif" || lowercase_extension == ".jfif") {
+        surface = decodeJpeg(image_file.data(), image_file.size(), size_limit, image_size);
+    }
+#endif
+#if IMGV2_HAVE_LIBWEBP
+    if (lowercase_extension == ".webp") {
+        surface = decodeWebp(image_file.data(), image_file.size(), size_limit, image_size);
+    }
+#endif
+    (void)image_file;
+    (void)size_limit;
+
+    if (surface == nullptr) {
+        return {nullptr};
+    }
+    return makeReducedSurface(SurfacePtr{surface, SDL_FreeSurface}, image_size);
+}
+
+SurfacePtr downscaleToLimit(SurfacePtr surface, SDL_Point size_limit) noexcept {
+    SDL_Point const image_size = imageSize(surface);
+    int denominator = reductionDenominator(surface->w, surface->h, size_limit, 1 << 16);
+    if (denominator == 1) {
+        return surface;
+    }
+
+    // The box filter works on 32 bits pixels
+    SurfacePtr reduced = surface;
+    if (reduced->format->BytesPerPixel != 4 || SDL_ISPIXELFORMAT_INDEXED(reduced->format->format)) {
+        reduced = SDLit::make_unique(SDL_ConvertSurfaceFormat, reduced.get(), SDL_PIXELFORMAT_ARGB8888, 0);
+        if (not reduced) {
+            return surface;
+        }
+    }
+
+    for (; denominator > 1; denominator /= 2) {
+        auto downsampled = downsampleSurface(reduced.get());
+        if (not downsampled) {
+            return surface;
+        }
+        reduced = std::move(downsampled);
+    }
+    return makeReducedSurface(std::move(reduced), image_size);
+}
@@ -0,0 +1,100 @@
+#include "texture_budget.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "image_viewer.hpp"
+#include "trace.hpp"
+
+namespace {
+
+constexpr std::size_t kDefaultBudgetBytes = 1024U * 1024U * 1024U;
+
+double toMegabytes(std::size_t bytes) noexcept { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+}  // namespace
+
+TextureBudget& TextureBudget::shared() noexcept {
+    static TextureBudget texture_budget{kDefaultBudgetBytes};
+    return texture_budget;
+}
+
+TextureBudget::TextureBudget(std::size_t budget_bytes) noexcept : m_budget_bytes{budget_bytes} {}
+
+TextureBudget::~TextureBudget() noexcept {}
+
+void TextureBudget::setBudget(std::size_t budget_bytes) noexcept { m_budget_bytes = budget_bytes; }
+
+std::size_t TextureBudget::budget() const noexcept { return m_budget_bytes; }
+
+std::size_t TextureBudget::usedBytes() const noexcept { return m_used_bytes; }
+
+void TextureBudget::add(ImageViewer* image_viewer) noexcept { m_image_viewers.push_front(image_viewer); }
+
+void TextureBudget::remove(ImageViewer* image_viewer) noexcept {
+    m_image_viewers.remove(image_viewer);
+    m_restored_image_viewers.erase(image_viewer);
+}
+
+void TextureBudget::touch(ImageViewer* image_viewer) noexcept {
+    auto it = std::find(m_image_viewers.begin(), m_image_viewers.end(), image_viewer);
+    if (it != m_image_viewers.end()) {
+        m_image_viewers.splice(m_image_viewers.begin(), m_image_viewers, it);
+    }
+
+    // The most recently focused window is never released, whatever the budget
+    m_restored_image_viewers.clear();
+    image_viewer->restoreTextures();
+}
+
+void TextureBudget::expose(ImageViewer* image_viewer) noexcept {
+    if (not image_viewer->texturesReleased() || image_viewer->hidden() ||
+        m_used_bytes + image_viewer->releasedBytes() > m_budget_bytes) {
+        return;
+    }
+
+    m_restored_image_viewers.insert(image_viewer);
+    image_viewer->restoreTextures();
+}
+
+void TextureBudget::enforce() noexcept {
+    std::size_t used_bytes{};
+    for (auto const* image_viewer : m_image_viewers) {
+        used_bytes += image_viewer->textureBytes();
+    }
+
+    if (used_bytes > m_budget_bytes && m_image_viewers.size() > 1U) {
+        // Least recently focused first, but hidden windows before any visible one, and no visible one restored since
+        // the last focus change
+        std::vector<ImageViewer*> image_viewers{};
+        std::copy_if(m_image_viewers.rbegin(), std::prev(m_image_viewers.rend()), std::back_inserter(image_viewers),
+                     [this](ImageViewer const* image_viewer) {
+                         return image_viewer->hidden() || not m_restored_image_viewers.contains(image_viewer);
+                     });
+        std::stable_partition(image_viewers.begin(), image_viewers.end(),
+                              [](ImageViewer const* image_viewer) { return image_viewer->hidden(); });
+
+        for (auto* image_viewer : image_viewers) {
+            if (used_bytes <= m_budget_bytes) {
+                break;
+            }
+
+            std::size_t const released_bytes = std::min(image_viewer->releaseTextures(), used_bytes);
+            if (released_bytes > 0U) {
+                // Painted again with the low resolution version, the full one is gone from the texture
+                image_viewer->invalidate();
+                used_bytes -= released_bytes;
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                            "Released %.1f MB of textures from %s, %.1f of %.1f MB of textures in use",
+                            toMegabytes(released_bytes), image_viewer->imagePath().c_str(), toMegabytes(used_bytes),
+                            toMegabytes(m_budget_bytes));
+            }
+        }
+    }
+
+    if (used_bytes != m_used_bytes) {
+        m_used_bytes = used_bytes;
+        Trace::counter("texture bytes", static_cast<std::int64_t>(used_bytes));
+    }
+}
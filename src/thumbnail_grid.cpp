@@ -0,0 +1,564 @@
+#include "thumbnail_grid.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+/// Edge of the thumbnails in window coordinates, they are decoded at the pixel density of the window
+constexpr int kThumbnailSize = 128;
+
+/// The atlas never exceeds this edge, about a thousand thumbnails at the default size
+constexpr int kMaxAtlasSize = 4096;
+
+/// Grid shown when the window opens
+constexpr int kInitialColumns = 6;
+constexpr int kInitialRows = 4;
+
+constexpr std::size_t kNoImage = std::numeric_limits<std::size_t>::max();
+
+}  // namespace
+
+/// Shared with the decoding tasks, so the grid may be closed while thumbnails are being decoded
+struct ThumbnailGrid::Pipeline {
+    struct Thumbnail {
+        std::size_t image_index{};
+        SurfacePtr surface{};
+    };
+
+    std::vector<std::filesystem::path> image_paths{};
+    SDL_Point thumbnail_size{};
+    std::uint32_t window_id{};
+    std::atomic_bool cancelled{false};
+
+    std::mutex mutex{};
+    /// Images to decode, the most urgent one last
+    std::vector<std::size_t> pending{};
+    /// Images being decoded or decoded but not taken yet, they are not requested again meanwhile
+    std::unordered_set<std::size_t> in_flight{};
+    std::size_t running_tasks{};
+    std::deque<Thumbnail> thumbnails{};
+};
+
+std::unique_ptr<ThumbnailGrid> ThumbnailGrid::open(std::vector<std::filesystem::path> image_paths) noexcept {
+    if (image_paths.empty()) {
+        SDL_SetError("no images to show in the grid");
+        return {nullptr};
+    }
+
+    TRACE_SCOPE("open grid", nullptr);
+    int const cell_size = kThumbnailSize + kThumbnailSize / 8;
+    auto window = SDLit::make_unique(SDL_CreateWindow, "imgv2", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                     kInitialColumns * cell_size + kThumbnailSize / 8,
+                                     kInitialRows * cell_size + kThumbnailSize / 8,
+                                     SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+    if (not window) {
+        return {nullptr};
+    }
+
+    auto renderer = SDLit::make_unique(SDL_CreateRenderer, window.get(), -1,
+                                       SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (not renderer) {
+        return {nullptr};
+    }
+
+    SDL_RendererInfo renderer_info{};
+    if (SDL_GetRendererInfo(renderer.get(), &renderer_info)) {
+        return {nullptr};
+    }
+
+    // Sharp on high density displays, but never more than twice the memory per thumbnail
+    int window_width{};
+    int window_width_in_pixels{};
+    SDL_GetWindowSize(window.get(), &window_width, nullptr);
+    SDL_GetWindowSizeInPixels(window.get(), &window_width_in_pixels, nullptr);
+    float const density =
+        window_width > 0 ? static_cast<float>(window_width_in_pixels) / static_cast<float>(window_width) : 1.0f;
+    int const thumbnail_size =
+        std::clamp(static_cast<int>(std::lround(kThumbnailSize * density)), kThumbnailSize, 2 * kThumbnailSize);
+
+    int atlas_size = kMaxAtlasSize;
+    if (renderer_info.max_texture_width > 0 && renderer_info.max_texture_height > 0) {
+        atlas_size = std::min({atlas_size, renderer_info.max_texture_width, renderer_info.max_texture_height});
+    }
+    int const atlas_columns = atlas_size / thumbnail_size;
+    if (atlas_columns <= 0) {
+        SDL_SetError("max texture size of %d is too small for %dpx thumbnails", atlas_size, thumbnail_size);
+        return {nullptr};
+    }
+
+    auto atlas = SDLit::make_unique(SDL_CreateTexture, renderer.get(), Uint32{SDL_PIXELFORMAT_ARGB8888},
+                                    int{SDL_TEXTUREACCESS_STATIC}, atlas_columns * thumbnail_size,
+                                    atlas_columns * thumbnail_size);
+    if (not atlas || SDL_SetTextureBlendMode(atlas.get(), SDL_BLENDMODE_BLEND)) {
+        return {nullptr};
+    }
+
+    auto pipeline = std::make_shared<Pipeline>();
+    pipeline->image_paths = std::move(image_paths);
+    pipeline->thumbnail_size = SDL_Point{thumbnail_size, thumbnail_size};
+    pipeline->window_id = SDL_GetWindowID(window.get());
+
+    auto thumbnail_grid = std::unique_ptr<ThumbnailGrid>{new ThumbnailGrid{
+        std::move(window), std::move(renderer), std::move(atlas), atlas_columns, std::move(pipeline)}};
+    thumbnail_grid->select(0U);
+    thumbnail_grid->requestThumbnails();
+    thumbnail_grid->repaint();
+    SDL_RaiseWindow(thumbnail_grid->window());
+
+    SDL_PumpEvents();
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Browsing %zu images in a grid of %dpx thumbnails, %d in memory",
+                thumbnail_grid->imageCount(), thumbnail_size, atlas_columns * atlas_columns);
+    return thumbnail_grid;
+}
+
+std::uint32_t ThumbnailGrid::thumbnailEventType() noexcept {
+    static std::uint32_t const thumbnail_event_type{SDL_RegisterEvents(1)};
+    return thumbnail_event_type;
+}
+
+ThumbnailGrid::ThumbnailGrid(std::unique_ptr<SDL_Window, SDLit::SDL_Deleter> window,
+                             std::unique_ptr<SDL_Renderer, SDLit::SDL_Deleter> renderer,
+                             std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> atlas, int atlas_columns,
+                             std::shared_ptr<Pipeline> pipeline) noexcept
+    : m_window{std::move(window)},
+      m_renderer{std::move(renderer)},
+      m_atlas{std::move(atlas)},
+      m_atlas_columns{atlas_columns},
+      m_pipeline{std::move(pipeline)},
+      m_image_slots(m_pipeline->image_paths.size(), -1),
+      m_slot_images(static_cast<std::size_t>(atlas_columns * atlas_columns), kNoImage),
+      m_slot_sizes(static_cast<std::size_t>(atlas_columns * atlas_columns)),
+      m_failed(m_pipeline->image_paths.size(), false) {}
+
+ThumbnailGrid::~ThumbnailGrid() noexcept { m_pipeline->cancelled = true; }
+
+SDL_Window* ThumbnailGrid::window() const noexcept { return m_window.get(); }
+
+std::size_t ThumbnailGrid::imageCount() const noexcept { return m_pipeline->image_paths.size(); }
+
+int ThumbnailGrid::thumbnailSize() const noexcept { return m_pipeline->thumbnail_size.x; }
+
+ThumbnailGrid::Layout ThumbnailGrid::layout() const noexcept {
+    Layout grid_layout{};
+    grid_layout.margin = thumbnailSize() / 8;
+    grid_layout.cell_size = thumbnailSize() + grid_layout.margin;
+    grid_layout.columns = std::max((windowSize().x - grid_layout.margin) / grid_layout.cell_size, 1);
+    grid_layout.rows = static_cast<int>((imageCount() + static_cast<std::size_t>(grid_layout.columns) - 1U) /
+                                        static_cast<std::size_t>(grid_layout.columns));
+    return grid_layout;
+}
+
+SDL_Point ThumbnailGrid::windowSize() const noexcept {
+    SDL_Point window_size{};
+    SDL_GetWindowSizeInPixels(m_window.get(), &window_size.x, &window_size.y);
+    return window_size;
+}
+
+float ThumbnailGrid::pixelDensity() const noexcept {
+    int window_width{};
+    int window_width_in_pixels{};
+    SDL_GetWindowSize(m_window.get(), &window_width, nullptr);
+    SDL_GetWindowSizeInPixels(m_window.get(), &window_width_in_pixels, nullptr);
+    return window_width > 0 ? static_cast<float>(window_width_in_pixels) / static_cast<float>(window_width) : 1.0f;
+}
+
+std::chrono::steady_clock::duration ThumbnailGrid::refreshInterval() const noexcept {
+    SDL_DisplayMode display_mode{};
+    int const refresh_rate =
+        (SDL_GetWindowDisplayMode(m_window.get(), &display_mode) == 0 && display_mode.refresh_rate > 0)
+            ? display_mode.refresh_rate
+            : 60;
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds{1}) / refresh_rate;
+}
+
+std::pair<std::size_t, std::size_t> ThumbnailGrid::visibleRange() const noexcept {
+    Layout const grid_layout = layout();
+    auto const columns = static_cast<std::size_t>(grid_layout.columns);
+    auto const first_row = static_cast<std::size_t>(std::max(m_scroll_offset / grid_layout.cell_size, 0));
+    auto const last_row =
+        static_cast<std::size_t>(std::max((m_scroll_offset + windowSize().y) / grid_layout.cell_size, 0));
+    return {std::min(first_row * columns, imageCount()), std::min((last_row + 1U) * columns, imageCount())};
+}
+
+bool ThumbnailGrid::repaint() noexcept {
+    m_dirty = false;
+    scrollTo(m_scroll_offset);
+
+    if (SDL_SetRenderDrawColor(m_renderer.get(), 0xC0, 0xC0, 0xC0, 0xFF)) {
+        return false;
+    }
+
+    if (SDL_RenderClear(m_renderer.get())) {
+        return false;
+    }
+
+    // The grid is centered horizontally, the thumbnails are centered in their cells
+    Layout const grid_layout = layout();
+    int const thumbnail_size = thumbnailSize();
+    int const grid_x = (windowSize().x - grid_layout.columns * grid_layout.cell_size + grid_layout.margin) / 2;
+    auto const [first_visible, last_visible] = visibleRange();
+    for (std::size_t image_index = first_visible; image_index < last_visible; ++image_index) {
+        int const column = static_cast<int>(image_index % static_cast<std::size_t>(grid_layout.columns));
+        int const row = static_cast<int>(image_index / static_cast<std::size_t>(grid_layout.columns));
+        SDL_Rect const thumbnail_rect{grid_x + column * grid_layout.cell_size,
+                                      grid_layout.margin + row * grid_layout.cell_size - m_scroll_offset,
+                                      thumbnail_size, thumbnail_size};
+
+        if (image_index == m_selected) {
+            SDL_Rect const selection_rect{thumbnail_rect.x - grid_layout.margin / 2,
+                                          thumbnail_rect.y - grid_layout.margin / 2, grid_layout.cell_size,
+                                          grid_layout.cell_size};
+            if (SDL_SetRenderDrawColor(m_renderer.get(), 0x60, 0x80, 0xC0, 0xFF) ||
+                SDL_RenderFillRect(m_renderer.get(), &selection_rect)) {
+                return false;
+            }
+        }
+
+        int const slot = m_image_slots[image_index];
+        if (slot >= 0) {
+            SDL_Point const size = m_slot_sizes[static_cast<std::size_t>(slot)];
+            SDL_Rect const src{(slot % m_atlas_columns) * thumbnail_size, (slot / m_atlas_columns) * thumbnail_size,
+                               size.x, size.y};
+            SDL_Rect const dst{thumbnail_rect.x + (thumbnail_size - size.x) / 2,
+                               thumbnail_rect.y + (thumbnail_size - size.y) / 2, size.x, size.y};
+            if (SDL_RenderCopy(m_renderer.get(), m_atlas.get(), &src, &dst)) {
+                return false;
+            }
+        } else if (not m_failed[image_index]) {
+            // Placeholder while the thumbnail is still being decoded
+            if (SDL_SetRenderDrawColor(m_renderer.get(), 0xA0, 0xA0, 0xA0, 0xFF) ||
+                SDL_RenderFillRect(m_renderer.get(), &thumbnail_rect)) {
+                return false;
+            }
+        }
+    }
+
+    SDL_RenderPresent(m_renderer.get());
+    m_last_present = std::chrono::steady_clock::now();
+    return true;
+}
+
+void ThumbnailGrid::invalidate() noexcept { m_dirty = true; }
+
+bool ThumbnailGrid::update() noexcept {
+    takeThumbnails();
+    if (visibleRange() != m_requested_range) {
+        requestThumbnails();
+    }
+
+    if (not m_dirty || m_last_present + refreshInterval() > std::chrono::steady_clock::now()) {
+        return false;
+    }
+    return repaint();
+}
+
+std::optional<std::chrono::steady_clock::time_point> ThumbnailGrid::nextUpdateTime() const noexcept {
+    if (not m_dirty) {
+        return std::nullopt;
+    }
+    return m_last_present + refreshInterval();
+}
+
+std::optional<std::filesystem::path> ThumbnailGrid::processKeyboardEvent(SDL_KeyboardEvent const& event) noexcept {
+    if (event.type != SDL_KEYDOWN) {
+        return std::nullopt;
+    }
+
+    Layout const grid_layout = layout();
+    auto const columns = static_cast<std::size_t>(grid_layout.columns);
+    auto const page = columns * static_cast<std::size_t>(std::max(windowSize().y / grid_layout.cell_size, 1));
+    switch (event.keysym.sym) {
+        case SDLK_RIGHT: {
+            select(m_selected + 1U);
+            break;
+        }
+        case SDLK_LEFT: {
+            select(m_selected > 0U ? m_selected - 1U : 0U);
+            break;
+        }
+        case SDLK_DOWN: {
+            select(m_selected + columns < imageCount() ? m_selected + columns : m_selected);
+            break;
+        }
+        case SDLK_UP: {
+            select(m_selected >= columns ? m_selected - columns : m_selected);
+            break;
+        }
+        case SDLK_PAGEDOWN: {
+            select(m_selected + page);
+            break;
+        }
+        case SDLK_PAGEUP: {
+            select(m_selected >= page ? m_selected - page : m_selected % columns);
+            break;
+        }
+        case SDLK_HOME: {
+            select(0U);
+            break;
+        }
+        case SDLK_END: {
+            select(imageCount() - 1U);
+            break;
+        }
+        case SDLK_RETURN:
+        case SDLK_KP_ENTER: {
+            return m_pipeline->image_paths[m_selected];
+        }
+        default: {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::filesystem::path> ThumbnailGrid::processMouseButtonEvent(
+    SDL_MouseButtonEvent const& event) noexcept {
+    if (event.type != SDL_MOUSEBUTTONDOWN || event.button != SDL_BUTTON_LEFT) {
+        return std::nullopt;
+    }
+
+    float const density = pixelDensity();
+    auto const image_index = imageAt(static_cast<int>(static_cast<float>(event.x) * density),
+                                     static_cast<int>(static_cast<float>(event.y) * density));
+    if (not image_index) {
+        return std::nullopt;
+    }
+
+    select(*image_index);
+    if (event.clicks == 2U) {
+        return m_pipeline->image_paths[*image_index];
+    }
+    return std::nullopt;
+}
+
+void ThumbnailGrid::processMouseWheelEvent(SDL_MouseWheelEvent const& event) noexcept {
+    // Half a row per notch, touchpads scroll by fractions of it
+    float const direction = event.direction == SDL_MOUSEWHEEL_FLIPPED ? -1.0f : 1.0f;
+    float const row_fraction = direction * event.preciseY * static_cast<float>(layout().cell_size) / 2.0f;
+    scrollTo(m_scroll_offset - static_cast<int>(std::lround(row_fraction)));
+}
+
+void ThumbnailGrid::scrollTo(int scroll_offset) noexcept {
+    Layout const grid_layout = layout();
+    int const content_height = grid_layout.rows * grid_layout.cell_size + grid_layout.margin;
+    scroll_offset = std::clamp(scroll_offset, 0, std::max(content_height - windowSize().y, 0));
+    if (scroll_offset != m_scroll_offset) {
+        m_scroll_offset = scroll_offset;
+        invalidate();
+    }
+}
+
+void ThumbnailGrid::select(std::size_t image_index) noexcept {
+    m_selected = std::min(image_index, imageCount() - 1U);
+
+    // Scroll just enough to bring the whole selected cell into view
+    Layout const grid_layout = layout();
+    int const row = static_cast<int>(m_selected / static_cast<std::size_t>(grid_layout.columns));
+    int const cell_top = row * grid_layout.cell_size;
+    int const cell_bottom = cell_top + grid_layout.cell_size + grid_layout.margin;
+    if (cell_top < m_scroll_offset) {
+        scrollTo(cell_top);
+    } else if (cell_bottom > m_scroll_offset + windowSize().y) {
+        scrollTo(cell_bottom - windowSize().y);
+    }
+
+    auto const title = m_pipeline->image_paths[m_selected].filename().string() + " (" +
+                       std::to_string(m_selected + 1U) + "/" + std::to_string(imageCount()) + ")";
+    SDL_SetWindowTitle(m_window.get(), title.c_str());
+    invalidate();
+}
+
+std::optional<std::size_t> ThumbnailGrid::imageAt(int x, int y) const noexcept {
+    Layout const grid_layout = layout();
+    int const grid_x = (windowSize().x - grid_layout.columns * grid_layout.cell_size + grid_layout.margin) / 2;
+    int const grid_y = y + m_scroll_offset - grid_layout.margin;
+    if (x < grid_x || grid_y < 0) {
+        return std::nullopt;
+    }
+
+    int const column = (x - grid_x) / grid_layout.cell_size;
+    int const row = grid_y / grid_layout.cell_size;
+    if (column >= grid_layout.columns) {
+        return std::nullopt;
+    }
+
+    auto const image_index = static_cast<std::size_t>(row * grid_layout.columns + column);
+    if (image_index >= imageCount()) {
+        return std::nullopt;
+    }
+    return image_index;
+}
+
+void ThumbnailGrid::takeThumbnails() noexcept {
+    std::deque<Pipeline::Thumbnail> thumbnails{};
+    {
+        std::lock_guard lock{m_pipeline->mutex};
+        thumbnails = std::exchange(m_pipeline->thumbnails, {});
+        for (auto const& thumbnail : thumbnails) {
+            m_pipeline->in_flight.erase(thumbnail.image_index);
+        }
+    }
+
+    for (auto const& thumbnail : thumbnails) {
+        if (not thumbnail.surface) {
+            m_failed[thumbnail.image_index] = true;
+            invalidate();
+        } else if (storeThumbnail(thumbnail.image_index, thumbnail.surface.get())) {
+            invalidate();
+        }
+    }
+}
+
+void ThumbnailGrid::requestThumbnails() noexcept {
+    m_requested_range = visibleRange();
+    auto const [first_visible, last_visible] = m_requested_range;
+    std::size_t const page = last_visible - first_visible;
+
+    // Visible rows first, then a screen ahead in the scroll direction most likely taken, then a screen behind
+    std::vector<std::size_t> wanted{};
+    auto const want = [this, &wanted](std::size_t image_index) {
+        if (m_image_slots[image_index] < 0 && not m_failed[image_index] && wanted.size() < m_slot_images.size()) {
+            wanted.push_back(image_index);
+        }
+    };
+    for (std::size_t image_index = first_visible; image_index < last_visible; ++image_index) {
+        want(image_index);
+    }
+    for (std::size_t image_index = last_visible; image_index < std::min(last_visible + page, imageCount());
+         ++image_index) {
+        want(image_index);
+    }
+    for (std::size_t image_index = first_visible; image_index > first_visible - std::min(page, first_visible);) {
+        want(--image_index);
+    }
+
+    // Images scrolled away since the last request are dropped, unless their decode already started
+    {
+        std::lock_guard lock{m_pipeline->mutex};
+        m_pipeline->pending.clear();
+        for (auto it = wanted.rbegin(); it != wanted.rend(); ++it) {
+            if (not m_pipeline->in_flight.contains(*it)) {
+                m_pipeline->pending.push_back(*it);
+            }
+        }
+    }
+    decodeThumbnails(m_pipeline);
+}
+
+bool ThumbnailGrid::storeThumbnail(std::size_t image_index, SDL_Surface const* thumbnail_surface) noexcept {
+    if (m_image_slots[image_index] >= 0) {
+        return false;
+    }
+
+    // A free slot, otherwise the one of the image farthest from the view, as long as it is farther than this one
+    auto const [first_visible, last_visible] = visibleRange();
+    auto const distance = [first_visible, last_visible](std::size_t index) -> std::size_t {
+        if (index < first_visible) {
+            return first_visible - index;
+        }
+        return index >= last_visible ? index - last_visible + 1U : 0U;
+    };
+
+    std::size_t slot = kNoImage;
+    std::size_t slot_distance = distance(image_index);
+    for (std::size_t candidate = 0U; candidate < m_slot_images.size(); ++candidate) {
+        if (m_slot_images[candidate] == kNoImage) {
+            slot = candidate;
+            break;
+        }
+        if (distance(m_slot_images[candidate]) > slot_distance) {
+            slot = candidate;
+            slot_distance = distance(m_slot_images[candidate]);
+        }
+    }
+    if (slot == kNoImage) {
+        return false;
+    }
+
+    int const thumbnail_size = thumbnailSize();
+    int const slot_index = static_cast<int>(slot);
+    SDL_Rect const slot_rect{
+        (slot_index % m_atlas_columns) * thumbnail_size, (slot_index / m_atlas_columns) * thumbnail_size,
+        std::min(thumbnail_surface->w, thumbnail_size), std::min(thumbnail_surface->h, thumbnail_size)};
+    if (SDL_UpdateTexture(m_atlas.get(), &slot_rect, thumbnail_surface->pixels, thumbnail_surface->pitch)) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to upload thumbnail of %s: %s",
+                    m_pipeline->image_paths[image_index].c_str(), SDL_GetError());
+        return false;
+    }
+
+    if (m_slot_images[slot] != kNoImage) {
+        m_image_slots[m_slot_images[slot]] = -1;
+    }
+    m_slot_images[slot] = image_index;
+    m_slot_sizes[slot] = SDL_Point{slot_rect.w, slot_rect.h};
+    m_image_slots[image_index] = slot_index;
+    return true;
+}
+
+void ThumbnailGrid::decodeThumbnails(std::shared_ptr<Pipeline> const& pipeline) noexcept {
+    std::size_t task_count{};
+    {
+        std::lock_guard lock{pipeline->mutex};
+        std::size_t const wanted_tasks = std::min(pipeline->pending.size(), WorkerPool::shared().size());
+        task_count = wanted_tasks > pipeline->running_tasks ? wanted_tasks - pipeline->running_tasks : 0U;
+        pipeline->running_tasks += task_count;
+    }
+
+    for (std::size_t task = 0U; task < task_count; ++task) {
+        WorkerPool::shared().submit([pipeline] { decodeNextThumbnail(pipeline); });
+    }
+}
+
+void ThumbnailGrid::decodeNextThumbnail(std::shared_ptr<Pipeline> const& pipeline) noexcept {
+    // The most urgent image is only picked when a worker is free, so priorities set while scrolling apply right away
+    std::size_t image_index{};
+    {
+        std::lock_guard lock{pipeline->mutex};
+        if (pipeline->cancelled || pipeline->pending.empty()) {
+            --pipeline->running_tasks;
+            return;
+        }
+        image_index = pipeline->pending.back();
+        pipeline->pending.pop_back();
+        pipeline->in_flight.insert(image_index);
+    }
+
+    auto const& image_path = pipeline->image_paths[image_index];
+    SurfacePtr thumbnail_surface{};
+    {
+        TRACE_SCOPE("decode thumbnail", image_path.c_str());
+        thumbnail_surface = loadThumbnail(image_path, pipeline->thumbnail_size, &pipeline->cancelled);
+    }
+    if (not thumbnail_surface && not pipeline->cancelled) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "No thumbnail for %s: %s", image_path.c_str(), SDL_GetError());
+    }
+
+    bool was_empty{};
+    {
+        std::lock_guard lock{pipeline->mutex};
+        was_empty = pipeline->thumbnails.empty();
+        pipeline->thumbnails.push_back(Pipeline::Thumbnail{image_index, std::move(thumbnail_surface)});
+    }
+
+    // The event loop only needs waking up once per batch, it takes all the thumbnails at once
+    if (was_empty) {
+        SDL_Event event{};
+        event.type = thumbnailEventType();
+        event.user.windowID = pipeline->window_id;
+        SDL_PushEvent(&event);
+    }
+
+    // One thumbnail per task, so the images opened from the grid are not queued behind all of them
+    WorkerPool::shared().submit([pipeline] { decodeNextThumbnail(pipeline); });
+}
@@ -0,0 +1,392 @@
+#include "tiled_texture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "mipmap.hpp"
+#include "pixel_convert.hpp"
+#include "trace.hpp"
+
+namespace {
+
+/// Texture format the renderer takes without converting, the surface one when supported or a 32 bits one otherwise
+Uint32 nativeTextureFormat(SDL_RendererInfo const& renderer_info, Uint32 surface_format) noexcept {
+    auto const* const formats_begin = renderer_info.texture_formats;
+    auto const* const formats_end = renderer_info.texture_formats + renderer_info.num_texture_formats;
+    if (std::find(formats_begin, formats_end, surface_format) != formats_end) {
+        return surface_format;
+    }
+
+    for (Uint32 const format : {Uint32{SDL_PIXELFORMAT_ARGB8888}, Uint32{SDL_PIXELFORMAT_ABGR8888}}) {
+        if (std::find(formats_begin, formats_end, format) != formats_end) {
+            return format;
+        }
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+/// Largest tile edge used when the image does not fit in a single texture
+constexpr int kMaxTileSize = 2048;
+
+/// Uploaded tiles kept beyond the ones visible, so panning back and forth does not upload them again
+constexpr std::size_t kSpareTiles = 8U;
+
+/// The pyramid stops once a level is this small, no window shows the image at a smaller size
+constexpr int kMinLevelSize = 256;
+
+/// Rows converted at a time before being uploaded, the scratch buffer holds a band of the widest tile
+constexpr int kUploadBandRows = 64;
+
+/// Buffer the pixels are converted into before being uploaded, reused by every upload of the thread
+std::vector<std::uint8_t>& scratchBuffer() noexcept {
+    thread_local std::vector<std::uint8_t> scratch_buffer{};
+    return scratch_buffer;
+}
+
+/// Palettes, color keys and RLE are resolved by SDL into plain 32 bits pixels, everything else is converted while
+/// being written into the textures
+SurfacePtr writableSurface(SurfacePtr surface) noexcept {
+    if (SDL_ISPIXELFORMAT_INDEXED(surface->format->format) || surface->format->BytesPerPixel < 2 ||
+        (surface->flags & SDL_RLEACCEL) || SDL_HasColorKey(surface.get())) {
+        return SDLit::make_unique(SDL_ConvertSurfaceFormat, surface.get(), SDL_PIXELFORMAT_ARGB8888, 0);
+    }
+    return surface;
+}
+
+}  // namespace
+
+std::unique_ptr<TiledTexture> TiledTexture::create(SDL_Renderer* renderer, SurfacePtr surface) noexcept {
+    if (renderer == nullptr || not surface) {
+        SDL_SetError("no renderer or surface to create the texture");
+        return {nullptr};
+    }
+
+    SDL_RendererInfo renderer_info{};
+    if (SDL_GetRendererInfo(renderer, &renderer_info)) {
+        return {nullptr};
+    }
+    SDL_Point const image_size = imageSize(surface);
+
+    // The box filter works on 32 bits pixels, other formats get a temporary copy to build the pyramid from
+    SurfacePtr pyramid_base{};
+    if (std::max(surface->w, surface->h) > kMinLevelSize && surface->format->BytesPerPixel != 4) {
+        pyramid_base = SDLit::make_unique(SDL_ConvertSurfaceFormat, surface.get(), SDL_PIXELFORMAT_ARGB8888, 0);
+        if (not pyramid_base) {
+            return {nullptr};
+        }
+    }
+
+    // Each level is uploaded as soon as the next one is built from it, so the whole pyramid is never held in memory
+    std::vector<Level> levels{};
+    while (surface) {
+        SurfacePtr next_surface{};
+        if (std::max(surface->w, surface->h) > kMinLevelSize) {
+            TRACE_SCOPE("build mipmap", nullptr);
+            next_surface = downsampleSurface(levels.empty() && pyramid_base ? pyramid_base.get() : surface.get());
+            if (not next_surface) {
+                return {nullptr};
+            }
+            pyramid_base.reset();
+        }
+
+        levels.emplace_back();
+        if (not makeLevel(renderer, renderer_info, std::move(surface), levels.back())) {
+            return {nullptr};
+        }
+        surface = std::move(next_surface);
+    }
+
+    if (levels.front().surface) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Image of %dx%d exceeds max texture size of %dx%d, using %dpx tiles",
+                    levels.front().width, levels.front().height, renderer_info.max_texture_width,
+                    renderer_info.max_texture_height, levels.front().tile_size);
+    }
+    return std::unique_ptr<TiledTexture>{new TiledTexture{renderer, image_size, std::move(levels)}};
+}
+
+bool TiledTexture::makeLevel(SDL_Renderer* renderer, SDL_RendererInfo const& renderer_info, SurfacePtr surface,
+                             Level& level) noexcept {
+    level.width = surface->w;
+    level.height = surface->h;
+
+    surface = writableSurface(std::move(surface));
+    if (not surface) {
+        return false;
+    }
+    level.texture_format = nativeTextureFormat(renderer_info, surface->format->format);
+
+    // Some renderers report 0 when there is no limit
+    int const max_texture_width = renderer_info.max_texture_width > 0 ? renderer_info.max_texture_width : surface->w;
+    int const max_texture_height =
+        renderer_info.max_texture_height > 0 ? renderer_info.max_texture_height : surface->h;
+
+    bool const fits_single_texture = surface->w <= max_texture_width && surface->h <= max_texture_height;
+    level.tile_size = fits_single_texture ? std::max(level.width, level.height)
+                                          : std::min({kMaxTileSize, max_texture_width, max_texture_height});
+    level.columns = (level.width + level.tile_size - 1) / level.tile_size;
+    int const rows = (level.height + level.tile_size - 1) / level.tile_size;
+    level.tiles.resize(static_cast<std::size_t>(level.columns) * static_cast<std::size_t>(rows));
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < level.columns; ++column) {
+            SDL_Rect& rect = level.tiles[static_cast<std::size_t>(row * level.columns + column)].rect;
+            rect.x = column * level.tile_size;
+            rect.y = row * level.tile_size;
+            rect.w = std::min(level.tile_size, level.width - rect.x);
+            rect.h = std::min(level.tile_size, level.height - rect.y);
+        }
+    }
+
+    // The surface is released right after, unless no other holder like the image cache keeps it alive
+    if (fits_single_texture) {
+        level.tiles.front().texture = createTexture(renderer, surface.get(), level.tiles.front().rect,
+                                                    level.texture_format);
+        return static_cast<bool>(level.tiles.front().texture);
+    }
+
+    level.surface = std::move(surface);
+    return true;
+}
+
+std::unique_ptr<SDL_Texture, SDLit::SDL_Deleter> TiledTexture::createTexture(SDL_Renderer* renderer,
+                                                                             SDL_Surface const* surface,
+                                                                             SDL_Rect const& rect,
+                                                                             Uint32 texture_format) noexcept {
+    auto texture =
+        SDLit::make_unique(SDL_CreateTexture, renderer, texture_format, SDL_TEXTUREACCESS_STATIC, rect.w, rect.h);
+    if (not texture) {
+        return {nullptr};
+    }
+
+    if (not writeTexture(texture.get(), surface, rect, texture_format)) {
+        return {nullptr};
+    }
+    return texture;
+}
+
+bool TiledTexture::writeTexture(SDL_Texture* texture, SDL_Surface const* surface, SDL_Rect const& rect,
+                                Uint32 texture_format) noexcept {
+    // Static textures keep no copy of their pixels in system memory, unlike streaming ones with most renderers, so
+    // the pixels go through a scratch buffer a band of rows at a time, converted on the way when the formats differ
+    int const pitch = (rect.w * SDL_BYTESPERPIXEL(texture_format) + 3) & ~3;
+    int const band_rows = std::min(kUploadBandRows, rect.h);
+    auto& scratch_buffer = scratchBuffer();
+    auto const band_bytes = static_cast<std::size_t>(pitch) * static_cast<std::size_t>(band_rows);
+    scratch_buffer.resize(std::max(scratch_buffer.size(), band_bytes));
+    for (int y = 0; y < rect.h; y += band_rows) {
+        SDL_Rect const band{rect.x, rect.y + y, rect.w, std::min(band_rows, rect.h - y)};
+        SDL_Rect const texture_band{0, y, band.w, band.h};
+        if (not convertPixels(surface, band, texture_format, scratch_buffer.data(), pitch) ||
+            SDL_UpdateTexture(texture, &texture_band, scratch_buffer.data(), pitch)) {
+            return false;
+        }
+    }
+
+    SDL_BlendMode const blend_mode =
+        SDL_ISPIXELFORMAT_ALPHA(surface->format->format) ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE;
+    return SDL_SetTextureBlendMode(texture, blend_mode) == 0;
+}
+
+TiledTexture::TiledTexture(SDL_Renderer* renderer, SDL_Point image_size, std::vector<Level> levels) noexcept
+    : m_renderer{renderer}, m_image_size{image_size}, m_levels{std::move(levels)} {}
+
+TiledTexture::~TiledTexture() noexcept {}
+
+int TiledTexture::width() const noexcept { return m_image_size.x; }
+
+int TiledTexture::height() const noexcept { return m_image_size.y; }
+
+float TiledTexture::resolution() const noexcept {
+    return static_cast<float>(m_levels.front().width) / static_cast<float>(m_image_size.x);
+}
+
+std::size_t TiledTexture::residentBytes() const noexcept {
+    std::size_t resident_bytes{};
+    for (auto const& level : m_levels) {
+        for (auto const& tile : level.tiles) {
+            if (tile.texture) {
+                resident_bytes += static_cast<std::size_t>(tile.rect.w) * static_cast<std::size_t>(tile.rect.h) *
+                                  SDL_BYTESPERPIXEL(level.texture_format);
+            }
+        }
+    }
+    return resident_bytes;
+}
+
+bool TiledTexture::releaseDetail() noexcept {
+    if (m_levels.size() <= 1U) {
+        return false;
+    }
+    m_levels.erase(m_levels.begin(), std::prev(m_levels.end()));
+    return true;
+}
+
+bool TiledTexture::update(SurfacePtr surface) noexcept {
+    if (not surface || surface->w != m_levels.front().width || surface->h != m_levels.front().height) {
+        SDL_SetError("surface does not match the texture size");
+        return false;
+    }
+
+    // The box filter works on 32 bits pixels, the levels are then built from a converted copy
+    if (m_levels.size() > 1U &&
+        (surface->format->BytesPerPixel != 4 || SDL_ISPIXELFORMAT_INDEXED(surface->format->format))) {
+        surface = SDLit::make_unique(SDL_ConvertSurfaceFormat, surface.get(), SDL_PIXELFORMAT_ARGB8888, 0);
+        if (not surface) {
+            return false;
+        }
+    }
+
+    for (auto& level : m_levels) {
+        if (&level != &m_levels.front()) {
+            surface = downsampleSurface(surface.get());
+            if (not surface) {
+                return false;
+            }
+        }
+
+        SurfacePtr level_surface = writableSurface(surface);
+        if (not level_surface) {
+            return false;
+        }
+
+        // Uploaded tiles are written in place, the other tiles of tiled levels get the new pixels once shown
+        for (auto& tile : level.tiles) {
+            if (tile.texture && not writeTexture(tile.texture.get(), level_surface.get(), tile.rect,
+                                                 level.texture_format)) {
+                return false;
+            }
+        }
+        if (level.surface) {
+            level.surface = std::move(level_surface);
+        }
+    }
+    return true;
+}
+
+bool TiledTexture::render(SDL_FRect const& src, SDL_FRect const& dst, SDL_RendererFlip flip) noexcept {
+    if (src.w <= 0.0f || src.h <= 0.0f) {
+        return true;
+    }
+    ++m_frame;
+
+    // Pick the smallest level that still has at least one pixel per screen pixel, level 0 may already be reduced
+    float const minification = src.w * resolution() / dst.w;
+    auto const level_index = static_cast<std::size_t>(
+        std::clamp(static_cast<int>(std::floor(std::log2(std::max(minification, 1.0f)))), 0,
+                   static_cast<int>(m_levels.size()) - 1));
+    Level& level = m_levels[level_index];
+
+    float const ratio_x = static_cast<float>(level.width) / static_cast<float>(width());
+    float const ratio_y = static_cast<float>(level.height) / static_cast<float>(height());
+    SDL_FRect const level_src{src.x * ratio_x, src.y * ratio_y, src.w * ratio_x, src.h * ratio_y};
+    if (not renderLevel(level, level_src, dst, flip)) {
+        return false;
+    }
+
+    // Levels out of use give their tiles back, unless they could not be uploaded again
+    for (auto& other_level : m_levels) {
+        if (&other_level != &level) {
+            evictUnusedTiles(other_level, 0U);
+        }
+    }
+    return true;
+}
+
+bool TiledTexture::renderLevel(Level& level, SDL_FRect const& src, SDL_FRect const& dst,
+                               SDL_RendererFlip flip) noexcept {
+    float const scale_x = dst.w / src.w;
+    float const scale_y = dst.h / src.h;
+
+    // Range of tiles intersecting the source region
+    int const rows = static_cast<int>(level.tiles.size()) / level.columns;
+    int const first_column = std::clamp(static_cast<int>(std::floor(src.x)) / level.tile_size, 0, level.columns - 1);
+    int const last_column =
+        std::clamp(static_cast<int>(std::ceil(src.x + src.w) - 1) / level.tile_size, 0, level.columns - 1);
+    int const first_row = std::clamp(static_cast<int>(std::floor(src.y)) / level.tile_size, 0, rows - 1);
+    int const last_row = std::clamp(static_cast<int>(std::ceil(src.y + src.h) - 1) / level.tile_size, 0, rows - 1);
+
+    SDL_Rect const src_rect{static_cast<int>(std::floor(src.x)), static_cast<int>(std::floor(src.y)),
+                            static_cast<int>(std::ceil(src.x + src.w)) - static_cast<int>(std::floor(src.x)),
+                            static_cast<int>(std::ceil(src.y + src.h)) - static_cast<int>(std::floor(src.y))};
+
+    std::size_t visible_tiles{};
+    for (int row = first_row; row <= last_row; ++row) {
+        for (int column = first_column; column <= last_column; ++column) {
+            Tile& tile = level.tiles[static_cast<std::size_t>(row * level.columns + column)];
+
+            SDL_Rect visible_rect{};
+            if (not SDL_IntersectRect(&tile.rect, &src_rect, &visible_rect)) {
+                continue;
+            }
+
+            if (not tile.texture && not upload(level, tile)) {
+                return false;
+            }
+            tile.last_used_frame = m_frame;
+            ++visible_tiles;
+
+            // Map whole source pixels, a fractional source edge only spills outside of dst
+            auto const left = static_cast<float>(visible_rect.x);
+            auto const top = static_cast<float>(visible_rect.y);
+            auto const right = static_cast<float>(visible_rect.x + visible_rect.w);
+            auto const bottom = static_cast<float>(visible_rect.y + visible_rect.h);
+
+            SDL_FRect tile_dst{dst.x + (left - src.x) * scale_x, dst.y + (top - src.y) * scale_y,
+                               (right - left) * scale_x, (bottom - top) * scale_y};
+            if (flip & SDL_FLIP_HORIZONTAL) {
+                tile_dst.x = dst.x + dst.w - (right - src.x) * scale_x;
+            }
+            if (flip & SDL_FLIP_VERTICAL) {
+                tile_dst.y = dst.y + dst.h - (bottom - src.y) * scale_y;
+            }
+
+            SDL_Rect const tile_src{visible_rect.x - tile.rect.x, visible_rect.y - tile.rect.y, visible_rect.w,
+                                    visible_rect.h};
+            if (SDL_RenderCopyExF(m_renderer, tile.texture.get(), &tile_src, &tile_dst, 0, nullptr, flip)) {
+                return false;
+            }
+        }
+    }
+
+    evictUnusedTiles(level, visible_tiles);
+    return true;
+}
+
+bool TiledTexture::upload(Level& level, Tile& tile) noexcept {
+    if (not level.surface) {
+        SDL_SetError("tile surface was released");
+        return false;
+    }
+
+    TRACE_SCOPE("upload tile", nullptr);
+    tile.texture = createTexture(m_renderer, level.surface.get(), tile.rect, level.texture_format);
+    return static_cast<bool>(tile.texture);
+}
+
+void TiledTexture::evictUnusedTiles(Level& level, std::size_t visible_tiles) noexcept {
+    // Single textures have no surface to upload from again
+    if (not level.surface) {
+        return;
+    }
+
+    std::vector<Tile*> resident_tiles{};
+    for (auto& tile : level.tiles) {
+        if (tile.texture) {
+            resident_tiles.push_back(&tile);
+        }
+    }
+
+    std::size_t const max_resident_tiles = visible_tiles + kSpareTiles;
+    if (resident_tiles.size() <= max_resident_tiles) {
+        return;
+    }
+
+    std::sort(resident_tiles.begin(), resident_tiles.end(),
+              [](Tile const* lhs, Tile const* rhs) { return lhs->last_used_frame < rhs->last_used_frame; });
+    for (std::size_t i = 0; i < resident_tiles.size() - max_resident_tiles; ++i) {
+        resident_tiles[i]->texture.reset();
+    }
+}
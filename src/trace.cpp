@@ -0,0 +1,151 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SDL.h"
+
+namespace {
+
+struct Event {
+    std::string name{};
+    std::string image{};
+    std::int64_t start_us{};
+    std::int64_t duration_us{};
+    std::uint32_t thread_id{};
+    bool counter{false};
+    std::int64_t value{};
+};
+
+struct State {
+    std::mutex mutex{};
+    std::filesystem::path trace_path{};
+    Trace::Clock::time_point origin{};
+    std::vector<Event> events{};
+};
+
+std::atomic_bool g_enabled{false};
+
+State& state() noexcept {
+    // Never destroyed, worker threads may still record while the application exits
+    static State* trace_state = new State{};
+    return *trace_state;
+}
+
+/// Small and stable thread ids, the thread that enables the trace is 1
+std::uint32_t currentThreadId() noexcept {
+    static std::atomic_uint32_t next_thread_id{1U};
+    thread_local std::uint32_t const thread_id = next_thread_id.fetch_add(1U, std::memory_order_relaxed);
+    return thread_id;
+}
+
+void writeEscaped(std::ostream& out, std::string_view text) {
+    for (char const c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8]{};
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+}
+
+}  // namespace
+
+void Trace::enable(std::filesystem::path trace_path) noexcept {
+    auto& trace_state = state();
+    std::lock_guard lock{trace_state.mutex};
+    trace_state.trace_path = std::move(trace_path);
+    trace_state.origin = Clock::now();
+    currentThreadId();
+    g_enabled.store(true, std::memory_order_release);
+}
+
+bool Trace::enabled() noexcept { return g_enabled.load(std::memory_order_relaxed); }
+
+void Trace::record(char const* name, char const* image, Clock::time_point start, Clock::time_point end) noexcept {
+    if (not enabled()) {
+        return;
+    }
+
+    auto& trace_state = state();
+    std::uint32_t const thread_id = currentThreadId();
+    std::lock_guard lock{trace_state.mutex};
+    trace_state.events.push_back(
+        {name, image != nullptr ? image : "",
+         std::chrono::duration_cast<std::chrono::microseconds>(start - trace_state.origin).count(),
+         std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), thread_id});
+}
+
+void Trace::counter(char const* name, std::int64_t value) noexcept {
+    if (not enabled()) {
+        return;
+    }
+
+    auto& trace_state = state();
+    std::uint32_t const thread_id = currentThreadId();
+    auto const now = Clock::now();
+    std::lock_guard lock{trace_state.mutex};
+    trace_state.events.push_back(
+        {name, "", std::chrono::duration_cast<std::chrono::microseconds>(now - trace_state.origin).count(), 0,
+         thread_id, true, value});
+}
+
+bool Trace::write() noexcept {
+    if (not enabled()) {
+        return true;
+    }
+
+    auto& trace_state = state();
+    std::lock_guard lock{trace_state.mutex};
+    std::ofstream trace_file{trace_state.trace_path, std::ios::trunc};
+    trace_file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    trace_file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"main\"}}";
+    for (auto const& event : trace_state.events) {
+        trace_file << ",\n{\"name\": \"";
+        writeEscaped(trace_file, event.name);
+        if (event.counter) {
+            trace_file << "\", \"cat\": \"imgv2\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << event.start_us
+                       << ", \"args\": {\"value\": " << event.value << "}}";
+            continue;
+        }
+        trace_file << "\", \"cat\": \"imgv2\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread_id
+                   << ", \"ts\": " << event.start_us << ", \"dur\": " << event.duration_us;
+        if (not event.image.empty()) {
+            trace_file << ", \"args\": {\"image\": \"";
+            writeEscaped(trace_file, event.image);
+            trace_file << "\"}";
+        }
+        trace_file << "}";
+    }
+    trace_file << "\n]}\n";
+
+    if (not trace_file) {
+        SDL_SetError("failed to write trace %s", trace_state.trace_path.c_str());
+        return false;
+    }
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Trace of %zu events written to %s", trace_state.events.size(),
+                trace_state.trace_path.c_str());
+    return true;
+}
+
+TraceScope::TraceScope(char const* name, char const* image) noexcept : m_name(name), m_image(image) {
+    if (Trace::enabled()) {
+        m_start = Trace::Clock::now();
+    }
+}
+
+TraceScope::~TraceScope() noexcept {
+    if (Trace::enabled() && m_start != Trace::Clock::time_point{}) {
+        Trace::record(m_name, m_image, m_start, Trace::Clock::now());
+    }
+}
@@ -0,0 +1,55 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+WorkerPool& WorkerPool::shared() noexcept {
+    static WorkerPool worker_pool{std::max(std::thread::hardware_concurrency(), 1U)};
+    return worker_pool;
+}
+
+WorkerPool::WorkerPool(std::size_t thread_count) {
+    m_threads.reserve(thread_count);
+    for (std::size_t i = 0; i < thread_count; ++i) {
+        m_threads.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() noexcept {
+    {
+        std::lock_guard lock{m_mutex};
+        m_stopping = true;
+        m_tasks.clear();
+    }
+    m_condition.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+std::size_t WorkerPool::size() const noexcept { return m_threads.size(); }
+
+void WorkerPool::submit(Task task) {
+    {
+        std::lock_guard lock{m_mutex};
+        m_tasks.emplace_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void WorkerPool::run() noexcept {
+    while (true) {
+        Task task{};
+        {
+            std::unique_lock lock{m_mutex};
+            m_condition.wait(lock, [this] { return m_stopping || not m_tasks.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
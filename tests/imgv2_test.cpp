@@ -0,0 +1,521 @@
+// Unit tests of the parts of imgv2 that need neither a display nor a renderer, run with `meson test`
+//
+// Every check that fails is printed with its line, the exit status tells whether all of them passed.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SDL.h"
+#include "SDLit.hpp"
+#include "animation_decoder.hpp"
+#include "directory_index.hpp"
+#include "frame_stats.hpp"
+#include "histogram.hpp"
+#include "image_difference.hpp"
+#include "image_loader.hpp"
+#include "image_transform.hpp"
+#include "image_writer.hpp"
+#include "pixel_convert.hpp"
+
+namespace {
+
+int g_failures = 0;
+
+bool expect(bool condition, std::string_view what,
+            std::source_location const location = std::source_location::current()) noexcept {
+    if (not condition) {
+        std::cerr << location.file_name() << ':' << location.line() << ": " << what << '\n';
+        ++g_failures;
+    }
+    return condition;
+}
+
+std::vector<std::uint8_t> readFile(std::filesystem::path const& file_path) {
+    std::ifstream file{file_path, std::ios::binary};
+    return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+bool writeFile(std::filesystem::path const& file_path, std::vector<std::uint8_t> const& bytes) {
+    std::ofstream file{file_path, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<char const*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+std::uint32_t readPixel(SDL_Surface const* surface, int x, int y) noexcept {
+    std::uint32_t pixel{};
+    std::memcpy(&pixel, static_cast<std::uint8_t const*>(surface->pixels) + y * surface->pitch + x * 4, 4U);
+    return pixel;
+}
+
+/// Fill the surface, padding included, with bytes that look random but are the same on every run
+void fillPixels(SDL_Surface* surface, std::uint32_t seed) noexcept {
+    auto* pixels = static_cast<std::uint8_t*>(surface->pixels);
+    std::size_t const size = static_cast<std::size_t>(surface->pitch) * static_cast<std::size_t>(surface->h);
+    for (std::size_t i = 0; i < size; ++i) {
+        seed = seed * 1664525U + 1013904223U;
+        pixels[i] = static_cast<std::uint8_t>(seed >> 24);
+    }
+}
+
+/// Red, green and blue of a pixel of a 32 bits surface, then its alpha
+std::array<int, 4> colorAt(SDL_Surface const* surface, int x, int y) noexcept {
+    Uint8 red{};
+    Uint8 green{};
+    Uint8 blue{};
+    Uint8 alpha{};
+    SDL_GetRGBA(readPixel(surface, x, y), surface->format, &red, &green, &blue, &alpha);
+    return {red, green, blue, alpha};
+}
+
+void testNaturalLess() {
+    expect(naturalLess("img2", "img10"), "img2 < img10");
+    expect(not naturalLess("img10", "img2"), "not img10 < img2");
+    expect(naturalLess("img9.png", "img10.png"), "img9.png < img10.png");
+    expect(naturalLess("img007", "img10"), "leading zeros are not digits of the value");
+    expect(naturalLess("a1b2", "a1b10"), "every run of digits compares by value");
+    expect(naturalLess("apple", "Banana"), "letters ignore case");
+    expect(not naturalLess("Banana", "apple"), "letters ignore case");
+
+    // Names equal but for case or leading zeros are told apart by their bytes
+    expect(naturalLess("IMG1", "img1"), "IMG1 < img1 by bytes");
+    expect(not naturalLess("img1", "IMG1"), "not img1 < IMG1");
+    expect(naturalLess("img02", "img2"), "img02 < img2 by bytes");
+    expect(not naturalLess("img2", "img02"), "not img2 < img02");
+    expect(naturalLess("0", "00"), "0 < 00 by bytes");
+
+    // A strict weak ordering where only identical names are equivalent, so any two distinct names are ordered
+    constexpr std::string_view kNames[] = {"",     "0",    "00",    "01",   "1",   "10",    "a",      "A",
+                                           "a.png", "a_1",  "a0",    "a1",   "a01", "a001",  "a1b",    "a01b",
+                                           "a2",    "a10",  "A10",   "a10b", "b",   "img2",  "img02",  "img10",
+                                           "IMG10", "x9y",  "x09y",  "x10",  "img010"};
+    for (auto const a : kNames) {
+        expect(not naturalLess(a, a), "irreflexive");
+        for (auto const b : kNames) {
+            if (a != b) {
+                expect(naturalLess(a, b) != naturalLess(b, a), "distinct names are ordered one way only");
+            }
+            for (auto const c : kNames) {
+                if (naturalLess(a, b) && naturalLess(b, c)) {
+                    expect(naturalLess(a, c), "transitive");
+                }
+            }
+        }
+    }
+}
+
+void testTransformSurface() {
+    // Larger than a block of the transposing copy, and not square so a swapped width and height would show
+    constexpr int kWidth = 70;
+    constexpr int kHeight = 67;
+    SurfacePtr surface =
+        SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, kWidth, kHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (not expect(static_cast<bool>(surface), "source surface created")) {
+        return;
+    }
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            auto const pixel = static_cast<std::uint32_t>(y * kWidth + x + 1);
+            std::memcpy(static_cast<std::uint8_t*>(surface->pixels) + y * surface->pitch + x * 4, &pixel, 4U);
+        }
+    }
+
+    constexpr SDL_RendererFlip kFlips[] = {SDL_FLIP_NONE, SDL_FLIP_HORIZONTAL, SDL_FLIP_VERTICAL,
+                                           static_cast<SDL_RendererFlip>(SDL_FLIP_HORIZONTAL | SDL_FLIP_VERTICAL)};
+    for (auto const flip : kFlips) {
+        for (int quarter_turns = -1; quarter_turns <= 4; ++quarter_turns) {
+            SurfacePtr const output = transformSurface(surface, flip, quarter_turns);
+            if (not expect(static_cast<bool>(output), "surface transformed")) {
+                continue;
+            }
+
+            int const turns = ((quarter_turns % 4) + 4) % 4;
+            bool const transposed = turns % 2 == 1;
+            if (not expect(output->w == (transposed ? kHeight : kWidth) && output->h == (transposed ? kWidth : kHeight),
+                           "output size")) {
+                continue;
+            }
+
+            // Mirror each source pixel, then turn it clockwise a quarter at a time
+            bool matches = true;
+            for (int y = 0; y < kHeight && matches; ++y) {
+                for (int x = 0; x < kWidth && matches; ++x) {
+                    SDL_Point position{(flip & SDL_FLIP_HORIZONTAL) ? kWidth - 1 - x : x,
+                                       (flip & SDL_FLIP_VERTICAL) ? kHeight - 1 - y : y};
+                    SDL_Point size{kWidth, kHeight};
+                    for (int turn = 0; turn < turns; ++turn) {
+                        position = SDL_Point{size.y - 1 - position.y, position.x};
+                        size = SDL_Point{size.y, size.x};
+                    }
+                    matches = readPixel(output.get(), position.x, position.y) == readPixel(surface.get(), x, y);
+                }
+            }
+            expect(matches, "pixels mirrored then turned clockwise");
+        }
+    }
+}
+
+void testQoiEncoder() {
+    // Every chunk of the format once: a run, a small difference, a luma difference, an index, a new alpha
+    constexpr std::uint8_t kPixels[] = {0, 0,   0, 255, 1,  255, 0,  255, 11, 5, 12, 255,
+                                        1, 255, 0, 255, 1,  2,   3,  128, 1,  2, 3,  128};
+    constexpr std::uint8_t kEncoded[] = {'q',  'o',  'i',  'f',  0,    0,    0,    3,    0,    0,    0,    2,
+                                         4,    0,    0xC0, 0x76, 0xA6, 0xCE, 0x33, 0xFF, 0x01, 0x02, 0x03, 0x80,
+                                         0xC0, 0,    0,    0,    0,    0,    0,    0,    1};
+    SurfacePtr surface = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, 3, 2, 32, SDL_PIXELFORMAT_RGBA32);
+    if (not expect(static_cast<bool>(surface), "source surface created")) {
+        return;
+    }
+    for (int y = 0; y < 2; ++y) {
+        std::memcpy(static_cast<std::uint8_t*>(surface->pixels) + y * surface->pitch, kPixels + y * 12, 12U);
+    }
+
+    auto const image_path = std::filesystem::temp_directory_path() / "imgv2-test.qoi";
+    if (expect(saveImage(surface.get(), image_path), "qoi image saved")) {
+        auto const bytes = readFile(image_path);
+        expect(bytes == std::vector<std::uint8_t>(std::begin(kEncoded), std::end(kEncoded)), "qoi bytes");
+    }
+    std::error_code error{};
+    std::filesystem::remove(image_path, error);
+}
+
+void testGifDecoder() {
+    // The 10x10 sample of the GIF specification walkthroughs, the codes grow from 3 to 6 bits
+    constexpr std::uint8_t kImageData[] = {0x02, 0x16, 0x8C, 0x2D, 0x99, 0x87, 0x2A, 0x1C, 0xDC, 0x33, 0xA0, 0x02,
+                                           0x75, 0xEC, 0x95, 0xFA, 0xA8, 0xDE, 0x60, 0x8C, 0x04, 0x91, 0x4C, 0x01,
+                                           0x00};
+    constexpr std::uint8_t kIndices[10][10] = {
+        {1, 1, 1, 1, 1, 2, 2, 2, 2, 2}, {1, 1, 1, 1, 1, 2, 2, 2, 2, 2}, {1, 1, 1, 1, 1, 2, 2, 2, 2, 2},
+        {1, 1, 1, 0, 0, 0, 0, 2, 2, 2}, {1, 1, 1, 0, 0, 0, 0, 2, 2, 2}, {2, 2, 2, 0, 0, 0, 0, 1, 1, 1},
+        {2, 2, 2, 0, 0, 0, 0, 1, 1, 1}, {2, 2, 2, 2, 2, 1, 1, 1, 1, 1}, {2, 2, 2, 2, 2, 1, 1, 1, 1, 1},
+        {2, 2, 2, 2, 2, 1, 1, 1, 1, 1}};
+    constexpr std::array<std::array<std::uint8_t, 3>, 4> kPalette{
+        {{255, 255, 255}, {255, 0, 0}, {0, 0, 255}, {0, 0, 0}}};
+
+    // Shown twice, a single frame is not an animation
+    std::vector<std::uint8_t> bytes{'G', 'I', 'F', '8', '9', 'a', 10, 0, 10, 0, 0x91, 0, 0};
+    for (auto const& color : kPalette) {
+        bytes.insert(bytes.end(), color.begin(), color.end());
+    }
+    for (int frame = 0; frame < 2; ++frame) {
+        bytes.insert(bytes.end(), {0x2C, 0, 0, 0, 0, 10, 0, 10, 0, 0});
+        bytes.insert(bytes.end(), std::begin(kImageData), std::end(kImageData));
+    }
+    bytes.push_back(0x3B);
+
+    auto const image_path = std::filesystem::temp_directory_path() / "imgv2-test.gif";
+    if (not expect(writeFile(image_path, bytes), "gif image written")) {
+        return;
+    }
+    if (auto decoder = AnimationDecoder::open(image_path); expect(static_cast<bool>(decoder), "gif opened")) {
+        expect(decoder->size().x == 10 && decoder->size().y == 10, "gif size");
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int frame_index = 0; frame_index < 2; ++frame_index) {
+                AnimationFrame frame{};
+                if (not expect(decoder->next(frame), "gif frame decoded")) {
+                    break;
+                }
+                bool matches = true;
+                for (int y = 0; y < 10; ++y) {
+                    auto const* row =
+                        static_cast<std::uint8_t const*>(frame.surface->pixels) + y * frame.surface->pitch;
+                    for (int x = 0; x < 10; ++x) {
+                        auto const& color = kPalette[kIndices[y][x]];
+                        matches = matches && std::memcmp(row + x * 4, color.data(), 3U) == 0 && row[x * 4 + 3] == 255;
+                    }
+                }
+                expect(matches, "gif pixels");
+            }
+            AnimationFrame frame{};
+            expect(not decoder->next(frame), "no frame after the last one");
+            expect(decoder->rewind(), "gif rewound");
+        }
+    }
+    std::error_code error{};
+    std::filesystem::remove(image_path, error);
+}
+
+void testDurationHistogramBucket() {
+    using std::chrono::microseconds;
+
+    expect(DurationHistogram::bucket(microseconds{-5}) == 0U, "negative durations in the first bucket");
+    for (int i = 0; i < 8; ++i) {
+        expect(DurationHistogram::bucket(microseconds{i}) == static_cast<std::size_t>(i), "a microsecond wide below 8");
+    }
+    expect(DurationHistogram::bucket(microseconds{8}) == 8U, "8us starts the first logarithmic bucket");
+    expect(DurationHistogram::bucket(microseconds{16}) == 16U, "every power of two starts eight buckets");
+    expect(DurationHistogram::bucket(microseconds{17}) == 16U, "16us and 17us share a bucket");
+    expect(DurationHistogram::bucket(microseconds{18}) == 17U, "an eighth of 16us wide");
+    expect(DurationHistogram::bucket(std::chrono::hours{24}) == DurationHistogram::kBucketCount - 1U,
+           "longer durations in the last bucket");
+
+    // Buckets only grow with the duration and are never more than an eighth of their lower bound wide
+    std::size_t previous = 0U;
+    for (std::int64_t duration = 0; duration < 100'000'000; duration += 1 + duration / 64) {
+        std::size_t const bucket = DurationHistogram::bucket(microseconds{duration});
+        expect(bucket >= previous && bucket <= previous + 1U, "monotonic without skipping buckets");
+        previous = bucket;
+    }
+
+    DurationHistogram histogram{};
+    for (int i = 1; i <= 100; ++i) {
+        histogram.add(std::chrono::milliseconds{i});
+    }
+    auto const median = histogram.percentile(0.5).count();
+    expect(histogram.count() == 100U, "samples counted");
+    expect(median >= 47'000 && median <= 53'000, "median within a bucket of 50ms");
+}
+
+/// Offsets of red, green, blue and alpha in the bytes of a pixel of the formats laid out byte by byte, -1 for none
+std::array<int, 4> byteOrder(Uint32 format) noexcept {
+    switch (format) {
+        case SDL_PIXELFORMAT_RGBA32:
+            return {0, 1, 2, 3};
+        case SDL_PIXELFORMAT_BGRA32:
+            return {2, 1, 0, 3};
+        default:
+            return {0, 1, 2, -1};
+    }
+}
+
+void testConvertPixels() {
+    // Odd width from an odd column, the last pixels of each row go through the scalar loops after the vectors
+    constexpr SDL_Rect kRect{3, 1, 37, 3};
+    constexpr int kPadding = 8;
+    constexpr std::uint8_t kSentinel = 0xA5;
+
+    struct Conversion {
+        Uint32 source_format;
+        Uint32 format;
+    };
+    // Swaps, expansions, a copy and one left to SDL_ConvertPixels
+    constexpr std::array kConversions{
+        Conversion{SDL_PIXELFORMAT_RGBA32, SDL_PIXELFORMAT_BGRA32},
+        Conversion{SDL_PIXELFORMAT_BGRA32, SDL_PIXELFORMAT_RGBA32},
+        Conversion{SDL_PIXELFORMAT_RGB24, SDL_PIXELFORMAT_RGBA32},
+        Conversion{SDL_PIXELFORMAT_RGB24, SDL_PIXELFORMAT_BGRA32},
+        Conversion{SDL_PIXELFORMAT_RGBA32, SDL_PIXELFORMAT_RGBA32},
+        Conversion{SDL_PIXELFORMAT_RGBA32, SDL_PIXELFORMAT_RGB24},
+    };
+
+    for (auto const& conversion : kConversions) {
+        SurfacePtr surface = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, kRect.x + kRect.w + 2,
+                                                kRect.y + kRect.h + 1, 32, conversion.source_format);
+        if (not expect(surface != nullptr, "source surface created")) {
+            continue;
+        }
+        fillPixels(surface.get(), conversion.source_format ^ conversion.format);
+
+        int const source_bytes = SDL_BYTESPERPIXEL(conversion.source_format);
+        int const output_bytes = SDL_BYTESPERPIXEL(conversion.format);
+        int const pitch = kRect.w * output_bytes + kPadding;
+        std::vector<std::uint8_t> pixels(static_cast<std::size_t>(pitch * kRect.h), kSentinel);
+        if (not expect(convertPixels(surface.get(), kRect, conversion.format, pixels.data(), pitch),
+                       "pixels converted")) {
+            continue;
+        }
+
+        // Byte by byte reference, a missing alpha is opaque
+        auto const source_order = byteOrder(conversion.source_format);
+        auto const output_order = byteOrder(conversion.format);
+        bool matches = true;
+        bool padding_kept = true;
+        for (int y = 0; y < kRect.h; ++y) {
+            auto const* source_row = static_cast<std::uint8_t const*>(surface->pixels) + (kRect.y + y) * surface->pitch;
+            std::uint8_t const* output_row = pixels.data() + y * pitch;
+            for (int x = 0; x < kRect.w; ++x) {
+                std::uint8_t const* source_pixel = source_row + (kRect.x + x) * source_bytes;
+                std::uint8_t const* output_pixel = output_row + x * output_bytes;
+                for (std::size_t channel = 0; channel < 4U; ++channel) {
+                    if (output_order[channel] < 0) {
+                        continue;
+                    }
+                    int const expected = source_order[channel] < 0 ? 255 : source_pixel[source_order[channel]];
+                    matches = matches && output_pixel[output_order[channel]] == expected;
+                }
+            }
+            padding_kept = padding_kept && std::all_of(output_row + kRect.w * output_bytes, output_row + pitch,
+                                                       [](std::uint8_t byte) { return byte == kSentinel; });
+        }
+        expect(matches, "converted pixels");
+        expect(padding_kept, "nothing written past the rect");
+    }
+}
+
+void testCountPixels() {
+    // Clipped to 37 columns, 2 chunks of 16 pixels then 5 counted one at a time
+    constexpr SDL_Rect kRect{-3, 2, 40, 10};
+    constexpr SDL_Rect kClippedRect{0, 2, 37, 4};
+
+    // Read in place with either channel order, then converted a row at a time
+    for (Uint32 const format : {SDL_PIXELFORMAT_BGRA32, SDL_PIXELFORMAT_RGBA32, SDL_PIXELFORMAT_RGB24}) {
+        SurfacePtr surface = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, kClippedRect.w, 6, 32, format);
+        if (not expect(surface != nullptr, "surface created")) {
+            continue;
+        }
+        fillPixels(surface.get(), format);
+
+        // Scalar reference with the BT.709 weights in 8 bits fixed point
+        Histogram expected{};
+        auto const order = byteOrder(format);
+        int const pixel_bytes = SDL_BYTESPERPIXEL(format);
+        for (int y = kClippedRect.y; y < kClippedRect.y + kClippedRect.h; ++y) {
+            for (int x = kClippedRect.x; x < kClippedRect.x + kClippedRect.w; ++x) {
+                auto const* pixel = static_cast<std::uint8_t const*>(surface->pixels) + y * surface->pitch +
+                                    x * pixel_bytes;
+                int const red = pixel[order[0]];
+                int const green = pixel[order[1]];
+                int const blue = pixel[order[2]];
+                ++expected.counts[Histogram::kRed][static_cast<std::size_t>(red)];
+                ++expected.counts[Histogram::kGreen][static_cast<std::size_t>(green)];
+                ++expected.counts[Histogram::kBlue][static_cast<std::size_t>(blue)];
+                ++expected.counts[Histogram::kLuma][static_cast<std::size_t>((54 * red + 183 * green + 19 * blue +
+                                                                              128) >> 8)];
+            }
+        }
+
+        Histogram histogram{};
+        countPixels(surface.get(), kRect, histogram);
+        expect(histogram.counts == expected.counts, "pixels of the clipped rect counted");
+
+        Histogram outside{};
+        countPixels(surface.get(), {kClippedRect.w, 0, 4, 4}, outside);
+        expect(outside.counts == Histogram{}.counts, "nothing counted outside of the surface");
+    }
+}
+
+struct DifferenceResult {
+    SurfacePtr surface{};
+    DifferenceStats stats{};
+    std::string error{};
+};
+
+DifferenceResult computeDifference(SurfacePtr first_surface, SurfacePtr second_surface, DifferenceOptions options) {
+    std::promise<DifferenceResult> promise{};
+    auto result = promise.get_future();
+    computeDifferenceAsync(std::move(first_surface), std::move(second_surface), options, nullptr,
+                           [&promise](SurfacePtr difference_surface, DifferenceStats const& stats,
+                                      std::string const& error) {
+                               promise.set_value(DifferenceResult{std::move(difference_surface), stats, error});
+                           });
+    return result.get();
+}
+
+void testDifference() {
+    // Odd width, the last 3 pixels of each row go through the scalar loop after the vectors of 4 pixels
+    constexpr int kWidth = 39;
+    constexpr int kHeight = 5;
+    constexpr int kThreshold = 6;
+    constexpr int kGainShift = 2;
+    SurfacePtr first = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, kWidth, kHeight, 32,
+                                          SDL_PIXELFORMAT_ARGB8888);
+    SurfacePtr second = SDLit::make_unique(SDL_CreateRGBSurfaceWithFormat, 0, kWidth, kHeight, 32,
+                                           SDL_PIXELFORMAT_ARGB8888);
+    if (not expect(first && second, "source surfaces created")) {
+        return;
+    }
+
+    // Every fifth pixel the same, the other ones mostly close to the threshold and some far enough to saturate
+    fillPixels(first.get(), 1U);
+    std::size_t const size = static_cast<std::size_t>(first->pitch) * kHeight;
+    auto const* first_bytes = static_cast<std::uint8_t const*>(first->pixels);
+    auto* second_bytes = static_cast<std::uint8_t*>(second->pixels);
+    std::uint32_t seed = 2U;
+    for (std::size_t i = 0; i < size; ++i) {
+        seed = seed * 1664525U + 1013904223U;
+        int const change = static_cast<int>(seed >> 24);
+        if (i / 4U % 5U == 0U || change < 32) {
+            second_bytes[i] = first_bytes[i];
+        } else if (change < 224) {
+            second_bytes[i] = static_cast<std::uint8_t>(std::clamp(first_bytes[i] + change % 19 - 9, 0, 255));
+        } else {
+            second_bytes[i] = static_cast<std::uint8_t>(seed >> 8);
+        }
+    }
+
+    // Scalar reference of the difference image and of its statistics
+    int max_error{};
+    std::uint64_t squared_error{};
+    std::uint64_t differing_pixels{};
+    std::vector<std::array<int, 4>> expected_colors{};
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            auto const first_color = colorAt(first.get(), x, y);
+            auto const second_color = colorAt(second.get(), x, y);
+            std::array<int, 4> expected_color{0, 0, 0, 255};
+            bool differing{false};
+            for (std::size_t channel = 0; channel < 3U; ++channel) {
+                int const difference = std::abs(first_color[channel] - second_color[channel]);
+                max_error = std::max(max_error, difference);
+                squared_error += static_cast<std::uint64_t>(difference * difference);
+                differing = differing || difference > kThreshold;
+                expected_color[channel] = difference > kThreshold ? std::min(difference << kGainShift, 255) : 0;
+            }
+            differing_pixels += differing ? 1U : 0U;
+            expected_colors.push_back(expected_color);
+        }
+    }
+    double const expected_psnr =
+        10.0 * std::log10(255.0 * 255.0 / (static_cast<double>(squared_error) / (kWidth * kHeight * 3.0)));
+
+    auto const check = [&](SurfacePtr second_surface) {
+        auto const result = computeDifference(first, std::move(second_surface), {kThreshold, 1 << kGainShift});
+        if (not expect(result.surface && result.error.empty(), "difference computed")) {
+            return;
+        }
+        bool matches = true;
+        for (int y = 0; y < kHeight; ++y) {
+            for (int x = 0; x < kWidth; ++x) {
+                matches = matches && colorAt(result.surface.get(), x, y) ==
+                                         expected_colors[static_cast<std::size_t>(y * kWidth + x)];
+            }
+        }
+        expect(matches, "difference pixels thresholded, amplified and opaque");
+        expect(result.stats.max_error == max_error, "largest difference");
+        expect(result.stats.differing_pixels == differing_pixels, "differing pixels");
+        expect(result.stats.pixel_count == static_cast<std::uint64_t>(kWidth * kHeight), "pixel count");
+        expect(std::abs(result.stats.psnr - expected_psnr) < 1e-9, "psnr");
+    };
+
+    // Compared in place, then converted row by row when the layouts differ
+    check(second);
+    check(SDLit::make_unique(SDL_ConvertSurfaceFormat, second.get(), SDL_PIXELFORMAT_ABGR8888, 0));
+
+    auto const same = computeDifference(first, first, {kThreshold, 1 << kGainShift});
+    expect(same.surface && same.stats.max_error == 0 && same.stats.differing_pixels == 0U &&
+               std::isinf(same.stats.psnr),
+           "identical images");
+}
+
+}  // namespace
+
+int main() {
+    testNaturalLess();
+    testTransformSurface();
+    testQoiEncoder();
+    testGifDecoder();
+    testDurationHistogramBucket();
+    testConvertPixels();
+    testCountPixels();
+    testDifference();
+
+    if (g_failures > 0) {
+        std::cerr << g_failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed\n";
+    return EXIT_SUCCESS;
+}